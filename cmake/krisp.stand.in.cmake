@@ -0,0 +1,21 @@
+# Local stand-in for the Krisp Audio SDK, see src/krisp-stand-in.
+# It implements the Nc/Al API with a deterministic spectral gate so the
+# samples can be built and profiled without the SDK package.
+set(KRISP_STAND_IN_DIR ${ROOT_DIR}/src/krisp-stand-in)
+
+add_library(
+	krisp-audio-sdk-stand-in
+	STATIC
+	${KRISP_STAND_IN_DIR}/krisp_stand_in.cpp
+	${KRISP_STAND_IN_DIR}/spectral_gate.cpp
+)
+
+target_include_directories(
+	krisp-audio-sdk-stand-in
+	PRIVATE
+	${KRISP_STAND_IN_DIR}
+	${KRISP_STAND_IN_DIR}/include
+)
+
+set(KRISP_INC_DIR ${KRISP_STAND_IN_DIR}/include)
+set(KRISP_LIBS krisp-audio-sdk-stand-in)
@@ -0,0 +1,53 @@
+# Performance build options, all off by default:
+#   -D LTO=1                 link-time optimization
+#   -D PGO=generate|use      two-stage profile guided optimization, the
+#                            profiles are kept in PGO_DIR
+#   -D MARCH=<isa>           code generation for an instruction set level,
+#                            x86-64, x86-64-v3 (AVX2) or x86-64-v4 (AVX-512)
+# The makefile targets release, pgo and isa combine them.
+
+if (DEFINED LTO)
+	cmake_policy(SET CMP0069 NEW)
+	include(CheckIPOSupported)
+	check_ipo_supported(RESULT LTO_SUPPORTED OUTPUT LTO_ERROR LANGUAGES CXX)
+	if (NOT LTO_SUPPORTED)
+		message(FATAL_ERROR "LTO is not supported by the toolchain: ${LTO_ERROR}")
+	endif()
+	set(CMAKE_INTERPROCEDURAL_OPTIMIZATION ON)
+endif()
+
+if (DEFINED PGO)
+	if (NOT DEFINED PGO_DIR)
+		set(PGO_DIR ${ROOT_DIR}/build-pgo/profiles)
+	endif()
+	if (NOT (CMAKE_CXX_COMPILER_ID MATCHES "GNU" OR CMAKE_CXX_COMPILER_ID MATCHES "Clang"))
+		message(FATAL_ERROR "PGO is supported with GCC and Clang only")
+	endif()
+
+	if (PGO STREQUAL "generate")
+		add_compile_options(-fprofile-generate=${PGO_DIR})
+		set(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -fprofile-generate=${PGO_DIR}")
+	elseif (PGO STREQUAL "use")
+		if (CMAKE_CXX_COMPILER_ID MATCHES "GNU")
+			# GCC reads the .gcda files written next to the mangled object
+			# paths, the use stage must be built in the generate build tree
+			add_compile_options(-fprofile-use=${PGO_DIR} -fprofile-correction -Wno-missing-profile)
+		else()
+			# Clang reads the .profraw files merged by llvm-profdata
+			add_compile_options(
+				-fprofile-use=${PGO_DIR}/default.profdata
+				-Wno-profile-instr-unprofiled
+				-Wno-profile-instr-missing
+			)
+		endif()
+	else()
+		message(FATAL_ERROR "PGO must be generate or use")
+	endif()
+endif()
+
+if (DEFINED MARCH)
+	if (NOT (CMAKE_CXX_COMPILER_ID MATCHES "GNU" OR CMAKE_CXX_COMPILER_ID MATCHES "Clang"))
+		message(FATAL_ERROR "MARCH is supported with GCC and Clang only")
+	endif()
+	add_compile_options(-march=${MARCH})
+endif()
@@ -0,0 +1,71 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// Levels built by "make isa", best first. Every level directory under the
+// directory of this launcher holds the same apps built with -march=<level>.
+static const char *const kIsaLevels[] = {"x86-64-v4", "x86-64-v3", "x86-64"};
+
+static bool isSupported(const std::string &level)
+{
+    __builtin_cpu_init();
+    if (level == "x86-64-v4")
+    {
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+               __builtin_cpu_supports("avx512cd") && __builtin_cpu_supports("avx512dq") &&
+               __builtin_cpu_supports("avx512vl") && isSupported("x86-64-v3");
+    }
+    if (level == "x86-64-v3")
+    {
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+               __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2");
+    }
+    return true;
+}
+
+static std::string getOwnDirectory()
+{
+    std::vector<char> path(4096);
+    ssize_t n = readlink("/proc/self/exe", path.data(), path.size() - 1);
+    if (n <= 0)
+    {
+        return ".";
+    }
+    std::string exe(path.data(), static_cast<size_t>(n));
+    return exe.substr(0, exe.find_last_of('/'));
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "\nUsage:\n\t" << argv[0] << " app [app arguments]"
+                  << "\n\t" << argv[0] << " --print"
+                  << "\nRuns the build of the app for the best instruction set level the CPU supports." << std::endl;
+        return argc == 1 ? 0 : 1;
+    }
+    const std::string dir = getOwnDirectory();
+    const bool print = std::string(argv[1]) == "--print";
+    for (const char *level : kIsaLevels)
+    {
+        std::string app = dir + "/" + level + "/" + (print ? "" : argv[1]);
+        if (!isSupported(level) || access(app.c_str(), print ? F_OK : X_OK) != 0)
+        {
+            continue;
+        }
+        if (print)
+        {
+            std::cout << level << std::endl;
+            return 0;
+        }
+        execv(app.c_str(), argv + 1);
+        std::cerr << app << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    std::cerr << "No build of " << (print ? "the apps" : argv[1]) << " for this CPU in " << dir << std::endl;
+    return 1;
+}
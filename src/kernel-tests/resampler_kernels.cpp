@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "resampler.hpp"
+
+// Every dot product kernel of the CPU resamples the same signal, the output
+// must match the scalar kernel up to the rounding of the reordered sums.
+// The chunk size is odd so the kernels see unaligned input and every phase.
+
+static const float kTolerance = 1e-5f;
+static const double kPi = 3.14159265358979323846;
+static const size_t kChunk = 333;
+
+struct RateCase
+{
+    uint32_t inRate;
+    uint32_t outRate;
+};
+
+static std::vector<float> makeSignal(uint32_t rate, size_t nSamples)
+{
+    std::vector<float> signal(nSamples);
+    uint32_t noiseState = 0x2545F491u;
+    for (size_t n = 0; n < nSamples; ++n)
+    {
+        const double t = static_cast<double>(n) / rate;
+        noiseState = noiseState * 1664525u + 1013904223u;
+        const double noise = (static_cast<double>(noiseState >> 8) / 8388608.0 - 1.0) * 0.05;
+        signal[n] = static_cast<float>(0.5 * std::sin(2.0 * kPi * 440.0 * t) +
+                                       0.3 * std::sin(2.0 * kPi * 3150.0 * t) + noise);
+    }
+    // Full scale samples, the kernels must not saturate differently
+    signal[nSamples / 2] = 1.0f;
+    signal[nSamples / 2 + 1] = -1.0f;
+    return signal;
+}
+
+static bool resample(const std::string &kernel, const RateCase &rates, const std::vector<float> &in,
+                     std::vector<float> &out)
+{
+    if (!Resampler::selectKernel(kernel))
+    {
+        std::cerr << "Unknown kernel " << kernel << std::endl;
+        return false;
+    }
+    Resampler resampler;
+    if (!resampler.init(rates.inRate, rates.outRate))
+    {
+        std::cerr << resampler.getErrorMsg() << std::endl;
+        return false;
+    }
+    std::vector<float> block(std::max(resampler.getMaxOutput(kChunk), resampler.getMaxOutput(Resampler::kTaps)));
+    out.clear();
+    for (size_t pos = 0; pos < in.size(); pos += kChunk)
+    {
+        size_t n = std::min(kChunk, in.size() - pos);
+        size_t nOut = resampler.process(in.data() + pos, n, block.data());
+        out.insert(out.end(), block.begin(), block.begin() + static_cast<std::ptrdiff_t>(nOut));
+    }
+    size_t nOut = resampler.flush(block.data());
+    out.insert(out.end(), block.begin(), block.begin() + static_cast<std::ptrdiff_t>(nOut));
+    return true;
+}
+
+int main()
+{
+    const std::vector<std::string> kernels = Resampler::getKernelNames();
+    // Up, down, a reduced ratio with many phases and a ratio above kMaxPhases
+    const RateCase cases[] = {{44100, 48000}, {48000, 16000}, {11025, 8000}, {96000, 44100}, {44101, 48000}};
+    bool failed = false;
+    for (const RateCase &rates : cases)
+    {
+        const std::vector<float> in = makeSignal(rates.inRate, rates.inRate / 2);
+        std::vector<float> reference;
+        if (!resample(kernels.front(), rates, in, reference))
+        {
+            return 1;
+        }
+        for (size_t k = 1; k < kernels.size(); ++k)
+        {
+            std::vector<float> out;
+            if (!resample(kernels[k], rates, in, out))
+            {
+                return 1;
+            }
+            float maxDiff = 0.0f;
+            for (size_t i = 0; i < std::min(out.size(), reference.size()); ++i)
+            {
+                maxDiff = std::max(maxDiff, std::fabs(out[i] - reference[i]));
+            }
+            const bool ok = out.size() == reference.size() && maxDiff <= kTolerance;
+            std::cout << rates.inRate << " -> " << rates.outRate << " Hz, " << kernels[k] << " vs "
+                      << kernels.front() << ": " << out.size() << " samples, max difference " << maxDiff
+                      << (ok ? "" : " FAILED") << std::endl;
+            failed = failed || !ok;
+        }
+    }
+    if (kernels.size() == 1)
+    {
+        std::cout << "Only the " << kernels.front() << " kernel is available" << std::endl;
+    }
+    return failed ? 1 : 0;
+}
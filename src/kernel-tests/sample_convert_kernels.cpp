@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "sample_convert.hpp"
+
+// The conversions run SSE2, SSSE3 or NEON on the bulk of the samples and
+// the scalar loop on the tail. Every conversion is compared with the scalar
+// loop written out here, on the edge values of the format mixed with other
+// values. The lengths put the edge values in every SIMD lane and leave odd
+// tails, the results must be equal.
+
+static const size_t kLengths[] = {1, 7, 16, 67, 1001};
+
+static uint32_t nextRandom(uint32_t &state)
+{
+    state = state * 1664525u + 1013904223u;
+    return state;
+}
+
+// The edge values first, then pseudo-random values, repeated up to n
+template <typename T>
+static std::vector<T> makeInput(const std::vector<T> &edges, size_t n, T (*random)(uint32_t &))
+{
+    std::vector<T> values(n);
+    uint32_t state = 0x9E3779B9u;
+    for (size_t i = 0; i < n; ++i)
+    {
+        // A different offset per length moves the edges through the lanes
+        const size_t k = (i + n) % (2 * edges.size());
+        values[i] = k < edges.size() ? edges[k] : random(state);
+    }
+    return values;
+}
+
+template <typename T>
+static bool check(const std::string &name, size_t n, const std::vector<T> &out, const std::vector<T> &expected)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (std::memcmp(&out[i], &expected[i], sizeof(T)) != 0)
+        {
+            std::cout << name << ", " << n << " samples: sample " << i << " is " << +out[i] << ", the scalar loop gives "
+                      << +expected[i] << " FAILED" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool testPcm16(size_t n)
+{
+    const std::vector<int16_t> edges = {INT16_MIN, INT16_MAX, -1, 0, 1};
+    const std::vector<int16_t> in = makeInput<int16_t>(edges, n, [](uint32_t &s)
+                                                       { return static_cast<int16_t>(nextRandom(s) >> 16); });
+    std::vector<float> out(n), expected(n);
+    pcm16ToFloat(in.data(), n, out.data());
+    for (size_t i = 0; i < n; ++i)
+    {
+        expected[i] = static_cast<float>(in[i]) * (1.0f / 32768.0f);
+    }
+    return check("pcm16ToFloat", n, out, expected);
+}
+
+static bool testPcm24(size_t n)
+{
+    const std::vector<int32_t> edges = {-(1 << 23), (1 << 23) - 1, -1, 0, 1};
+    const std::vector<int32_t> values = makeInput<int32_t>(edges, n, [](uint32_t &s)
+                                                           { return static_cast<int32_t>(nextRandom(s)) >> 8; });
+    // Packed little-endian, exactly 3 bytes per sample so the SIMD loads
+    // near the end of the buffer are checked by the sanitizers
+    std::vector<uint8_t> in(3 * n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const uint32_t v = static_cast<uint32_t>(values[i]);
+        in[3 * i] = static_cast<uint8_t>(v);
+        in[3 * i + 1] = static_cast<uint8_t>(v >> 8);
+        in[3 * i + 2] = static_cast<uint8_t>(v >> 16);
+    }
+    std::vector<float> out(n), expected(n);
+    pcm24ToFloat(in.data(), n, out.data());
+    for (size_t i = 0; i < n; ++i)
+    {
+        expected[i] = static_cast<float>(values[i] * 256) * (1.0f / 2147483648.0f);
+    }
+    return check("pcm24ToFloat", n, out, expected);
+}
+
+static bool testPcm32(size_t n)
+{
+    const std::vector<int32_t> edges = {INT32_MIN, INT32_MAX, -1, 0, 1};
+    const std::vector<int32_t> in = makeInput<int32_t>(edges, n, [](uint32_t &s)
+                                                       { return static_cast<int32_t>(nextRandom(s)); });
+    std::vector<float> out(n), expected(n);
+    pcm32ToFloat(in.data(), n, out.data());
+    for (size_t i = 0; i < n; ++i)
+    {
+        expected[i] = static_cast<float>(in[i]) * (1.0f / 2147483648.0f);
+    }
+    return check("pcm32ToFloat", n, out, expected);
+}
+
+static bool testPcmU8(size_t n)
+{
+    const std::vector<uint8_t> edges = {0, 128, 255, 127, 1};
+    const std::vector<uint8_t> in = makeInput<uint8_t>(edges, n, [](uint32_t &s)
+                                                       { return static_cast<uint8_t>(nextRandom(s) >> 24); });
+    std::vector<float> out(n), expected(n);
+    pcmU8ToFloat(in.data(), n, out.data());
+    for (size_t i = 0; i < n; ++i)
+    {
+        expected[i] = static_cast<float>(static_cast<int>(in[i]) - 128) * (1.0f / 128.0f);
+    }
+    return check("pcmU8ToFloat", n, out, expected);
+}
+
+static bool testFloatToPcm16(size_t n)
+{
+    const float inf = std::numeric_limits<float>::infinity();
+    // Full scale, beyond it, the rounding ties and the last steps before
+    // the saturation
+    const std::vector<float> edges = {1.0f, -1.0f, 1.5f, -1.5f, 1e10f, -1e10f, inf, -inf, 0.0f, -0.0f,
+                                      0.5f / 32768.0f, 1.5f / 32768.0f, -2.5f / 32768.0f,
+                                      32766.5f / 32768.0f, -32767.5f / 32768.0f, 32767.0f / 32768.0f};
+    const std::vector<float> in = makeInput<float>(edges, n, [](uint32_t &s)
+                                                   { return static_cast<float>(static_cast<int32_t>(nextRandom(s))) / 1073741824.0f; });
+    std::vector<int16_t> out(n), expected(n);
+    floatToPcm16(in.data(), n, out.data());
+    for (size_t i = 0; i < n; ++i)
+    {
+        const float v = std::min(32767.0f, std::max(-32768.0f, in[i] * 32768.0f));
+        expected[i] = static_cast<int16_t>(std::lrint(v));
+    }
+    return check("floatToPcm16", n, out, expected);
+}
+
+int main()
+{
+    bool ok = true;
+    for (size_t n : kLengths)
+    {
+        ok = testPcm16(n) && ok;
+        ok = testPcm24(n) && ok;
+        ok = testPcm32(n) && ok;
+        ok = testPcmU8(n) && ok;
+        ok = testFloatToPcm16(n) && ok;
+    }
+    std::cout << (ok ? "Every conversion matches the scalar loop" : "Conversions differ from the scalar loop") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#ifndef KRISP_AUDIO_SDK_AL_HPP
+#define KRISP_AUDIO_SDK_AL_HPP
+
+#include <memory>
+
+#include "krisp-audio-sdk.hpp"
+
+
+namespace Krisp {
+namespace AudioSdk {
+
+struct AlSessionConfig {
+	SamplingRate inputSampleRate;
+	FrameDuration inputFrameDuration;
+	SamplingRate outputSampleRate;
+	ModelInfo * modelInfo;
+	ModelInfo * voiceModelInfo;
+};
+
+template <typename SamplingFormat>
+class Al {
+public:
+	virtual ~Al() = default;
+
+	// Throws std::exception on invalid configuration or model load failure
+	static std::shared_ptr<Al> create(const AlSessionConfig & config);
+
+	virtual void process(
+		const SamplingFormat * frameIn,
+		size_t frameInSize,
+		SamplingFormat * frameOut,
+		size_t frameOutSize) = 0;
+};
+
+} // namespace AudioSdk
+} // namespace Krisp
+
+#endif
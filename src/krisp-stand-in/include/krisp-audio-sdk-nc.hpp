@@ -0,0 +1,72 @@
+#ifndef KRISP_AUDIO_SDK_NC_HPP
+#define KRISP_AUDIO_SDK_NC_HPP
+
+#include <memory>
+
+#include "krisp-audio-sdk.hpp"
+
+
+namespace Krisp {
+namespace AudioSdk {
+
+struct RingtoneCfg {
+	ModelInfo * modelInfo;
+};
+
+struct NcSessionConfig {
+	SamplingRate inputSampleRate;
+	FrameDuration inputFrameDuration;
+	SamplingRate outputSampleRate;
+	ModelInfo * modelInfo;
+	bool enableSessionStats;
+	RingtoneCfg * ringtoneCfg;
+};
+
+struct EnergyInfo {
+	uint32_t voiceEnergy; // 0 - 100
+	uint32_t noiseEnergy; // 0 - 100
+};
+
+struct PerFrameStats {
+	EnergyInfo energy;
+};
+
+struct NoiseStats {
+	uint32_t noNoiseMs;
+	uint32_t lowNoiseMs;
+	uint32_t mediumNoiseMs;
+	uint32_t highNoiseMs;
+};
+
+struct VoiceStats {
+	uint32_t talkTimeMs;
+};
+
+struct SessionStats {
+	NoiseStats noiseStats;
+	VoiceStats voiceStats;
+};
+
+template <typename SamplingFormat>
+class Nc {
+public:
+	virtual ~Nc() = default;
+
+	// Throws std::exception on invalid configuration or model load failure
+	static std::shared_ptr<Nc> create(const NcSessionConfig & config);
+
+	virtual void process(
+		const SamplingFormat * frameIn,
+		size_t frameInSize,
+		SamplingFormat * frameOut,
+		size_t frameOutSize,
+		float noiseSuppressionLevel,
+		PerFrameStats * frameStats = nullptr) = 0;
+
+	virtual void getSessionStats(SessionStats * sessionStats) = 0;
+};
+
+} // namespace AudioSdk
+} // namespace Krisp
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef KRISP_AUDIO_SDK_HPP
+#define KRISP_AUDIO_SDK_HPP
+
+// Local stand-in for the Krisp Audio SDK C++ API. It implements the same
+// surface as the SDK package so the samples can be built, profiled and
+// tested without the proprietary libraries. See README.md.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+namespace Krisp {
+namespace AudioSdk {
+
+enum class SamplingRate : uint32_t {
+	Sr8000Hz = 8000,
+	Sr16000Hz = 16000,
+	Sr32000Hz = 32000,
+	Sr44100Hz = 44100,
+	Sr48000Hz = 48000,
+	Sr88200Hz = 88200,
+	Sr96000Hz = 96000
+};
+
+enum class FrameDuration : uint32_t {
+	Fd10ms = 10,
+	Fd15ms = 15,
+	Fd20ms = 20,
+	Fd30ms = 30,
+	Fd32ms = 32
+};
+
+// The model is loaded from the path unless the in-memory blob is set. The
+// blob is used in place and must stay valid while its sessions exist.
+struct ModelBlob {
+	const uint8_t * data = nullptr;
+	size_t size = 0;
+};
+
+struct ModelInfo {
+	std::wstring path;
+	ModelBlob blob;
+};
+
+void globalInit(const std::wstring & workingPath);
+void globalDestroy();
+
+} // namespace AudioSdk
+} // namespace Krisp
+
+#endif
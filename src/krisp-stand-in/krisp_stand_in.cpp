@@ -0,0 +1,266 @@
+#include <krisp-audio-sdk.hpp>
+#include <krisp-audio-sdk-nc.hpp>
+#include <krisp-audio-sdk-al.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <locale>
+#include <codecvt>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "spectral_gate.hpp"
+
+
+namespace Krisp {
+namespace AudioSdk {
+
+static std::atomic<bool> g_initialized{false};
+static std::atomic<unsigned> g_costFactor{1};
+
+// KRISP_STAND_IN_COST multiplies the spectral analysis work per frame
+void globalInit(const std::wstring &) {
+	unsigned costFactor = 1;
+	if (const char * cost = std::getenv("KRISP_STAND_IN_COST")) {
+		costFactor = static_cast<unsigned>(std::max(1l, std::strtol(cost, nullptr, 10)));
+	}
+	g_costFactor = costFactor;
+	g_initialized = true;
+}
+
+void globalDestroy() {
+	g_initialized = false;
+}
+
+static void checkInitialized() {
+	if (!g_initialized) {
+		throw std::logic_error("globalInit() must be called before creating a session");
+	}
+}
+
+// Parsing a real model reads all of it, the sum keeps the loop
+static std::atomic<uint32_t> g_modelSum{0};
+
+static void parseModel(const uint8_t * data, size_t size) {
+	uint32_t sum = 0;
+	for (size_t i = 0; i < size; ++i) {
+		sum += data[i];
+	}
+	g_modelSum.store(sum, std::memory_order_relaxed);
+}
+
+// The stand-in has no weights. A model loaded from the path is kept by the
+// session like the weights of a real model, a blob is read in place and
+// must outlive the session. The model must not be empty.
+static std::vector<char> loadModel(const ModelInfo * modelInfo) {
+	if (modelInfo == nullptr) {
+		throw std::invalid_argument("The model info is not set");
+	}
+	if (modelInfo->blob.data != nullptr) {
+		if (modelInfo->blob.size == 0) {
+			throw std::invalid_argument("The model blob is empty");
+		}
+		parseModel(modelInfo->blob.data, modelInfo->blob.size);
+		return std::vector<char>();
+	}
+	std::wstring_convert<std::codecvt_utf8<wchar_t>> wstringConverter;
+	std::string path = wstringConverter.to_bytes(modelInfo->path);
+	std::ifstream model(path, std::ios::binary | std::ios::ate);
+	std::vector<char> content;
+	const std::streamoff size = model ? static_cast<std::streamoff>(model.tellg()) : 0;
+	if (size > 0) {
+		content.resize(static_cast<size_t>(size));
+		model.seekg(0);
+		if (!model.read(content.data(), size)) {
+			content.clear();
+		}
+	}
+	if (content.empty()) {
+		throw std::runtime_error("Failed to load the model: " + path);
+	}
+	parseModel(reinterpret_cast<const uint8_t *>(content.data()), content.size());
+	return content;
+}
+
+static size_t getFrameSize(SamplingRate rate, FrameDuration duration) {
+	return static_cast<size_t>(rate) * static_cast<size_t>(duration) / 1000;
+}
+
+static void checkFrameSizes(size_t frameInSize, size_t expectedIn,
+		size_t frameOutSize, size_t expectedOut) {
+	if (frameInSize != expectedIn || frameOutSize != expectedOut) {
+		throw std::invalid_argument("The frame size does not match the session configuration");
+	}
+}
+
+static float toFloat(int16_t sample) {
+	return static_cast<float>(sample) / 32768.0f;
+}
+
+static float toFloat(float sample) {
+	return sample;
+}
+
+static void fromFloat(float sample, int16_t & out) {
+	float scaled = std::round(sample * 32768.0f);
+	out = static_cast<int16_t>(std::max(-32768.0f, std::min(32767.0f, scaled)));
+}
+
+static void fromFloat(float sample, float & out) {
+	out = sample;
+}
+
+// Runs the spectral gate on the input rate and converts the result to the
+// output rate with a linear interpolation
+template <typename SamplingFormat>
+class GateChannel {
+private:
+	SpectralGate m_gate;
+	std::vector<float> m_in;
+	std::vector<float> m_out;
+	size_t m_outSize;
+
+public:
+	GateChannel(size_t inSize, size_t outSize) :
+		m_gate(inSize, g_costFactor.load()),
+		m_in(inSize),
+		m_out(inSize),
+		m_outSize{outSize} {
+	}
+
+	void process(const SamplingFormat * frameIn, SamplingFormat * frameOut,
+			float level, SpectralGateStats * stats) {
+		const size_t inSize = m_in.size();
+		for (size_t i = 0; i < inSize; ++i) {
+			m_in[i] = toFloat(frameIn[i]);
+		}
+		m_gate.process(m_in.data(), m_out.data(), level, stats);
+		if (m_outSize == inSize) {
+			for (size_t i = 0; i < inSize; ++i) {
+				fromFloat(m_out[i], frameOut[i]);
+			}
+			return;
+		}
+		for (size_t i = 0; i < m_outSize; ++i) {
+			float pos = static_cast<float>(i) * static_cast<float>(inSize) /
+				static_cast<float>(m_outSize);
+			size_t i0 = static_cast<size_t>(pos);
+			size_t i1 = std::min(i0 + 1, inSize - 1);
+			float frac = pos - static_cast<float>(i0);
+			fromFloat(m_out[i0] + frac * (m_out[i1] - m_out[i0]), frameOut[i]);
+		}
+	}
+};
+
+template <typename SamplingFormat>
+class NcStandIn : public Nc<SamplingFormat> {
+private:
+	size_t m_inSize;
+	size_t m_outSize;
+	uint32_t m_frameMs;
+	bool m_withStats;
+	GateChannel<SamplingFormat> m_channel;
+	SessionStats m_sessionStats;
+	std::vector<char> m_model;
+
+public:
+	NcStandIn(const NcSessionConfig & config, std::vector<char> model) :
+		m_inSize{getFrameSize(config.inputSampleRate, config.inputFrameDuration)},
+		m_outSize{getFrameSize(config.outputSampleRate, config.inputFrameDuration)},
+		m_frameMs{static_cast<uint32_t>(config.inputFrameDuration)},
+		m_withStats{config.enableSessionStats},
+		m_channel(m_inSize, m_outSize),
+		m_sessionStats{},
+		m_model(std::move(model)) {
+	}
+
+	void process(const SamplingFormat * frameIn, size_t frameInSize,
+			SamplingFormat * frameOut, size_t frameOutSize,
+			float noiseSuppressionLevel, PerFrameStats * frameStats) override {
+		checkFrameSizes(frameInSize, m_inSize, frameOutSize, m_outSize);
+		SpectralGateStats stats{};
+		m_channel.process(frameIn, frameOut, noiseSuppressionLevel,
+			(frameStats || m_withStats) ? &stats : nullptr);
+		if (frameStats) {
+			frameStats->energy.voiceEnergy = stats.voiceEnergy;
+			frameStats->energy.noiseEnergy = stats.noiseEnergy;
+		}
+		if (m_withStats) {
+			NoiseStats & noise = m_sessionStats.noiseStats;
+			if (stats.noiseFloorDb < -70.0f) {
+				noise.noNoiseMs += m_frameMs;
+			} else if (stats.noiseFloorDb < -55.0f) {
+				noise.lowNoiseMs += m_frameMs;
+			} else if (stats.noiseFloorDb < -40.0f) {
+				noise.mediumNoiseMs += m_frameMs;
+			} else {
+				noise.highNoiseMs += m_frameMs;
+			}
+			if (stats.voice) {
+				m_sessionStats.voiceStats.talkTimeMs += m_frameMs;
+			}
+		}
+	}
+
+	void getSessionStats(SessionStats * sessionStats) override {
+		if (!m_withStats) {
+			throw std::logic_error("The session is created without the stats");
+		}
+		*sessionStats = m_sessionStats;
+	}
+};
+
+template <typename SamplingFormat>
+std::shared_ptr<Nc<SamplingFormat>> Nc<SamplingFormat>::create(
+		const NcSessionConfig & config) {
+	checkInitialized();
+	std::vector<char> model = loadModel(config.modelInfo);
+	if (config.ringtoneCfg) {
+		loadModel(config.ringtoneCfg->modelInfo);
+	}
+	return std::make_shared<NcStandIn<SamplingFormat>>(config, std::move(model));
+}
+
+// AL keeps the signal, the gate runs with no suppression so the cost is
+// comparable to NC
+template <typename SamplingFormat>
+class AlStandIn : public Al<SamplingFormat> {
+private:
+	size_t m_inSize;
+	size_t m_outSize;
+	GateChannel<SamplingFormat> m_channel;
+
+public:
+	explicit AlStandIn(const AlSessionConfig & config) :
+		m_inSize{getFrameSize(config.inputSampleRate, config.inputFrameDuration)},
+		m_outSize{getFrameSize(config.outputSampleRate, config.inputFrameDuration)},
+		m_channel(m_inSize, m_outSize) {
+	}
+
+	void process(const SamplingFormat * frameIn, size_t frameInSize,
+			SamplingFormat * frameOut, size_t frameOutSize) override {
+		checkFrameSizes(frameInSize, m_inSize, frameOutSize, m_outSize);
+		m_channel.process(frameIn, frameOut, 0.0f, nullptr);
+	}
+};
+
+template <typename SamplingFormat>
+std::shared_ptr<Al<SamplingFormat>> Al<SamplingFormat>::create(
+		const AlSessionConfig & config) {
+	checkInitialized();
+	loadModel(config.modelInfo);
+	loadModel(config.voiceModelInfo);
+	return std::make_shared<AlStandIn<SamplingFormat>>(config);
+}
+
+template class Nc<int16_t>;
+template class Nc<float>;
+template class Al<int16_t>;
+template class Al<float>;
+
+} // namespace AudioSdk
+} // namespace Krisp
@@ -0,0 +1,157 @@
+#include "spectral_gate.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+static const float kPi = 3.14159265358979f;
+
+static size_t nextPow2(size_t n) {
+	size_t r = 1;
+	while (r < n) {
+		r <<= 1;
+	}
+	return r;
+}
+
+static float toDb(float power) {
+	return 10.0f * std::log10(power + 1e-12f);
+}
+
+// Maps [-90, 0] dBFS to [0, 100]
+static uint32_t dbToEnergy(float db) {
+	float energy = (db + 90.0f) * 100.0f / 90.0f;
+	return static_cast<uint32_t>(std::lround(std::min(100.0f, std::max(0.0f, energy))));
+}
+
+SpectralGate::SpectralGate(size_t frameSize, unsigned costFactor) :
+	m_frameSize{frameSize},
+	m_fftSize{nextPow2(2 * frameSize)},
+	m_costFactor{std::max(1u, costFactor)},
+	m_window(2 * frameSize),
+	m_history(frameSize, 0.0f),
+	m_overlap(frameSize, 0.0f),
+	m_noise(m_fftSize / 2 + 1, 0.0f),
+	m_gain(m_fftSize / 2 + 1, 1.0f),
+	m_spectrum(m_fftSize),
+	m_scratch(m_fftSize),
+	m_twiddles(m_fftSize / 2),
+	m_bitReverse(m_fftSize),
+	m_hasNoiseEstimate{false} {
+	// sqrt-Hann, the squared windows of two neighbour frames sum up to one
+	for (size_t n = 0; n < m_window.size(); ++n) {
+		m_window[n] = std::sin(kPi * (static_cast<float>(n) + 0.5f) /
+			static_cast<float>(m_window.size()));
+	}
+	for (size_t k = 0; k < m_twiddles.size(); ++k) {
+		float phase = -2.0f * kPi * static_cast<float>(k) / static_cast<float>(m_fftSize);
+		m_twiddles[k] = std::complex<float>(std::cos(phase), std::sin(phase));
+	}
+	size_t bits = 0;
+	while ((size_t{1} << bits) < m_fftSize) {
+		++bits;
+	}
+	for (size_t i = 0; i < m_fftSize; ++i) {
+		size_t r = 0;
+		for (size_t b = 0; b < bits; ++b) {
+			r |= ((i >> b) & 1) << (bits - 1 - b);
+		}
+		m_bitReverse[i] = r;
+	}
+}
+
+// Iterative radix-2 FFT, the inverse transform is not normalized
+void SpectralGate::fft(std::vector<std::complex<float>> & data, bool inverse) const {
+	for (size_t i = 0; i < m_fftSize; ++i) {
+		if (i < m_bitReverse[i]) {
+			std::swap(data[i], data[m_bitReverse[i]]);
+		}
+	}
+	for (size_t len = 2; len <= m_fftSize; len <<= 1) {
+		size_t half = len / 2;
+		size_t step = m_fftSize / len;
+		for (size_t start = 0; start < m_fftSize; start += len) {
+			for (size_t k = 0; k < half; ++k) {
+				std::complex<float> w = m_twiddles[k * step];
+				if (inverse) {
+					w = std::conj(w);
+				}
+				std::complex<float> t = w * data[start + k + half];
+				data[start + k + half] = data[start + k] - t;
+				data[start + k] += t;
+			}
+		}
+	}
+}
+
+void SpectralGate::process(const float * in, float * out,
+		float suppressionLevel, SpectralGateStats * stats) {
+	const size_t n = m_frameSize;
+	const size_t nBins = m_fftSize / 2 + 1;
+
+	// Analysis window over the previous and the current frame
+	std::fill(m_spectrum.begin(), m_spectrum.end(), std::complex<float>(0.0f, 0.0f));
+	for (size_t i = 0; i < n; ++i) {
+		m_spectrum[i] = m_history[i] * m_window[i];
+		m_spectrum[n + i] = in[i] * m_window[n + i];
+	}
+	std::copy(in, in + n, m_history.begin());
+
+	// The extra analysis passes only burn the configured CPU cost
+	for (unsigned c = 1; c < m_costFactor; ++c) {
+		m_scratch = m_spectrum;
+		fft(m_scratch, false);
+	}
+	fft(m_spectrum, false);
+
+	// Noise floor tracking, fast to follow the power down and slow up
+	const float scale = 1.0f / static_cast<float>(m_fftSize);
+	float signalPower = 0.0f;
+	float noisePower = 0.0f;
+	for (size_t k = 0; k < nBins; ++k) {
+		float power = std::norm(m_spectrum[k]) * scale;
+		if (!m_hasNoiseEstimate) {
+			m_noise[k] = power;
+		} else if (power < m_noise[k]) {
+			m_noise[k] = 0.9f * m_noise[k] + 0.1f * power;
+		} else {
+			m_noise[k] = 0.995f * m_noise[k] + 0.005f * power;
+		}
+		signalPower += power;
+		noisePower += m_noise[k];
+	}
+	m_hasNoiseEstimate = true;
+
+	// Wiener like gain limited by the suppression level
+	float level = std::min(100.0f, std::max(0.0f, suppressionLevel)) / 100.0f;
+	float minGain = 1.0f - 0.9f * level;
+	for (size_t k = 0; k < nBins; ++k) {
+		float power = std::norm(m_spectrum[k]) * scale;
+		float gain = 1.0f - 2.0f * m_noise[k] / (power + 1e-12f);
+		gain = std::max(minGain, std::min(1.0f, gain));
+		m_gain[k] = 0.6f * m_gain[k] + 0.4f * gain;
+		m_spectrum[k] *= m_gain[k];
+		if (k != 0 && k != nBins - 1) {
+			m_spectrum[m_fftSize - k] = std::conj(m_spectrum[k]);
+		}
+	}
+
+	fft(m_spectrum, true);
+
+	// Synthesis window and overlap-add, the first half completes the
+	// previous frame
+	for (size_t i = 0; i < n; ++i) {
+		float y = m_spectrum[i].real() * scale * m_window[i];
+		out[i] = m_overlap[i] + y;
+		m_overlap[i] = m_spectrum[n + i].real() * scale * m_window[n + i];
+	}
+
+	if (stats) {
+		float voicePower = std::max(0.0f, signalPower - noisePower);
+		float frameNorm = 1.0f / static_cast<float>(n);
+		stats->noiseFloorDb = toDb(noisePower * frameNorm);
+		stats->noiseEnergy = dbToEnergy(stats->noiseFloorDb);
+		stats->voiceEnergy = dbToEnergy(toDb(voicePower * frameNorm));
+		stats->voice = signalPower > 4.0f * noisePower && stats->voiceEnergy > 20;
+	}
+}
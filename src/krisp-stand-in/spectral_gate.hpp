@@ -0,0 +1,52 @@
+#ifndef SPECTRAL_GATE_HPP
+#define SPECTRAL_GATE_HPP
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+struct SpectralGateStats {
+	uint32_t voiceEnergy; // 0 - 100
+	uint32_t noiseEnergy; // 0 - 100
+	float noiseFloorDb;   // dBFS
+	bool voice;
+};
+
+// Deterministic spectral gate running on frames of a fixed size. Every frame
+// is analysed together with the previous one through a sqrt-Hann window and
+// the result is overlap-added, so the output is delayed by one frame.
+// costFactor repeats the spectral analysis to scale the CPU cost.
+class SpectralGate {
+private:
+	size_t m_frameSize;
+	size_t m_fftSize;
+	unsigned m_costFactor;
+	std::vector<float> m_window;
+	std::vector<float> m_history;
+	std::vector<float> m_overlap;
+	std::vector<float> m_noise;
+	std::vector<float> m_gain;
+	std::vector<std::complex<float>> m_spectrum;
+	std::vector<std::complex<float>> m_scratch;
+	std::vector<std::complex<float>> m_twiddles;
+	std::vector<size_t> m_bitReverse;
+	bool m_hasNoiseEstimate;
+
+	void fft(std::vector<std::complex<float>> & data, bool inverse) const;
+
+public:
+	SpectralGate(size_t frameSize, unsigned costFactor);
+
+	size_t getFrameSize() const {
+		return m_frameSize;
+	}
+
+	// in and out hold getFrameSize() samples in [-1, 1], in place is allowed.
+	// suppressionLevel in [0, 100], 0 leaves the signal untouched.
+	void process(const float * in, float * out, float suppressionLevel,
+		SpectralGateStats * stats);
+};
+
+#endif
@@ -0,0 +1,682 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "argument_parser.hpp"
+#include "sound_file.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// ctest reports a test that returns this code as skipped
+static const int kSkipCode = 77;
+static const double kPi = 3.14159265358979323846;
+
+template <typename T>
+int error(const T &e)
+{
+    std::cerr << e << std::endl;
+    return 1;
+}
+
+struct PerfCase
+{
+    std::string name; // <rate>-<s16|f32>-<seconds>s
+    unsigned rate;
+    SoundFileFormat format;
+    unsigned seconds;
+};
+
+// One baseline entry. The checksum is the FNV-1a hash of the output file,
+// the levels are compared instead of it when a tolerance is given.
+struct PerfResult
+{
+    std::string checksum;
+    double rmsDb;
+    double peakDb;
+    double throughput; // seconds of audio per second of wall time
+    double latencyUs;  // mean processing time of a frame
+    double p99Us;      // upper bound of the bucket, reported only
+    double peakRssKiB;
+};
+
+struct PerfConfig
+{
+    std::string caseName;
+    std::string ncPath;
+    std::string modelPath;
+    std::string corpusDir;
+    std::string workDir;
+    std::string baselinePath;
+    // Timings of this host, empty when the timings are only reported
+    std::string timingBaselinePath;
+    double thresholdPercent;
+    double toleranceDb;
+    unsigned repeats;
+    bool update;
+};
+
+static bool parseCase(const std::string &name, PerfCase &perfCase)
+{
+    char format[4] = {};
+    unsigned rate = 0, seconds = 0;
+    char suffix = 0;
+    if (std::sscanf(name.c_str(), "%u-%3[a-z0-9]-%u%c", &rate, format, &seconds, &suffix) != 4 ||
+        suffix != 's' || seconds == 0)
+    {
+        return false;
+    }
+    static const unsigned supportedRates[] = {8000, 16000, 32000, 44100, 48000, 88200, 96000};
+    if (std::find(std::begin(supportedRates), std::end(supportedRates), rate) == std::end(supportedRates))
+    {
+        return false;
+    }
+    if (std::string(format) == "s16")
+    {
+        perfCase.format = SoundFileFormat::PCM16;
+    }
+    else if (std::string(format) == "f32")
+    {
+        perfCase.format = SoundFileFormat::FLOAT;
+    }
+    else
+    {
+        return false;
+    }
+    perfCase.name = name;
+    perfCase.rate = rate;
+    perfCase.seconds = seconds;
+    return true;
+}
+
+static bool fileExists(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+// Speech-like input that is the same on every machine: a voiced tone with
+// a gliding pitch and five harmonics, shaped into syllables at 4 Hz, over
+// white noise at about -45 dBFS. Every fifth second ends in 300 ms of
+// digital silence. The input is written next to its final name and renamed,
+// an interrupted run does not leave a short file in the corpus.
+static bool generateInput(const PerfCase &perfCase, const std::string &path)
+{
+    const std::string tmpPath = path + ".tmp";
+    SoundFileWriter writer;
+    writer.open(tmpPath, perfCase.rate, perfCase.format);
+    if (writer.getHasError())
+    {
+        std::cerr << writer.getErrorMsg() << std::endl;
+        return false;
+    }
+    const double rate = perfCase.rate;
+    std::vector<float> second(perfCase.rate);
+    uint32_t noiseState = 0x12345678u;
+    double phase = 0.0;
+    for (unsigned s = 0; s < perfCase.seconds; ++s)
+    {
+        for (unsigned i = 0; i < perfCase.rate; ++i)
+        {
+            const double t = s + i / rate;
+            const double pitch = 150.0 + 50.0 * std::sin(2.0 * kPi * 0.3 * t);
+            phase += 2.0 * kPi * pitch / rate;
+            if (phase > 2.0 * kPi)
+            {
+                phase -= 2.0 * kPi;
+            }
+            double voice = 0.0;
+            for (int h = 1; h <= 5; ++h)
+            {
+                voice += std::sin(h * phase) / h;
+            }
+            const double syllable = std::fabs(std::sin(2.0 * kPi * 2.0 * t));
+            noiseState = noiseState * 1664525u + 1013904223u;
+            const double noise = (static_cast<double>(noiseState >> 8) / 8388608.0 - 1.0) * 0.01;
+            const bool silent = s % 5 == 4 && i >= perfCase.rate - perfCase.rate * 3 / 10;
+            second[i] = silent ? 0.0f : static_cast<float>(0.2 * syllable * voice + noise);
+        }
+        writer.writeFramesFloat(second.data(), static_cast<int64_t>(second.size()));
+    }
+    writer.close();
+    if (writer.getHasError())
+    {
+        std::cerr << writer.getErrorMsg() << std::endl;
+        return false;
+    }
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+// Runs the command and waits for it, the peak RSS is the one of the child
+static bool runCommand(const std::vector<std::string> &args, double &wallSeconds, double &peakRssKiB)
+{
+    std::vector<char *> argv;
+    for (const std::string &arg : args)
+    {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    const Clock::time_point start = Clock::now();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        std::cerr << "fork: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (pid == 0)
+    {
+        // The stats of sample-nc are not part of the report
+        if (freopen("/dev/null", "w", stdout) == nullptr)
+        {
+            _exit(127);
+        }
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+    int status = 0;
+    rusage usage{};
+    if (wait4(pid, &status, 0, &usage) != pid)
+    {
+        std::cerr << "wait4: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+#ifdef __APPLE__
+    peakRssKiB = static_cast<double>(usage.ru_maxrss) / 1024.0;
+#else
+    peakRssKiB = static_cast<double>(usage.ru_maxrss);
+#endif
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        std::cerr << args[0] << " failed with status " << status << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Mean and p99 of nc_process_seconds in the metrics file of sample-nc
+static bool readLatency(const std::string &path, double &latencyUs, double &p99Us)
+{
+    std::ifstream in(path);
+    std::string line;
+    std::vector<std::pair<double, double>> buckets;
+    double sum = 0.0, count = 0.0;
+    while (std::getline(in, line))
+    {
+        double le = 0.0, value = 0.0;
+        if (std::sscanf(line.c_str(), "nc_process_seconds_bucket{le=\"%lf\"} %lf", &le, &value) == 2)
+        {
+            buckets.emplace_back(le, value);
+        }
+        else if (std::sscanf(line.c_str(), "nc_process_seconds_sum %lf", &value) == 1)
+        {
+            sum = value;
+        }
+        else if (std::sscanf(line.c_str(), "nc_process_seconds_count %lf", &value) == 1)
+        {
+            count = value;
+        }
+    }
+    if (count == 0.0)
+    {
+        return false;
+    }
+    latencyUs = sum / count * 1e6;
+    p99Us = 0.0;
+    for (const auto &bucket : buckets)
+    {
+        if (bucket.second >= 0.99 * count)
+        {
+            p99Us = bucket.first * 1e6;
+            break;
+        }
+    }
+    return true;
+}
+
+static std::string hashFile(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::vector<char> buffer(1 << 16);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    while (in.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || in.gcount() > 0)
+    {
+        for (std::streamsize i = 0; i < in.gcount(); ++i)
+        {
+            hash = (hash ^ static_cast<uint8_t>(buffer[static_cast<size_t>(i)])) * 0x100000001b3ull;
+        }
+    }
+    std::ostringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return out.str();
+}
+
+static bool measureOutput(const std::string &path, double &rmsDb, double &peakDb)
+{
+    SoundFile file;
+    file.loadHeader(path);
+    if (file.getHasError())
+    {
+        std::cerr << file.getErrorMsg() << std::endl;
+        return false;
+    }
+    std::vector<float> frames(1 << 16);
+    double sumSquares = 0.0, peak = 0.0;
+    uint64_t n = 0;
+    int64_t nRead;
+    while ((nRead = file.readFramesFloat(frames.data(), static_cast<int64_t>(frames.size()))) > 0)
+    {
+        for (int64_t i = 0; i < nRead; ++i)
+        {
+            const double x = frames[static_cast<size_t>(i)];
+            sumSquares += x * x;
+            peak = std::max(peak, std::fabs(x));
+        }
+        n += static_cast<uint64_t>(nRead);
+    }
+    // -200 dBFS stands for digital silence, the JSON has no infinity
+    rmsDb = n != 0 && sumSquares > 0.0 ? 10.0 * std::log10(sumSquares / static_cast<double>(n)) : -200.0;
+    peakDb = peak > 0.0 ? 20.0 * std::log10(peak) : -200.0;
+    return true;
+}
+
+// The baseline is an object of case names to objects of fields, the small
+// subset of JSON written by writeBaseline()
+class BaselineParser
+{
+private:
+    const std::string &m_text;
+    size_t m_pos;
+
+    void skipSpace()
+    {
+        while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos])))
+        {
+            ++m_pos;
+        }
+    }
+
+    bool expect(char c)
+    {
+        skipSpace();
+        if (m_pos < m_text.size() && m_text[m_pos] == c)
+        {
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+
+    bool readString(std::string &value)
+    {
+        if (!expect('"'))
+        {
+            return false;
+        }
+        size_t end = m_text.find('"', m_pos);
+        if (end == std::string::npos)
+        {
+            return false;
+        }
+        value = m_text.substr(m_pos, end - m_pos);
+        m_pos = end + 1;
+        return true;
+    }
+
+    bool readValue(std::string &value)
+    {
+        skipSpace();
+        if (m_pos < m_text.size() && m_text[m_pos] == '"')
+        {
+            return readString(value);
+        }
+        size_t end = m_text.find_first_of(",} \t\r\n", m_pos);
+        if (end == std::string::npos || end == m_pos)
+        {
+            return false;
+        }
+        value = m_text.substr(m_pos, end - m_pos);
+        m_pos = end;
+        return true;
+    }
+
+    // Calls onItem(key) for every member of an object
+    template <typename F>
+    bool readObject(F onItem)
+    {
+        if (!expect('{'))
+        {
+            return false;
+        }
+        if (expect('}'))
+        {
+            return true;
+        }
+        do
+        {
+            std::string key;
+            if (!readString(key) || !expect(':') || !onItem(key))
+            {
+                return false;
+            }
+        } while (expect(','));
+        return expect('}');
+    }
+
+public:
+    explicit BaselineParser(const std::string &text) : m_text(text), m_pos(0) {}
+
+    bool parse(std::map<std::string, std::map<std::string, std::string>> &entries)
+    {
+        return readObject([&](const std::string &name)
+                          { return readObject([&](const std::string &field)
+                                              { return readValue(entries[name][field]); }); });
+    }
+};
+
+static bool readBaseline(const std::string &path, std::map<std::string, PerfResult> &baseline)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        return true;
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+    std::map<std::string, std::map<std::string, std::string>> entries;
+    if (!BaselineParser(text.str()).parse(entries))
+    {
+        return false;
+    }
+    for (auto &entry : entries)
+    {
+        auto number = [&](const char *field)
+        {
+            const std::string &value = entry.second[field];
+            return value.empty() ? 0.0 : std::strtod(value.c_str(), nullptr);
+        };
+        PerfResult &result = baseline[entry.first];
+        result.checksum = entry.second["checksum"];
+        result.rmsDb = number("rmsDb");
+        result.peakDb = number("peakDb");
+        result.throughput = number("throughput");
+        result.latencyUs = number("latencyUs");
+        result.p99Us = number("p99Us");
+        result.peakRssKiB = number("peakRssKiB");
+    }
+    return true;
+}
+
+// Replaced through a temporary file, the suite records one case at a time
+static bool writeBaseline(const std::string &path, const std::map<std::string, PerfResult> &baseline)
+{
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::trunc);
+        out << std::fixed << std::setprecision(6) << "{";
+        bool first = true;
+        for (const auto &entry : baseline)
+        {
+            const PerfResult &r = entry.second;
+            out << (first ? "\n" : ",\n") << "  \"" << entry.first << "\": {"
+                << "\"checksum\": \"" << r.checksum << "\", "
+                << "\"rmsDb\": " << r.rmsDb << ", "
+                << "\"peakDb\": " << r.peakDb << ", "
+                << "\"throughput\": " << r.throughput << ", "
+                << "\"latencyUs\": " << r.latencyUs << ", "
+                << "\"p99Us\": " << r.p99Us << ", "
+                << "\"peakRssKiB\": " << r.peakRssKiB << "}";
+            first = false;
+        }
+        out << "\n}\n";
+        if (!out.flush())
+        {
+            return false;
+        }
+    }
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+// Best throughput and latency and the highest peak RSS of the runs, the
+// output of every run must be the same
+static bool runCase(const PerfConfig &config, const PerfCase &perfCase, const std::string &inputPath,
+                    PerfResult &result)
+{
+    const std::string outputPath = config.workDir + "/" + perfCase.name + ".wav";
+    const std::string metricsPath = config.workDir + "/" + perfCase.name + ".prom";
+    std::vector<std::string> args = {config.ncPath, "-i", inputPath, "-o", outputPath,
+                                     "-m", config.modelPath, "-mf", metricsPath};
+    result = PerfResult{};
+    for (unsigned r = 0; r < config.repeats; ++r)
+    {
+        double wallSeconds = 0.0, peakRssKiB = 0.0, latencyUs = 0.0, p99Us = 0.0;
+        if (!runCommand(args, wallSeconds, peakRssKiB))
+        {
+            return false;
+        }
+        if (!readLatency(metricsPath, latencyUs, p99Us))
+        {
+            std::cerr << "No frame latencies in " << metricsPath << std::endl;
+            return false;
+        }
+        const std::string checksum = hashFile(outputPath);
+        if (r != 0 && checksum != result.checksum)
+        {
+            std::cerr << "The output differs between runs" << std::endl;
+            return false;
+        }
+        result.checksum = checksum;
+        result.throughput = std::max(result.throughput, perfCase.seconds / wallSeconds);
+        result.latencyUs = r == 0 ? latencyUs : std::min(result.latencyUs, latencyUs);
+        result.p99Us = r == 0 ? p99Us : std::min(result.p99Us, p99Us);
+        result.peakRssKiB = std::max(result.peakRssKiB, peakRssKiB);
+    }
+    bool measured = measureOutput(outputPath, result.rmsDb, result.peakDb);
+    // The long cases leave gigabytes of output otherwise
+    std::remove(outputPath.c_str());
+    std::remove(metricsPath.c_str());
+    return measured;
+}
+
+// The timings are compared with the timing baseline of the host, the other
+// values with the baseline
+static void printResult(const PerfResult &r, const PerfResult *baseline, const PerfResult *timingBaseline)
+{
+    auto line = [&](const char *name, double value, double baselineValue, const char *unit)
+    {
+        std::cout << "# - " << name << value << unit;
+        if (baseline != nullptr && baselineValue != 0.0)
+        {
+            std::cout << " (baseline " << baselineValue << unit << ", "
+                      << std::showpos << 100.0 * (value / baselineValue - 1.0) << std::noshowpos << " %)";
+        }
+        std::cout << std::endl;
+    };
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "# - Checksum    : " << r.checksum;
+    if (baseline != nullptr)
+    {
+        std::cout << (r.checksum == baseline->checksum ? " (matches)" : " (baseline " + baseline->checksum + ")");
+    }
+    std::cout << std::endl;
+    line("Output RMS  : ", r.rmsDb, baseline ? baseline->rmsDb : 0.0, " dBFS");
+    line("Output peak : ", r.peakDb, baseline ? baseline->peakDb : 0.0, " dBFS");
+    line("Throughput  : ", r.throughput, timingBaseline ? timingBaseline->throughput : 0.0, "x real time");
+    line("Latency     : ", r.latencyUs, timingBaseline ? timingBaseline->latencyUs : 0.0, " us per frame");
+    line("Latency p99 : ", r.p99Us, timingBaseline ? timingBaseline->p99Us : 0.0, " us or less");
+    line("Peak RSS    : ", r.peakRssKiB, baseline ? baseline->peakRssKiB : 0.0, " KiB");
+}
+
+// Returns the regressions, empty when the case passes. The timings are
+// checked only against a timing baseline recorded on the same host, they
+// do not carry over from the machine of the committed baseline.
+static std::vector<std::string> compare(const PerfConfig &config, const PerfResult &r, const PerfResult &b,
+                                        const PerfResult *t)
+{
+    std::vector<std::string> failures;
+    if (config.toleranceDb == 0.0)
+    {
+        if (r.checksum != b.checksum)
+        {
+            failures.push_back("the output checksum changed");
+        }
+    }
+    else if (std::fabs(r.rmsDb - b.rmsDb) > config.toleranceDb || std::fabs(r.peakDb - b.peakDb) > config.toleranceDb)
+    {
+        failures.push_back("the output level is off by more than " + std::to_string(config.toleranceDb) + " dB");
+    }
+    const double slack = config.thresholdPercent / 100.0;
+    if (r.peakRssKiB > b.peakRssKiB * (1.0 + slack))
+    {
+        failures.push_back("the peak RSS regressed");
+    }
+    if (t != nullptr && r.throughput < t->throughput * (1.0 - slack))
+    {
+        failures.push_back("the throughput regressed");
+    }
+    if (t != nullptr && r.latencyUs > t->latencyUs * (1.0 + slack))
+    {
+        failures.push_back("the frame latency regressed");
+    }
+    return failures;
+}
+
+static bool parseArgs(ArgumentParser &p, PerfConfig &config)
+{
+    p.addArgument("--case", "-c", IMPORTANT);
+    p.addArgument("--sample_nc", "-nc", IMPORTANT);
+    p.addArgument("--model_path", "-m", IMPORTANT);
+    p.addArgument("--corpus_dir", "-d", IMPORTANT);
+    p.addArgument("--work_dir", "-w", IMPORTANT);
+    p.addArgument("--baseline", "-b", IMPORTANT);
+    p.addArgument("--timing_baseline", "-tb");
+    p.addArgument("--threshold", "-th");
+    p.addArgument("--tolerance", "-tol");
+    p.addArgument("--repeats", "-r");
+    p.addArgument("--update", "-u", OPTIONAL);
+    if (!p.parse())
+    {
+        std::cerr << p.getError();
+        return false;
+    }
+    config.caseName = p.getArgument("-c");
+    config.ncPath = p.getArgument("-nc");
+    config.modelPath = p.getArgument("-m");
+    config.corpusDir = p.getArgument("-d");
+    config.workDir = p.getArgument("-w");
+    config.baselinePath = p.getArgument("-b");
+    config.timingBaselinePath = p.tryGetArgument("-tb", "");
+    config.thresholdPercent = std::atof(p.tryGetArgument("-th", "25").c_str());
+    config.toleranceDb = std::atof(p.tryGetArgument("-tol", "0").c_str());
+    config.repeats = static_cast<unsigned>(std::max(1, std::atoi(p.tryGetArgument("-r", "3").c_str())));
+    const char *update = std::getenv("NC_PERF_UPDATE");
+    config.update = p.getOptionalArgument("-u") || (update != nullptr && std::string(update) == "1");
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    ArgumentParser p(argc, argv);
+    PerfConfig config;
+    if (!parseArgs(p, config))
+    {
+        std::cerr << "\nUsage:\n\t" << argv[0]
+                  << " -c case -nc sample-nc -m model_path -d corpus_dir -w work_dir -b baseline.json"
+                  << " [-tb timing.json] [-th percent] [-tol dB] [-r repeats] [-u]"
+                  << "\nRuns sample-nc on the synthetic input of the case, rate-s16|f32-seconds"
+                  << "\nsuch as 16000-s16-10s, and compares the output and the peak RSS with"
+                  << "\nthe baseline. -u or NC_PERF_UPDATE=1 records the case in the baseline"
+                  << "\ninstead, a case missing from the baseline fails without it. The timings"
+                  << "\nare compared with the timing baseline of -tb, recorded by the first run"
+                  << "\nof the case on the host, and only reported without -tb." << std::endl;
+        return 1;
+    }
+    PerfCase perfCase;
+    if (!parseCase(config.caseName, perfCase))
+    {
+        return error("Invalid case: " + config.caseName);
+    }
+    if (!fileExists(config.modelPath))
+    {
+        std::cout << "Skipped, no model at " << config.modelPath << std::endl;
+        return kSkipCode;
+    }
+    mkdir(config.corpusDir.c_str(), 0755);
+    mkdir(config.workDir.c_str(), 0755);
+    const std::string inputPath = config.corpusDir + "/" + perfCase.name + ".wav";
+    if (!fileExists(inputPath) && !generateInput(perfCase, inputPath))
+    {
+        return error("Failed to generate the input: " + inputPath);
+    }
+
+    std::map<std::string, PerfResult> baseline;
+    if (!readBaseline(config.baselinePath, baseline))
+    {
+        return error("Failed to parse the baseline: " + config.baselinePath);
+    }
+    std::map<std::string, PerfResult> timingBaseline;
+    const bool timing = !config.timingBaselinePath.empty();
+    if (timing && !readBaseline(config.timingBaselinePath, timingBaseline))
+    {
+        return error("Failed to parse the timing baseline: " + config.timingBaselinePath);
+    }
+    auto found = baseline.find(perfCase.name);
+    auto timingFound = timingBaseline.find(perfCase.name);
+    if (!config.update && found == baseline.end())
+    {
+        // A test without a baseline would pass whatever the build does
+        return error("FAILED: " + perfCase.name + " is not in the baseline " + config.baselinePath +
+                     ", record it with -u or NC_PERF_UPDATE=1");
+    }
+    PerfResult result;
+    if (!runCase(config, perfCase, inputPath, result))
+    {
+        return error("Failed to run the case " + perfCase.name);
+    }
+    std::cout << "#--- " << perfCase.name << " ---" << std::endl;
+    const bool calibrate = timing && (config.update || timingFound == timingBaseline.end());
+    const PerfResult *timingResult = timing && !calibrate ? &timingFound->second : nullptr;
+    printResult(result, config.update ? nullptr : &found->second, timingResult);
+    if (calibrate)
+    {
+        // The calibration run of the host, the next runs are timed against it
+        timingBaseline[perfCase.name] = result;
+        if (!writeBaseline(config.timingBaselinePath, timingBaseline))
+        {
+            return error("Failed to write the timing baseline: " + config.timingBaselinePath);
+        }
+        std::cout << "Timings recorded in " << config.timingBaselinePath << std::endl;
+    }
+    if (config.update)
+    {
+        baseline[perfCase.name] = result;
+        if (!writeBaseline(config.baselinePath, baseline))
+        {
+            return error("Failed to write the baseline: " + config.baselinePath);
+        }
+        std::cout << "Recorded in " << config.baselinePath << std::endl;
+        return 0;
+    }
+    std::vector<std::string> failures = compare(config, result, found->second, timingResult);
+    for (const std::string &failure : failures)
+    {
+        std::cerr << "FAILED: " << failure << std::endl;
+    }
+    return failures.empty() ? 0 : 1;
+}
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -6,12 +8,24 @@
 
 #include <krisp-audio-sdk.hpp>
 #include <krisp-audio-sdk-al.hpp>
+#include <krisp-audio-sdk-nc.hpp>
 
 #include "argument_parser.hpp"
+#include "block_pipeline.hpp"
+#include "frame_duration.hpp"
+#include "resampler.hpp"
+#include "sampling_rate.hpp"
 #include "sound_file.hpp"
 
 using namespace Krisp::AudioSdk;
 
+// Number of AL frames read, processed and written at once
+constexpr size_t kFramesPerBlock = 100;
+// Number of blocks in flight between the NC and the AL stages
+constexpr size_t kPipelineDepth = 4;
+
+using Clock = std::chrono::steady_clock;
+
 template <typename T>
 int error(const T &e)
 {
@@ -20,19 +34,30 @@ int error(const T &e)
 }
 
 static bool parseArguments(std::string &input, std::string &output,
-                           std::string &weight, std::string &voiceModel, int argc, char **argv)
+                           std::string &weight, std::string &voiceModel, std::string &ncWeight,
+                           bool &resampleBack, unsigned &frameDurationMs, int argc, char **argv)
 {
     ArgumentParser p(argc, argv);
     p.addArgument("--input", "-i", IMPORTANT);
     p.addArgument("--output", "-o", IMPORTANT);
     p.addArgument("--model_path", "-m", IMPORTANT);
     p.addArgument("--voice_cfg", "-v", IMPORTANT);
+    p.addArgument("--resample_back", "-rb", OPTIONAL);
+    p.addArgument("--frame_duration", "-fd");
+    p.addArgument("--nc_model_path", "-nc");
     if (p.parse())
     {
         input = p.getArgument("-i");
         output = p.getArgument("-o");
         weight = p.getArgument("-m");
         voiceModel = p.getArgument("-v");
+        ncWeight = p.getArgument("-nc");
+        resampleBack = p.getOptionalArgument("-rb");
+        if (!parseFrameDuration(p.tryGetArgument("-fd", "10"), frameDurationMs))
+        {
+            std::cerr << "argument -fd should be one of " << getFrameDurationNames() << "!";
+            return false;
+        }
     }
     else
     {
@@ -42,63 +67,124 @@ static bool parseArguments(std::string &input, std::string &output,
     return true;
 }
 
-static std::pair<SamplingRate, bool> getKrispSamplingRate(uint32_t rate)
+static int64_t readFrames(const SoundFile &sndFile,
+                          int16_t *frames, int64_t nFrames)
 {
-    std::pair<SamplingRate, bool> result;
-    result.second = true;
-    switch (rate)
-    {
-    case 8000:
-        result.first = SamplingRate::Sr8000Hz;
-        break;
-    case 16000:
-        result.first = SamplingRate::Sr16000Hz;
-        break;
-    case 32000:
-        result.first = SamplingRate::Sr32000Hz;
-        break;
-    case 44100:
-        result.first = SamplingRate::Sr44100Hz;
-        break;
-    case 48000:
-        result.first = SamplingRate::Sr48000Hz;
-        break;
-    case 88200:
-        result.first = SamplingRate::Sr88200Hz;
-        break;
-    case 96000:
-        result.first = SamplingRate::Sr96000Hz;
-        break;
-    }
-    return result;
+    return sndFile.readFramesPCM16(frames, nFrames);
 }
 
-static void readAllFrames(const SoundFile &sndFile,
-                          std::vector<short> &frames)
+static int64_t readFrames(const SoundFile &sndFile,
+                          float *frames, int64_t nFrames)
 {
-    sndFile.readAllFramesPCM16(&frames);
+    return sndFile.readFramesFloat(frames, nFrames);
 }
 
-static void readAllFrames(const SoundFile &sndFile,
-                          std::vector<float> &frames)
+static void writeFrames(SoundFileWriter &sndFileWriter,
+                        const int16_t *frames, int64_t nFrames)
 {
-    sndFile.readAllFramesFloat(&frames);
+    sndFileWriter.writeFramesPCM16(frames, nFrames);
 }
 
-static std::pair<bool, std::string> WriteFramesToFile(
-    const std::string &fileName,
-    const std::vector<int16_t> &frames,
-    uint32_t samplingRate)
+static void writeFrames(SoundFileWriter &sndFileWriter,
+                        const float *frames, int64_t nFrames)
 {
-    return writeSoundFilePCM16(fileName, frames, samplingRate);
+    sndFileWriter.writeFramesFloat(frames, nFrames);
 }
 
-static std::pair<bool, std::string> WriteFramesToFile(
-    const std::string &fileName,
-    const std::vector<float> &frames,
-    uint32_t samplingRate)
+struct ChainStats
+{
+    double ncSeconds; // time spent in the NC stage, reading included
+    double alSeconds; // time spent in the AL stage
+    double wallSeconds;
+};
+
+// NC and AL run side by side on two threads of a block pipeline: the reader
+// thread decodes the file and writes the NC output frames straight into the
+// pipeline blocks, the calling thread runs AL on them and the writer thread
+// encodes the result. The blocks are preallocated and reused, so the NC
+// output never goes through an intermediate file or an extra copy.
+template <typename SamplingFormat>
+static std::pair<bool, std::string> chainNcAl(
+    const SoundFile &inSndFile,
+    SoundFileWriter &outSndFile,
+    Nc<SamplingFormat> &ncSession,
+    Al<SamplingFormat> &alSession,
+    uint32_t samplingRate,
+    uint32_t alSamplingRate,
+    uint32_t outSamplingRate,
+    size_t frameSize,
+    size_t blockSize,
+    ChainStats *chainStats)
 {
-    return writeSoundFileFloat(fileName, frames, samplingRate);
+    // The input is resampled before NC, the output after AL, and the
+    // frames in between stay at the AL rate
+    FrameResampler<SamplingFormat> ncResampler;
+    if (!ncResampler.init(samplingRate, alSamplingRate, alSamplingRate, frameSize, blockSize))
+    {
+        return std::make_pair(false, ncResampler.getErrorMsg());
+    }
+    FrameResampler<SamplingFormat> alResampler;
+    if (!alResampler.init(alSamplingRate, alSamplingRate, outSamplingRate, frameSize, ncResampler.getMaxOutput()))
+    {
+        return std::make_pair(false, alResampler.getErrorMsg());
+    }
+    std::vector<SamplingFormat> fileBlock(blockSize);
+
+    auto ncFrame = [&](const SamplingFormat *frameIn, SamplingFormat *frameOut)
+    {
+        ncSession.process(frameIn, frameSize, frameOut, frameSize, 100.0f, nullptr);
+    };
+    auto alFrame = [&](const SamplingFormat *frameIn, SamplingFormat *frameOut)
+    {
+        alSession.process(frameIn, frameSize, frameOut, frameSize);
+    };
+
+    Clock::duration ncTime{};
+    Clock::duration alTime{};
+    bool ncDone = false;
+    // Returns 0 once the NC stage is drained, which ends the pipeline
+    auto readBlock = [&](SamplingFormat *block, size_t) -> size_t
+    {
+        auto start = Clock::now();
+        size_t nOut = 0;
+        while (nOut == 0 && !ncDone)
+        {
+            int64_t nRead = readFrames(inSndFile, fileBlock.data(), static_cast<int64_t>(fileBlock.size()));
+            if (nRead > 0)
+            {
+                nOut = ncResampler.process(fileBlock.data(), static_cast<size_t>(nRead), block, ncFrame);
+            }
+            else
+            {
+                // The last frame of the file may be incomplete, it is padded with silence
+                nOut = ncResampler.flush(block, ncFrame);
+                ncDone = true;
+            }
+        }
+        ncTime += Clock::now() - start;
+        return nOut;
+    };
+    auto processBlock = [&](SamplingFormat *blockIn, SamplingFormat *blockOut, size_t nSamples) -> size_t
+    {
+        auto start = Clock::now();
+        size_t nOut = nSamples != 0 ? alResampler.process(blockIn, nSamples, blockOut, alFrame)
+                                    : alResampler.flush(blockOut, alFrame);
+        alTime += Clock::now() - start;
+        return nOut;
+    };
+    auto writeBlock = [&](const SamplingFormat *blockOut, size_t nSamples) -> bool
+    {
+        writeFrames(outSndFile, blockOut, static_cast<int64_t>(nSamples));
+        return !outSndFile.getHasError();
+    };
+
+    auto start = Clock::now();
+    BlockPipeline<SamplingFormat> pipeline(ncResampler.getMaxOutput(), kPipelineDepth, alResampler.getMaxOutput());
+    pipeline.run(readBlock, processBlock, writeBlock);
+    chainStats->wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    chainStats->ncSeconds = std::chrono::duration<double>(ncTime).count();
+    chainStats->alSeconds = std::chrono::duration<double>(alTime).count();
+    return std::make_pair(true, std::string());
 }
 
 template <typename SamplingFormat>
@@ -106,29 +192,48 @@ int alWavFileImpl(
     const SoundFile &inSndFile,
     const std::string &output,
     const std::string &weight,
-    const std::string &voiceModel)
+    const std::string &voiceModel,
+    const std::string &ncWeight,
+    bool resampleBack,
+    unsigned frameDurationMs)
 {
-    std::vector<SamplingFormat> wavDataIn;
-    readAllFrames(inSndFile, wavDataIn);
-
-    if (inSndFile.getHasError())
-    {
-        return error(inSndFile.getErrorMsg());
-    }
-
     uint32_t samplingRate = inSndFile.getHeader().getSamplingRate();
-    auto samplingRateResult = getKrispSamplingRate(samplingRate);
-    if (!samplingRateResult.second)
+    if (samplingRate == 0)
     {
         return error("Unsupported sample rate");
     }
+    // Rates the SDK does not support are resampled to the nearest supported
+    // one, and optionally back to the file rate after AL
+    const uint32_t alSamplingRate = getNearestKrispSamplingRate(samplingRate);
+    const uint32_t outSamplingRate = resampleBack ? samplingRate : alSamplingRate;
+    auto samplingRateResult = getKrispSamplingRate(alSamplingRate);
 
     SamplingRate inRate = samplingRateResult.first;
     const SamplingRate outRate = inRate;
-    constexpr FrameDuration frameDurationMillis = FrameDuration::Fd10ms;
-    size_t inputFrameSize = (samplingRate * static_cast<size_t>(frameDurationMillis)) / 1000;
+    const FrameDuration frameDurationMillis = static_cast<FrameDuration>(frameDurationMs);
+    size_t inputFrameSize = (alSamplingRate * static_cast<size_t>(frameDurationMillis)) / 1000;
     size_t outputFrameSize = inputFrameSize;
 
+    // The input is streamed through fixed size blocks of kFramesPerBlock
+    // frames, so the memory footprint does not depend on the file length.
+    // The resampler cuts them into AL frames and passes the input through
+    // when the file rate is supported.
+    FrameResampler<SamplingFormat> resampler;
+    const size_t blockSize = kFramesPerBlock * ((samplingRate * static_cast<size_t>(frameDurationMillis) + 999) / 1000);
+    if (!resampler.init(samplingRate, alSamplingRate, outSamplingRate, inputFrameSize, blockSize))
+    {
+        return error(resampler.getErrorMsg());
+    }
+    std::vector<SamplingFormat> blockIn(blockSize);
+    std::vector<SamplingFormat> blockOut(resampler.getMaxOutput());
+
+    SoundFileWriter outSndFile;
+    outSndFile.open(output, outSamplingRate, inSndFile.getHeader().getFormat());
+    if (outSndFile.getHasError())
+    {
+        return error(outSndFile.getErrorMsg());
+    }
+
     try
     {
         globalInit(L"");
@@ -151,21 +256,74 @@ int alWavFileImpl(
 
         std::shared_ptr<Al<SamplingFormat>> alSession = Al<SamplingFormat>::create(alCfg);
 
+        // With an NC model the file goes through NC first, in the same pass
+        std::shared_ptr<Nc<SamplingFormat>> ncSession;
+        ModelInfo ncModelInfo;
+        if (!ncWeight.empty())
+        {
+            ncModelInfo.path = wstringConverter.from_bytes(ncWeight);
+            NcSessionConfig ncCfg =
+                {
+                    inRate,
+                    frameDurationMillis,
+                    outRate,
+                    &ncModelInfo,
+                    false,
+                    nullptr // Ringtone model cfg for inbound
+                };
+            ncSession = Nc<SamplingFormat>::create(ncCfg);
+        }
+
         //
         // End of the SDK initialization
         // Start of the Stream's frame by frame processing
         //
 
-        std::vector<SamplingFormat> wavDataOut(wavDataIn.size() * outputFrameSize / inputFrameSize);
-        size_t i;
-
-        for (i = 0; (i + 1) * inputFrameSize <= wavDataIn.size(); ++i)
+        if (ncSession)
         {
-            alSession->process(
-                &wavDataIn[i * inputFrameSize],
-                static_cast<size_t>(inputFrameSize),
-                &wavDataOut[i * outputFrameSize],
-                static_cast<size_t>(outputFrameSize));
+            ChainStats chainStats{};
+            auto chainResult = chainNcAl(inSndFile, outSndFile, *ncSession, *alSession, samplingRate,
+                                         alSamplingRate, outSamplingRate, inputFrameSize, blockSize, &chainStats);
+            if (!chainResult.first)
+            {
+                alSession.reset();
+                ncSession.reset();
+                globalDestroy();
+                return error(chainResult.second);
+            }
+            std::cout << "NC stage " << chainStats.ncSeconds << " s, AL stage " << chainStats.alSeconds
+                      << " s, total " << chainStats.wallSeconds << " s" << std::endl;
+        }
+        else
+        {
+            auto processFrame = [&](const SamplingFormat *frameIn, SamplingFormat *frameOut)
+            {
+                alSession->process(
+                    frameIn,
+                    static_cast<size_t>(inputFrameSize),
+                    frameOut,
+                    static_cast<size_t>(outputFrameSize));
+            };
+
+            int64_t nRead;
+
+            while ((nRead = readFrames(inSndFile, blockIn.data(), static_cast<int64_t>(blockIn.size()))) > 0)
+            {
+                size_t nOut = resampler.process(blockIn.data(), static_cast<size_t>(nRead), blockOut.data(), processFrame);
+
+                // Write the processed block right away
+                writeFrames(outSndFile, blockOut.data(), static_cast<int64_t>(nOut));
+                if (outSndFile.getHasError())
+                {
+                    break;
+                }
+            }
+            if (!outSndFile.getHasError())
+            {
+                // The last frame of the file may be incomplete, it is padded with silence
+                size_t nOut = resampler.flush(blockOut.data(), processFrame);
+                writeFrames(outSndFile, blockOut.data(), static_cast<int64_t>(nOut));
+            }
         }
 
         //
@@ -175,14 +333,17 @@ int alWavFileImpl(
 
         // alSession is a shared_ptr. Need to make sure to free pointer before calling globalDestroy()
         alSession.reset();
+        ncSession.reset();
         globalDestroy();
 
-        // Write the output to the file
-        //wavDataOut.resize(i * outputFrameSize);
-        auto pairResult = WriteFramesToFile(output, wavDataOut, samplingRate);
-        if (!pairResult.first)
+        if (inSndFile.getHasError())
+        {
+            return error(inSndFile.getErrorMsg());
+        }
+        outSndFile.close();
+        if (outSndFile.getHasError())
         {
-            return error(pairResult.second);
+            return error(outSndFile.getErrorMsg());
         }
     }
     catch (const std::exception &ex)
@@ -198,7 +359,8 @@ int alWavFileImpl(
 }
 
 static int alWavFile(const std::string &input, const std::string &output,
-                     const std::string &weight, const std::string &voiceModel)
+                     const std::string &weight, const std::string &voiceModel, const std::string &ncWeight,
+                     bool resampleBack, unsigned frameDurationMs)
 {
     SoundFile inSndFile;
     inSndFile.loadHeader(input);
@@ -207,13 +369,17 @@ static int alWavFile(const std::string &input, const std::string &output,
         return error(inSndFile.getErrorMsg());
     }
     auto sndFileHeader = inSndFile.getHeader();
+    if (sndFileHeader.getNumberOfChannels() != 1)
+    {
+        return error("The sound file should be mono.");
+    }
     if (sndFileHeader.getFormat() == SoundFileFormat::PCM16)
     {
-        return alWavFileImpl<int16_t>(inSndFile, output, weight, voiceModel);
+        return alWavFileImpl<int16_t>(inSndFile, output, weight, voiceModel, ncWeight, resampleBack, frameDurationMs);
     }
     if (sndFileHeader.getFormat() == SoundFileFormat::FLOAT)
     {
-        return alWavFileImpl<float>(inSndFile, output, weight, voiceModel);
+        return alWavFileImpl<float>(inSndFile, output, weight, voiceModel, ncWeight, resampleBack, frameDurationMs);
     }
     return error("The sound file format should be PCM16 or FLOAT.");
 }
@@ -224,14 +390,17 @@ int main(int argc, char **argv)
     std::string out;
     std::string weight;
     std::string voiceModel;
-    
-    if (parseArguments(in, out, weight, voiceModel, argc, argv))
+    std::string ncWeight;
+    bool resampleBack = false;
+    unsigned frameDurationMs = 0;
+
+    if (parseArguments(in, out, weight, voiceModel, ncWeight, resampleBack, frameDurationMs, argc, argv))
     {
-        return alWavFile(in, out, weight, voiceModel);
+        return alWavFile(in, out, weight, voiceModel, ncWeight, resampleBack, frameDurationMs);
     }
     else
     {
-        std::cerr << "\nUsage:\n\t" << argv[0] << " -i input.wav -o output.wav -m model_path" << std::endl;
+        std::cerr << "\nUsage:\n\t" << argv[0] << " -i input.wav -o output.wav -m model_path -v voice_cfg [-nc nc_model_path] [-fd ms] [-rb]" << std::endl;
         if (argc == 1)
         {
             return 0;
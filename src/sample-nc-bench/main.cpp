@@ -0,0 +1,828 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <krisp-audio-sdk.hpp>
+#include <krisp-audio-sdk-nc.hpp>
+
+#include "argument_parser.hpp"
+#include "frame_duration.hpp"
+#include "latency_histogram.hpp"
+#include "model_cache.hpp"
+#include "model_cache_bench.hpp"
+#include "realtime_replay.hpp"
+#include "scheduled_load.hpp"
+#include "resampler.hpp"
+#include "thread_control.hpp"
+
+using namespace Krisp::AudioSdk;
+
+using Clock = std::chrono::steady_clock;
+
+template <typename T>
+int error(const T &e)
+{
+    std::cerr << e << std::endl;
+    return 1;
+}
+
+struct BenchConfig
+{
+    std::string weight;
+    std::string jsonPath;
+    float noiseSuppressionLevel;
+    double seconds;       // audio processed per rate and format
+    unsigned nSessions;   // sessions created per rate and format to time the creation
+    unsigned frameDurationMs;
+    // Real-time replay instead of the throughput benchmark
+    unsigned realtimeStreams;
+    bool realtimeSweep;   // search the maximum number of streams without misses
+    bool fifo;
+    uint32_t samplingRate; // of the real-time replay and the scheduled load
+    // Ramp of calls on the work-stealing scheduler, up to this number of calls
+    unsigned scheduledStreams;
+    unsigned nThreads;    // scheduler threads
+    unsigned libraryThreads;
+    ThreadPlacement placement; // of the stream and scheduler threads
+    bool threadReport;
+    // Session counts of the model cache report instead of the benchmark
+    std::vector<unsigned> cacheSessionCounts;
+    bool useModelCache;     // off with -nmc
+    ModelCache *modelCache; // shared by the sessions of every mode
+};
+
+struct BenchResult
+{
+    uint32_t samplingRate;
+    std::string format;
+    uint64_t nFrames;
+    LatencyHistogram create;
+    uint64_t firstFrameNs;
+    LatencyHistogram process; // every frame but the first one
+    double processSeconds;
+    double audioSeconds;
+};
+
+struct ResamplerResult
+{
+    uint32_t inRate;
+    uint32_t outRate;
+    std::string kernel;
+    double samplesPerSecond; // input samples
+    double processSeconds;
+    double audioSeconds;
+    double delaySeconds;
+};
+
+static const std::pair<uint32_t, SamplingRate> kBenchRates[] = {
+    {8000, SamplingRate::Sr8000Hz},
+    {16000, SamplingRate::Sr16000Hz},
+    {32000, SamplingRate::Sr32000Hz},
+    {44100, SamplingRate::Sr44100Hz},
+    {48000, SamplingRate::Sr48000Hz},
+};
+
+// Unsupported rates to the nearest supported one and back
+static const std::pair<uint32_t, uint32_t> kResamplerRates[] = {
+    {11025, 8000},
+    {22050, 16000},
+    {24000, 32000},
+    {16000, 22050},
+    {32000, 24000},
+};
+
+static bool parseArguments(BenchConfig &config, int argc, char **argv)
+{
+    ArgumentParser p(argc, argv);
+    p.addArgument("--model_path", "-m", IMPORTANT);
+    p.addArgument("--suppress_level", "-sl");
+    p.addArgument("--duration", "-d");
+    p.addArgument("--sessions", "-c");
+    p.addArgument("--json", "-js");
+    p.addArgument("--realtime", "-rt");
+    p.addArgument("--realtime_sweep", "-rts", OPTIONAL);
+    p.addArgument("--fifo", "-ff", OPTIONAL);
+    p.addArgument("--rate", "-r");
+    p.addArgument("--frame_duration", "-fd");
+    p.addArgument("--scheduled", "-ws");
+    p.addArgument("--threads", "-t");
+    p.addArgument("--lib_threads", "-lt");
+    p.addArgument("--cpus", "-cpu");
+    p.addArgument("--numa_local", "-nl", OPTIONAL);
+    p.addArgument("--thread_report", "-tr", OPTIONAL);
+    p.addArgument("--model_cache_report", "-mc");
+    p.addArgument("--no_model_cache", "-nmc", OPTIONAL);
+    if (p.parse())
+    {
+        config.weight = p.getArgument("-m");
+        config.jsonPath = p.getArgument("-js");
+        config.noiseSuppressionLevel = std::stof(p.tryGetArgument("-sl", "100.0"));
+        config.seconds = std::stod(p.tryGetArgument("-d", "10"));
+        config.nSessions = static_cast<unsigned>(std::stoul(p.tryGetArgument("-c", "5")));
+        config.realtimeStreams = static_cast<unsigned>(std::stoul(p.tryGetArgument("-rt", "0")));
+        config.realtimeSweep = p.getOptionalArgument("-rts");
+        config.fifo = p.getOptionalArgument("-ff");
+        config.samplingRate = static_cast<uint32_t>(std::stoul(p.tryGetArgument("-r", "16000")));
+        config.scheduledStreams = static_cast<unsigned>(std::stoul(p.tryGetArgument("-ws", "0")));
+        config.nThreads = static_cast<unsigned>(std::stoul(
+            p.tryGetArgument("-t", std::to_string(std::max(1u, std::thread::hardware_concurrency())))));
+        if (!parseFrameDuration(p.tryGetArgument("-fd", "10"), config.frameDurationMs))
+        {
+            std::cerr << "argument -fd should be one of " << getFrameDurationNames() << "!";
+            return false;
+        }
+        // The multi-session modes get one library thread per session unless
+        // told otherwise, the single-session benchmark keeps the library defaults
+        const bool parallel = config.realtimeStreams != 0 || config.realtimeSweep || config.scheduledStreams != 0;
+        config.libraryThreads = static_cast<unsigned>(std::stoul(p.tryGetArgument("-lt", parallel ? "1" : "0")));
+        const std::string cpus = p.getArgument("-cpu");
+        if (!cpus.empty() && !config.placement.setCpus(cpus))
+        {
+            std::cerr << config.placement.getErrorMsg() << "!";
+            return false;
+        }
+        config.placement.setNumaLocal(p.getOptionalArgument("-nl"));
+        config.threadReport = p.getOptionalArgument("-tr");
+        config.useModelCache = !p.getOptionalArgument("-nmc");
+        config.modelCache = nullptr;
+        std::stringstream counts(p.getArgument("-mc"));
+        std::string count;
+        while (std::getline(counts, count, ','))
+        {
+            config.cacheSessionCounts.push_back(static_cast<unsigned>(std::stoul(count)));
+        }
+    }
+    else
+    {
+        std::cerr << p.getError();
+        return false;
+    }
+    if (config.seconds <= 0 || config.nSessions == 0)
+    {
+        std::cerr << "The duration and the number of sessions must be positive!";
+        return false;
+    }
+    if (std::find(config.cacheSessionCounts.begin(), config.cacheSessionCounts.end(), 0u) != config.cacheSessionCounts.end())
+    {
+        std::cerr << "The session counts of -mc must be positive!";
+        return false;
+    }
+    return true;
+}
+
+static uint64_t elapsedNs(Clock::time_point start, Clock::time_point end)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// Deterministic test signal: a few harmonics with a slow amplitude
+// modulation over pseudo random noise
+static std::vector<float> makeSignal(uint32_t samplingRate, size_t nSamples)
+{
+    const double pi = std::acos(-1.0);
+    std::vector<float> signal(nSamples);
+    uint32_t lcg = 12345;
+    for (size_t n = 0; n < nSamples; ++n)
+    {
+        double t = static_cast<double>(n) / samplingRate;
+        double envelope = 0.5 + 0.5 * std::sin(2 * pi * 2.0 * t);
+        double voice = 0.2 * std::sin(2 * pi * 220.0 * t) + 0.1 * std::sin(2 * pi * 440.0 * t) +
+                       0.05 * std::sin(2 * pi * 880.0 * t);
+        lcg = lcg * 1664525u + 1013904223u;
+        double noise = (static_cast<double>(lcg >> 8) / static_cast<double>(1u << 24) - 0.5) * 0.1;
+        signal[n] = static_cast<float>(envelope * voice + noise);
+    }
+    return signal;
+}
+
+static void convertSignal(const std::vector<float> &in, std::vector<float> &out)
+{
+    out = in;
+}
+
+static void convertSignal(const std::vector<float> &in, std::vector<int16_t> &out)
+{
+    out.resize(in.size());
+    std::transform(in.begin(), in.end(), out.begin(),
+                   [](float v) { return static_cast<int16_t>(std::lrint(v * 32767.0f)); });
+}
+
+template <typename SamplingFormat>
+static BenchResult benchNc(const BenchConfig &config, uint32_t samplingRate,
+                           SamplingRate krispRate, const std::vector<float> &signal,
+                           const char *format)
+{
+    const FrameDuration frameDurationMillis = static_cast<FrameDuration>(config.frameDurationMs);
+    size_t frameSize = (samplingRate * static_cast<size_t>(frameDurationMillis)) / 1000;
+
+    BenchResult result{};
+    result.samplingRate = samplingRate;
+    result.format = format;
+
+    ModelInfo ncModelInfo = getModelInfo(config.modelCache, config.weight);
+
+    NcSessionConfig ncCfg =
+        {
+            krispRate,
+            frameDurationMillis,
+            krispRate,
+            &ncModelInfo,
+            false,
+            nullptr
+        };
+
+    std::shared_ptr<Nc<SamplingFormat>> ncSession;
+    for (unsigned s = 0; s < config.nSessions; ++s)
+    {
+        ncSession.reset();
+        auto start = Clock::now();
+        ncSession = Nc<SamplingFormat>::create(ncCfg);
+        result.create.record(elapsedNs(start, Clock::now()));
+    }
+
+    std::vector<SamplingFormat> wavDataIn;
+    convertSignal(signal, wavDataIn);
+    std::vector<SamplingFormat> frameOut(frameSize);
+
+    result.nFrames = wavDataIn.size() / frameSize;
+    uint64_t totalNs = 0;
+    for (size_t i = 0; i < result.nFrames; ++i)
+    {
+        auto start = Clock::now();
+        ncSession->process(&wavDataIn[i * frameSize], frameSize, frameOut.data(), frameSize,
+                           config.noiseSuppressionLevel, nullptr);
+        uint64_t ns = elapsedNs(start, Clock::now());
+        totalNs += ns;
+        if (i == 0)
+        {
+            result.firstFrameNs = ns;
+        }
+        else
+        {
+            result.process.record(ns);
+        }
+    }
+    result.processSeconds = static_cast<double>(totalNs) / 1e9;
+    result.audioSeconds = static_cast<double>(result.nFrames * frameSize) / samplingRate;
+    return result;
+}
+
+// Streams the signal through the resampler in 10 ms chunks
+static ResamplerResult benchResampler(uint32_t inRate, uint32_t outRate, const std::string &kernel,
+                                      const std::vector<float> &signal)
+{
+    ResamplerResult result{};
+    result.inRate = inRate;
+    result.outRate = outRate;
+    result.kernel = kernel;
+
+    Resampler::selectKernel(kernel);
+    Resampler resampler;
+    resampler.init(inRate, outRate);
+    size_t chunkSize = inRate / 100;
+    std::vector<float> out(resampler.getMaxOutput(std::max<size_t>(chunkSize, Resampler::kTaps)));
+
+    auto start = Clock::now();
+    for (size_t i = 0; i + chunkSize <= signal.size(); i += chunkSize)
+    {
+        resampler.process(&signal[i], chunkSize, out.data());
+    }
+    result.processSeconds = static_cast<double>(elapsedNs(start, Clock::now())) / 1e9;
+    result.audioSeconds = static_cast<double>(signal.size() / chunkSize * chunkSize) / inRate;
+    result.samplesPerSecond = result.processSeconds > 0
+                                  ? result.audioSeconds * inRate / result.processSeconds
+                                  : 0.0;
+    result.delaySeconds = resampler.getDelaySeconds();
+    return result;
+}
+
+static double toUs(uint64_t ns)
+{
+    return static_cast<double>(ns) / 1000.0;
+}
+
+static double realTimeFactor(const BenchResult &r)
+{
+    return r.audioSeconds > 0 ? r.processSeconds / r.audioSeconds : 0.0;
+}
+
+static void printResult(const BenchResult &r)
+{
+    const LatencyHistogram &h = r.process;
+    std::cout << "#--- " << r.samplingRate << " Hz " << r.format << " ---" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "# - Session create : mean " << toUs(static_cast<uint64_t>(r.create.getMeanNs()))
+              << " us, max " << toUs(r.create.getMaxNs()) << " us" << std::endl;
+    std::cout << "# - First frame    : " << toUs(r.firstFrameNs) << " us" << std::endl;
+    std::cout << "# - Frame latency  : p50 " << toUs(h.getPercentileNs(50))
+              << " us, p90 " << toUs(h.getPercentileNs(90))
+              << " us, p99 " << toUs(h.getPercentileNs(99))
+              << " us, p99.9 " << toUs(h.getPercentileNs(99.9))
+              << " us, max " << toUs(h.getMaxNs()) << " us" << std::endl;
+    std::cout << std::setprecision(4);
+    std::cout << "# - Real-time factor: " << realTimeFactor(r) << std::endl;
+    std::cout << std::setprecision(2);
+    for (const auto &range : h.getOctaves())
+    {
+        size_t bar = static_cast<size_t>(std::ceil(50.0 * static_cast<double>(range.count) /
+                                                   static_cast<double>(h.getCount())));
+        std::cout << "#   [" << std::setw(10) << toUs(range.lowNs) << ", " << std::setw(10) << toUs(range.highNs)
+                  << ") us " << std::setw(8) << range.count << " " << std::string(bar, '#') << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
+
+static void printResult(const ResamplerResult &r)
+{
+    std::cout << "#--- Resampler " << r.inRate << " Hz -> " << r.outRate << " Hz " << r.kernel << " ---" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "# - Throughput    : " << r.samplesPerSecond / 1e6 << " Msamples/s" << std::endl;
+    std::cout << std::setprecision(6);
+    std::cout << "# - Real-time factor: " << (r.audioSeconds > 0 ? r.processSeconds / r.audioSeconds : 0.0) << std::endl;
+    std::cout << std::setprecision(3);
+    std::cout << "# - Added latency : " << r.delaySeconds * 1000.0 << " ms" << std::endl;
+    std::cout << std::defaultfloat;
+}
+
+static void printRealtime(const RealtimeResult &r)
+{
+    std::cout << "#--- Real-time replay, " << r.nStreams << " streams ---" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "# - Missed deadlines: " << r.nMissed << " of " << r.nFrames << " frames ("
+              << (r.nFrames ? 100.0 * static_cast<double>(r.nMissed) / static_cast<double>(r.nFrames) : 0.0)
+              << " %)" << std::endl;
+    std::cout << std::setprecision(2);
+    std::cout << "# - Wake-up jitter  : p50 " << toUs(r.wakeup.getPercentileNs(50))
+              << " us, p99 " << toUs(r.wakeup.getPercentileNs(99))
+              << " us, max " << toUs(r.wakeup.getMaxNs()) << " us" << std::endl;
+    std::cout << "# - Completion      : p50 " << toUs(r.response.getPercentileNs(50))
+              << " us, p99 " << toUs(r.response.getPercentileNs(99))
+              << " us, p99.9 " << toUs(r.response.getPercentileNs(99.9))
+              << " us, max " << toUs(r.response.getMaxNs()) << " us after the arrival" << std::endl;
+    if (r.nMissed != 0)
+    {
+        std::cout << "# - Lateness of the missed frames:" << std::endl;
+        for (const auto &range : r.lateness.getOctaves())
+        {
+            size_t bar = static_cast<size_t>(std::ceil(50.0 * static_cast<double>(range.count) /
+                                                       static_cast<double>(r.lateness.getCount())));
+            std::cout << "#   [" << std::setw(10) << toUs(range.lowNs) << ", " << std::setw(10) << toUs(range.highNs)
+                      << ") us " << std::setw(8) << range.count << " " << std::string(bar, '#') << std::endl;
+        }
+    }
+    if (!r.fifoError.empty())
+    {
+        std::cout << "# - " << r.fifoError << ", the streams ran with the default policy" << std::endl;
+    }
+    if (!r.placementApplied)
+    {
+        std::cout << "# - The CPU placement failed on some streams" << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
+
+static void writeHistogramJson(std::ostream &out, const LatencyHistogram &h)
+{
+    out << "{\"count\": " << h.getCount()
+        << ", \"mean_us\": " << h.getMeanNs() / 1000.0
+        << ", \"p50_us\": " << toUs(h.getPercentileNs(50))
+        << ", \"p90_us\": " << toUs(h.getPercentileNs(90))
+        << ", \"p99_us\": " << toUs(h.getPercentileNs(99))
+        << ", \"p999_us\": " << toUs(h.getPercentileNs(99.9))
+        << ", \"max_us\": " << toUs(h.getMaxNs())
+        << ", \"octaves\": [";
+    bool first = true;
+    for (const auto &range : h.getOctaves())
+    {
+        out << (first ? "" : ", ") << "{\"low_us\": " << toUs(range.lowNs)
+            << ", \"high_us\": " << toUs(range.highNs) << ", \"count\": " << range.count << "}";
+        first = false;
+    }
+    out << "]}";
+}
+
+static bool writeJson(const std::string &path, const BenchConfig &config,
+                      const std::vector<BenchResult> &results,
+                      const std::vector<ResamplerResult> &resamplerResults)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        return false;
+    }
+    out << std::setprecision(9);
+    out << "{\n  \"frame_duration_ms\": " << config.frameDurationMs
+        << ",\n  \"frame_budget_us\": " << config.frameDurationMs * 1000 << ",\n"
+        << "  \"duration_s\": " << config.seconds << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult &r = results[i];
+        out << "    {\"sampling_rate\": " << r.samplingRate
+            << ", \"format\": \"" << r.format << "\""
+            << ", \"frames\": " << r.nFrames
+            << ", \"real_time_factor\": " << realTimeFactor(r)
+            << ", \"first_frame_us\": " << toUs(r.firstFrameNs)
+            << ",\n     \"session_create\": ";
+        writeHistogramJson(out, r.create);
+        out << ",\n     \"process\": ";
+        writeHistogramJson(out, r.process);
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n  \"resamplers\": [\n";
+    for (size_t i = 0; i < resamplerResults.size(); ++i)
+    {
+        const ResamplerResult &r = resamplerResults[i];
+        out << "    {\"in_rate\": " << r.inRate
+            << ", \"out_rate\": " << r.outRate
+            << ", \"kernel\": \"" << r.kernel << "\""
+            << ", \"samples_per_second\": " << r.samplesPerSecond
+            << ", \"real_time_factor\": " << (r.audioSeconds > 0 ? r.processSeconds / r.audioSeconds : 0.0)
+            << ", \"latency_ms\": " << r.delaySeconds * 1000.0
+            << "}" << (i + 1 < resamplerResults.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+static bool writeRealtimeJson(const std::string &path, const BenchConfig &config,
+                              const std::vector<RealtimeResult> &results, unsigned maxStreams)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        return false;
+    }
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    out << std::setprecision(9);
+    out << "{\n  \"frame_duration_ms\": " << config.frameDurationMs
+        << ",\n  \"frame_budget_us\": " << config.frameDurationMs * 1000 << ",\n"
+        << "  \"sampling_rate\": " << config.samplingRate << ",\n"
+        << "  \"duration_s\": " << config.seconds << ",\n"
+        << "  \"fifo\": " << (config.fifo ? "true" : "false") << ",\n"
+        << "  \"cores\": " << cores << ",\n";
+    if (config.realtimeSweep)
+    {
+        out << "  \"max_streams\": " << maxStreams << ",\n"
+            << "  \"max_streams_per_core\": " << static_cast<double>(maxStreams) / cores << ",\n";
+    }
+    out << "  \"realtime\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const RealtimeResult &r = results[i];
+        out << "    {\"streams\": " << r.nStreams
+            << ", \"frames\": " << r.nFrames
+            << ", \"missed\": " << r.nMissed
+            << ", \"fifo_applied\": " << (r.fifoApplied ? "true" : "false")
+            << ",\n     \"wakeup\": ";
+        writeHistogramJson(out, r.wakeup);
+        out << ",\n     \"completion\": ";
+        writeHistogramJson(out, r.response);
+        out << ",\n     \"lateness\": ";
+        writeHistogramJson(out, r.lateness);
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// Either one replay with the given number of streams, or a search for the
+// largest number of streams without a missed deadline: the count is
+// doubled until the first miss and then bisected
+static int runRealtimeBench(const BenchConfig &config)
+{
+    RealtimeConfig realtimeConfig{};
+    realtimeConfig.weight = config.weight;
+    realtimeConfig.modelCache = config.modelCache;
+    realtimeConfig.noiseSuppressionLevel = config.noiseSuppressionLevel;
+    realtimeConfig.samplingRate = config.samplingRate;
+    realtimeConfig.seconds = config.seconds;
+    realtimeConfig.frameDurationMs = config.frameDurationMs;
+    realtimeConfig.fifo = config.fifo;
+    realtimeConfig.fifoPriority = 50;
+    realtimeConfig.placement = config.placement;
+
+    std::vector<float> signal = makeSignal(config.samplingRate, static_cast<size_t>(config.seconds * config.samplingRate));
+    std::vector<RealtimeResult> results;
+    auto replay = [&](unsigned nStreams) -> bool
+    {
+        realtimeConfig.nStreams = nStreams;
+        results.push_back(runRealtime(realtimeConfig, signal));
+        printRealtime(results.back());
+        return results.back().nMissed == 0;
+    };
+
+    unsigned maxStreams = 0;
+    if (!config.realtimeSweep)
+    {
+        replay(config.realtimeStreams);
+    }
+    else
+    {
+        const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        const unsigned limit = 1024 * cores;
+        unsigned failed = 0;
+        for (unsigned n = std::max(1u, config.realtimeStreams); n <= limit; n *= 2)
+        {
+            if (!replay(n))
+            {
+                failed = n;
+                break;
+            }
+            maxStreams = n;
+        }
+        while (failed != 0 && failed - maxStreams > 1)
+        {
+            unsigned n = maxStreams + (failed - maxStreams) / 2;
+            if (replay(n))
+            {
+                maxStreams = n;
+            }
+            else
+            {
+                failed = n;
+            }
+        }
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "Max real-time streams without a missed deadline: " << maxStreams << " ("
+                  << static_cast<double>(maxStreams) / cores << " per core, " << cores << " cores)" << std::endl;
+        std::cout << std::defaultfloat;
+    }
+    if (!config.jsonPath.empty() && !writeRealtimeJson(config.jsonPath, config, results, maxStreams))
+    {
+        return error("Failed to write the JSON report: " + config.jsonPath);
+    }
+    return 0;
+}
+
+static void printScheduledStep(const ScheduledLoadStep &step, unsigned cores)
+{
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "# " << std::setw(6) << step.nStreams << " calls, " << std::setw(7)
+              << static_cast<double>(step.nStreams) / cores << " per core: missed " << std::setprecision(3)
+              << std::setw(7) << (step.nFrames ? 100.0 * static_cast<double>(step.nMissed) / static_cast<double>(step.nFrames) : 0.0)
+              << " %, completion p50 " << std::setprecision(2) << toUs(step.completion.getPercentileNs(50))
+              << " us, p99 " << toUs(step.completion.getPercentileNs(99))
+              << " us, p99.9 " << toUs(step.completion.getPercentileNs(99.9))
+              << " us, steals " << step.nSteals << std::endl;
+    std::cout << std::defaultfloat;
+}
+
+static bool writeScheduledJson(const std::string &path, const BenchConfig &config,
+                               const std::vector<ScheduledLoadStep> &steps, unsigned sustained)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        return false;
+    }
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    out << std::setprecision(9);
+    out << "{\n  \"frame_duration_ms\": " << config.frameDurationMs
+        << ",\n  \"frame_budget_us\": " << config.frameDurationMs * 1000 << ",\n"
+        << "  \"sampling_rate\": " << config.samplingRate << ",\n"
+        << "  \"duration_s\": " << config.seconds << ",\n"
+        << "  \"threads\": " << config.nThreads << ",\n"
+        << "  \"cores\": " << cores << ",\n"
+        << "  \"sustained_streams\": " << sustained << ",\n"
+        << "  \"sustained_streams_per_core\": " << static_cast<double>(sustained) / cores << ",\n"
+        << "  \"scheduled\": [\n";
+    for (size_t i = 0; i < steps.size(); ++i)
+    {
+        const ScheduledLoadStep &step = steps[i];
+        out << "    {\"streams\": " << step.nStreams
+            << ", \"frames\": " << step.nFrames
+            << ", \"missed\": " << step.nMissed
+            << ", \"steals\": " << step.nSteals
+            << ",\n     \"completion\": ";
+        writeHistogramJson(out, step.completion);
+        out << "}" << (i + 1 < steps.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// Ramps the number of calls on the work-stealing scheduler and reports the
+// largest step that kept its misses under kSustainedMissRate
+static int runScheduledBench(const BenchConfig &config)
+{
+    ScheduledLoadConfig loadConfig{};
+    loadConfig.weight = config.weight;
+    loadConfig.modelCache = config.modelCache;
+    loadConfig.noiseSuppressionLevel = config.noiseSuppressionLevel;
+    loadConfig.samplingRate = config.samplingRate;
+    loadConfig.frameDurationMs = config.frameDurationMs;
+    loadConfig.seconds = config.seconds;
+    loadConfig.nThreads = config.nThreads;
+    loadConfig.startStreams = std::min(16u, config.scheduledStreams);
+    loadConfig.maxStreams = config.scheduledStreams;
+    loadConfig.placement = config.placement;
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    std::cout << "#--- Scheduled load, " << config.nThreads << " threads, " << config.seconds << " s per step ---" << std::endl;
+    std::vector<float> signal = makeSignal(config.samplingRate, static_cast<size_t>(config.seconds * config.samplingRate));
+    auto steps = runScheduledLoad(loadConfig, signal,
+                                  [&](const ScheduledLoadStep &step) { printScheduledStep(step, cores); });
+
+    unsigned sustained = 0;
+    for (const auto &step : steps)
+    {
+        if (static_cast<double>(step.nMissed) <= kSustainedMissRate * static_cast<double>(step.nFrames))
+        {
+            sustained = std::max(sustained, step.nStreams);
+        }
+    }
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Sustained calls: " << sustained << " (" << static_cast<double>(sustained) / cores
+              << " per core, " << cores << " cores, at most " << kSustainedMissRate * 100.0 << " % missed deadlines)" << std::endl;
+    std::cout << std::defaultfloat;
+    if (!config.jsonPath.empty() && !writeScheduledJson(config.jsonPath, config, steps, sustained))
+    {
+        return error("Failed to write the JSON report: " + config.jsonPath);
+    }
+    return 0;
+}
+
+static void printModelCacheCase(const ModelCacheBenchCase &c)
+{
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "# - " << std::setw(4) << c.nSessions << " sessions, " << (c.cached ? "cached" : "path  ")
+              << " : create mean " << c.create.getMeanNs() / 1000.0 << " us, p99 "
+              << toUs(c.create.getPercentileNs(99)) << " us, max " << toUs(c.create.getMaxNs()) << " us, RSS ";
+    if (c.rssBytes >= 0)
+    {
+        std::cout << "+" << static_cast<double>(c.rssBytes) / 1024.0 << " KiB ("
+                  << static_cast<double>(c.rssBytes) / 1024.0 / c.nSessions << " KiB per session)";
+    }
+    else
+    {
+        std::cout << "n/a";
+    }
+    if (c.cached)
+    {
+        std::cout << ", " << c.hits << " hits, " << c.misses << " misses";
+    }
+    std::cout << std::endl;
+    std::cout << std::defaultfloat;
+}
+
+static bool writeModelCacheJson(const std::string &path, const BenchConfig &config,
+                                const std::vector<ModelCacheBenchCase> &cases)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        return false;
+    }
+    out << std::setprecision(9);
+    out << "{\n  \"frame_duration_ms\": " << config.frameDurationMs << ",\n"
+        << "  \"sampling_rate\": " << config.samplingRate << ",\n"
+        << "  \"model_cache\": [\n";
+    for (size_t i = 0; i < cases.size(); ++i)
+    {
+        const ModelCacheBenchCase &c = cases[i];
+        out << "    {\"sessions\": " << c.nSessions
+            << ", \"cached\": " << (c.cached ? "true" : "false")
+            << ", \"rss_bytes\": " << c.rssBytes
+            << ", \"hits\": " << c.hits
+            << ", \"misses\": " << c.misses
+            << ",\n     \"create\": ";
+        writeHistogramJson(out, c.create);
+        out << "}" << (i + 1 < cases.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// Session creation with the model loaded by every session and with the
+// model cache, for every session count of -mc
+static int runModelCacheReport(const BenchConfig &config)
+{
+    ModelCacheBenchConfig cacheConfig{};
+    cacheConfig.weight = config.weight;
+    cacheConfig.samplingRate = config.samplingRate;
+    cacheConfig.frameDurationMs = config.frameDurationMs;
+    cacheConfig.sessionCounts = config.cacheSessionCounts;
+
+    std::cout << "#--- Model cache, " << config.samplingRate << " Hz PCM16 sessions ---" << std::endl;
+    auto cases = runModelCacheBench(cacheConfig, printModelCacheCase);
+    if (!config.jsonPath.empty() && !writeModelCacheJson(config.jsonPath, config, cases))
+    {
+        return error("Failed to write the JSON report: " + config.jsonPath);
+    }
+    return 0;
+}
+
+static void printThreadReport(const ThreadMonitor &monitor)
+{
+    std::cout << "#--- Threads ---" << std::endl;
+    std::cout << "# - Created              : " << monitor.getSeen() << ", at most " << monitor.getMaxAlive() << " at once" << std::endl;
+    for (const auto &group : monitor.getGroups())
+    {
+        std::cout << "# - " << std::left << std::setw(20) << group.first << std::right << " : "
+                  << group.second.nSeen << ", at most " << group.second.maxAlive << " at once" << std::endl;
+    }
+    std::cout << "#---------------" << std::endl;
+}
+
+static int runBench(const BenchConfig &config)
+{
+    std::vector<BenchResult> results;
+    for (const auto &rate : kBenchRates)
+    {
+        size_t nSamples = static_cast<size_t>(config.seconds * rate.first);
+        std::vector<float> signal = makeSignal(rate.first, nSamples);
+        results.push_back(benchNc<int16_t>(config, rate.first, rate.second, signal, "int16"));
+        printResult(results.back());
+        results.push_back(benchNc<float>(config, rate.first, rate.second, signal, "float"));
+        printResult(results.back());
+    }
+    std::vector<ResamplerResult> resamplerResults;
+    const std::string fastestKernel = Resampler::getKernelName();
+    for (const auto &rates : kResamplerRates)
+    {
+        size_t nSamples = static_cast<size_t>(config.seconds * rates.first);
+        std::vector<float> signal = makeSignal(rates.first, nSamples);
+        for (const auto &kernel : Resampler::getKernelNames())
+        {
+            resamplerResults.push_back(benchResampler(rates.first, rates.second, kernel, signal));
+            printResult(resamplerResults.back());
+        }
+    }
+    Resampler::selectKernel(fastestKernel);
+    if (!config.jsonPath.empty() && !writeJson(config.jsonPath, config, results, resamplerResults))
+    {
+        return error("Failed to write the JSON report: " + config.jsonPath);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    BenchConfig config;
+    if (!parseArguments(config, argc, argv))
+    {
+        std::cerr << "\nUsage:\n\t" << argv[0]
+                  << " -m model_path [-fd ms] [-d seconds] [-c sessions] [-sl suppress_level] [-js report.json] [-tr]"
+                  << "\n\t" << argv[0]
+                  << " -m model_path -rt streams|-rts [-fd ms] [-r rate] [-ff] [-d seconds] [-js report.json] [-lt n] [-cpu list] [-nl] [-tr]"
+                  << "\n\t" << argv[0]
+                  << " -m model_path -ws max_streams [-t threads] [-fd ms] [-r rate] [-d seconds] [-js report.json] [-lt n] [-cpu list] [-nl] [-tr]"
+                  << "\n\t" << argv[0]
+                  << " -m model_path -mc sessions[,sessions...] [-fd ms] [-r rate] [-js report.json]"
+                  << "\nThe sessions share one mapping of the model unless -nmc is given."
+                  << std::endl;
+        return argc == 1 ? 0 : 1;
+    }
+    int result = 1;
+    ThreadMonitor monitor;
+    if (config.threadReport)
+    {
+        monitor.start();
+    }
+    // Declared first, the sessions use its mappings until they are released
+    ModelCache modelCache;
+    if (config.useModelCache)
+    {
+        config.modelCache = &modelCache;
+    }
+    try
+    {
+        // The library pools are sized when the SDK creates them
+        limitLibraryThreads(config.libraryThreads);
+        globalInit(L"");
+        if (!config.cacheSessionCounts.empty())
+        {
+            result = runModelCacheReport(config);
+        }
+        else if (config.scheduledStreams != 0)
+        {
+            result = runScheduledBench(config);
+        }
+        else
+        {
+            result = config.realtimeStreams != 0 || config.realtimeSweep ? runRealtimeBench(config) : runBench(config);
+        }
+        globalDestroy();
+    }
+    catch (const std::exception &ex)
+    {
+        std::cout << "std::exception: " << ex.what() << std::endl;
+    }
+    catch (...)
+    {
+        std::cout << "Unknown exception thrown..." << std::endl;
+    }
+    if (config.threadReport)
+    {
+        monitor.stop();
+        printThreadReport(monitor);
+    }
+    return result;
+}
@@ -0,0 +1,98 @@
+#include "model_cache_bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include <krisp-audio-sdk.hpp>
+#include <krisp-audio-sdk-nc.hpp>
+
+#include "model_cache.hpp"
+#include "sampling_rate.hpp"
+
+using namespace Krisp::AudioSdk;
+
+using Clock = std::chrono::steady_clock;
+
+static uint64_t toNs(Clock::duration d)
+{
+    return static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+}
+
+// The current resident set, not the peak, -1 where it is not available
+static int64_t getResidentBytes()
+{
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    int64_t size = 0, resident = 0;
+    if (statm >> size >> resident)
+    {
+        return resident * static_cast<int64_t>(sysconf(_SC_PAGESIZE));
+    }
+#endif
+    return -1;
+}
+
+static ModelCacheBenchCase runCase(const ModelCacheBenchConfig &config, SamplingRate rate,
+                                   unsigned nSessions, bool cached)
+{
+    ModelCacheBenchCase result{};
+    result.nSessions = nSessions;
+    result.cached = cached;
+    // A new cache per case, the first session maps the model. The sessions
+    // declared after it are released first.
+    ModelCache cache;
+    std::vector<std::shared_ptr<Nc<int16_t>>> sessions;
+    sessions.reserve(nSessions);
+    const int64_t rssBefore = getResidentBytes();
+    for (unsigned s = 0; s < nSessions; ++s)
+    {
+        auto start = Clock::now();
+        // The model info is part of the creation, as it is for a new call
+        ModelInfo ncModelInfo = getModelInfo(cached ? &cache : nullptr, config.weight);
+        NcSessionConfig ncCfg =
+            {
+                rate,
+                static_cast<FrameDuration>(config.frameDurationMs),
+                rate,
+                &ncModelInfo,
+                false,
+                nullptr
+            };
+        sessions.push_back(Nc<int16_t>::create(ncCfg));
+        result.create.record(toNs(Clock::now() - start));
+    }
+    const int64_t rssAfter = getResidentBytes();
+    result.rssBytes = rssBefore >= 0 && rssAfter >= 0 ? rssAfter - rssBefore : -1;
+    const ModelCache::Stats stats = cache.getStats();
+    result.hits = stats.hits;
+    result.misses = stats.misses;
+    return result;
+}
+
+std::vector<ModelCacheBenchCase> runModelCacheBench(
+    const ModelCacheBenchConfig &config,
+    const std::function<void(const ModelCacheBenchCase &)> &onCase)
+{
+    auto samplingRateResult = getKrispSamplingRate(config.samplingRate);
+    if (!samplingRateResult.second)
+    {
+        throw std::invalid_argument("Unsupported sampling rate for the model cache benchmark");
+    }
+    std::vector<ModelCacheBenchCase> results;
+    for (unsigned nSessions : config.sessionCounts)
+    {
+        for (bool cached : {false, true})
+        {
+            results.push_back(runCase(config, samplingRateResult.first, nSessions, cached));
+            onCase(results.back());
+        }
+    }
+    return results;
+}
@@ -0,0 +1,38 @@
+#ifndef MODEL_CACHE_BENCH_HPP
+#define MODEL_CACHE_BENCH_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "latency_histogram.hpp"
+
+struct ModelCacheBenchConfig
+{
+    std::string weight;
+    uint32_t samplingRate;
+    unsigned frameDurationMs;
+    std::vector<unsigned> sessionCounts; // sessions alive at once per case
+};
+
+struct ModelCacheBenchCase
+{
+    unsigned nSessions;
+    bool cached;
+    LatencyHistogram create;
+    int64_t rssBytes; // growth of the resident set with the sessions alive, -1 if unknown
+    uint64_t hits;
+    uint64_t misses;
+};
+
+// For every session count, creates that many PCM16 sessions and keeps them
+// alive, first with the model loaded from the path by every session, then
+// with the sessions sharing the mapping of a new ModelCache. Times every
+// create() call and measures the resident set before and after. onCase is
+// called after every case.
+std::vector<ModelCacheBenchCase> runModelCacheBench(
+    const ModelCacheBenchConfig &config,
+    const std::function<void(const ModelCacheBenchCase &)> &onCase);
+
+#endif
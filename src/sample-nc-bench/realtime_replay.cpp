@@ -0,0 +1,210 @@
+#include "realtime_replay.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <krisp-audio-sdk.hpp>
+#include <krisp-audio-sdk-nc.hpp>
+
+#include "sampling_rate.hpp"
+
+using namespace Krisp::AudioSdk;
+
+using Clock = std::chrono::steady_clock;
+
+// Delay before the first arrival, leaves time to wake up every thread
+constexpr auto kStartDelay = std::chrono::milliseconds(100);
+
+static uint64_t toNs(Clock::duration d)
+{
+    return static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+}
+
+// Returns an empty string on success
+static std::string setFifoScheduling(int priority)
+{
+#ifndef _WIN32
+    sched_param param{};
+    param.sched_priority = priority;
+    int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    return rc == 0 ? std::string() : std::string("SCHED_FIFO is not available: ") + std::strerror(rc);
+#else
+    (void)priority;
+    return "SCHED_FIFO is not supported on this platform";
+#endif
+}
+
+struct RealtimeStream
+{
+    std::shared_ptr<Nc<int16_t>> session;
+    Clock::duration offset; // arrival offset within the frame period
+    uint64_t nMissed;
+    LatencyHistogram response;
+    LatencyHistogram wakeup;
+    LatencyHistogram lateness;
+};
+
+RealtimeResult runRealtime(const RealtimeConfig &config, const std::vector<float> &signal)
+{
+    auto samplingRateResult = getKrispSamplingRate(config.samplingRate);
+    if (!samplingRateResult.second)
+    {
+        throw std::invalid_argument("Unsupported sampling rate for the real-time replay");
+    }
+    const FrameDuration frameDurationMillis = static_cast<FrameDuration>(config.frameDurationMs);
+    const size_t frameSize = (config.samplingRate * static_cast<size_t>(frameDurationMillis)) / 1000;
+    const Clock::duration framePeriod = std::chrono::milliseconds(static_cast<int>(frameDurationMillis));
+    const size_t nFrames = std::min(signal.size() / frameSize,
+                                    static_cast<size_t>(config.seconds * 1000.0) / static_cast<size_t>(frameDurationMillis));
+
+    // Calls are usually PCM16
+    std::vector<int16_t> wavDataIn(signal.size());
+    std::transform(signal.begin(), signal.end(), wavDataIn.begin(),
+                   [](float v) { return static_cast<int16_t>(std::lrint(v * 32767.0f)); });
+
+    ModelInfo ncModelInfo = getModelInfo(config.modelCache, config.weight);
+
+    NcSessionConfig ncCfg =
+        {
+            samplingRateResult.first,
+            frameDurationMillis,
+            samplingRateResult.first,
+            &ncModelInfo,
+            false,
+            nullptr
+        };
+
+    std::vector<RealtimeStream> streams(config.nStreams);
+    for (unsigned s = 0; s < config.nStreams; ++s)
+    {
+        streams[s].offset = framePeriod * s / config.nStreams;
+        streams[s].nMissed = 0;
+    }
+
+    RealtimeResult result{};
+    result.nStreams = config.nStreams;
+    result.fifoApplied = config.fifo;
+    result.placementApplied = true;
+    std::mutex resultMutex;
+    std::exception_ptr streamError;
+
+    // The sessions are created before the start, the creation is not part of
+    // the real-time schedule
+    std::condition_variable readyCv;
+    unsigned nReady = 0;
+    bool started = false;
+    Clock::time_point start;
+    auto createSession = [&](RealtimeStream &stream, unsigned index)
+    {
+        try
+        {
+            if (!config.placement.apply(index, "nc-stream"))
+            {
+                std::lock_guard<std::mutex> lock(resultMutex);
+                result.placementApplied = false;
+            }
+            // On the stream thread, so the session memory is local to its CPU
+            stream.session = Nc<int16_t>::create(ncCfg);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            streamError = std::current_exception();
+        }
+        std::unique_lock<std::mutex> lock(resultMutex);
+        ++nReady;
+        readyCv.notify_all();
+        readyCv.wait(lock, [&]() { return started; });
+    };
+
+    auto runStream = [&](RealtimeStream &stream, unsigned index)
+    {
+        createSession(stream, index);
+        if (!stream.session)
+        {
+            return;
+        }
+        try
+        {
+            if (config.fifo)
+            {
+                std::string fifoError = setFifoScheduling(config.fifoPriority);
+                if (!fifoError.empty())
+                {
+                    std::lock_guard<std::mutex> lock(resultMutex);
+                    result.fifoApplied = false;
+                    result.fifoError = fifoError;
+                }
+            }
+            std::vector<int16_t> frameOut(frameSize);
+            for (size_t k = 0; k < nFrames; ++k)
+            {
+                const Clock::time_point arrival = start + stream.offset + framePeriod * static_cast<int64_t>(k);
+                const Clock::time_point deadline = arrival + framePeriod;
+                // A stream running behind does not sleep, the frame is already waiting
+                std::this_thread::sleep_until(arrival);
+                const Clock::time_point begin = Clock::now();
+                stream.session->process(&wavDataIn[k * frameSize], frameSize, frameOut.data(), frameSize,
+                                        config.noiseSuppressionLevel, nullptr);
+                const Clock::time_point end = Clock::now();
+                stream.wakeup.record(toNs(begin - arrival));
+                stream.response.record(toNs(end - arrival));
+                if (end > deadline)
+                {
+                    ++stream.nMissed;
+                    stream.lateness.record(toNs(end - deadline));
+                }
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(resultMutex);
+            streamError = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(config.nStreams);
+    for (unsigned s = 0; s < config.nStreams; ++s)
+    {
+        threads.emplace_back(runStream, std::ref(streams[s]), s);
+    }
+    {
+        std::unique_lock<std::mutex> lock(resultMutex);
+        readyCv.wait(lock, [&]() { return nReady == config.nStreams; });
+        start = Clock::now() + kStartDelay;
+        started = true;
+    }
+    readyCv.notify_all();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    if (streamError)
+    {
+        std::rethrow_exception(streamError);
+    }
+
+    for (const auto &stream : streams)
+    {
+        result.nFrames += nFrames;
+        result.nMissed += stream.nMissed;
+        result.response.merge(stream.response);
+        result.wakeup.merge(stream.wakeup);
+        result.lateness.merge(stream.lateness);
+    }
+    return result;
+}
@@ -0,0 +1,48 @@
+#ifndef REALTIME_REPLAY_HPP
+#define REALTIME_REPLAY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "latency_histogram.hpp"
+#include "model_cache.hpp"
+#include "thread_control.hpp"
+
+struct RealtimeConfig
+{
+    std::string weight;
+    ModelCache *modelCache; // null to load the model for every session
+    float noiseSuppressionLevel;
+    uint32_t samplingRate;
+    unsigned frameDurationMs;
+    double seconds;     // audio replayed by every stream
+    unsigned nStreams;  // concurrent calls, one session and thread each
+    bool fifo;          // run the stream threads under SCHED_FIFO
+    int fifoPriority;
+    ThreadPlacement placement; // of the stream threads
+};
+
+struct RealtimeResult
+{
+    unsigned nStreams;
+    uint64_t nFrames;           // frames of all streams
+    uint64_t nMissed;           // frames completed after their deadline
+    LatencyHistogram response;  // completion time minus arrival time
+    LatencyHistogram wakeup;    // start of the processing minus arrival time
+    LatencyHistogram lateness;  // completion time minus deadline, missed frames only
+    bool fifoApplied;           // every stream thread got SCHED_FIFO
+    std::string fifoError;
+    bool placementApplied;      // every stream thread got its CPU placement
+};
+
+// Replays the signal as nStreams live calls. Frame k of a stream arrives at
+// start + k * frame duration, the arrivals of the streams are spread evenly
+// over the frame period, and its deadline is the arrival of frame k + 1.
+// A stream that falls behind processes the late frames back to back, as a
+// real call would, so the misses add up. The calling thread waits for the
+// streams. Every stream thread is placed first and then creates its session,
+// the replay starts once all of them are ready.
+RealtimeResult runRealtime(const RealtimeConfig &config, const std::vector<float> &signal);
+
+#endif
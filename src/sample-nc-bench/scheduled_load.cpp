@@ -0,0 +1,172 @@
+#include "scheduled_load.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include <krisp-audio-sdk.hpp>
+#include <krisp-audio-sdk-nc.hpp>
+
+#include "sampling_rate.hpp"
+#include "session_scheduler.hpp"
+
+using namespace Krisp::AudioSdk;
+
+using Clock = std::chrono::steady_clock;
+
+// Delay before the first arrival of a step
+constexpr auto kStartDelay = std::chrono::milliseconds(50);
+
+static uint64_t toNs(Clock::duration d)
+{
+    return static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+}
+
+struct ScheduledStream
+{
+    std::shared_ptr<Nc<int16_t>> session;
+    Clock::duration offset; // arrival offset within the frame period
+    uint64_t nextFrame;     // the frame the scheduler runs next
+    std::vector<int16_t> frameOut;
+};
+
+// Counters of one scheduler thread, merged after every step
+struct ScheduledWorker
+{
+    uint64_t nMissed;
+    LatencyHistogram completion;
+};
+
+std::vector<ScheduledLoadStep> runScheduledLoad(
+    const ScheduledLoadConfig &config,
+    const std::vector<float> &signal,
+    const std::function<void(const ScheduledLoadStep &)> &onStep)
+{
+    auto samplingRateResult = getKrispSamplingRate(config.samplingRate);
+    if (!samplingRateResult.second)
+    {
+        throw std::invalid_argument("Unsupported sampling rate for the scheduled load");
+    }
+    const FrameDuration frameDurationMillis = static_cast<FrameDuration>(config.frameDurationMs);
+    const size_t frameSize = (config.samplingRate * static_cast<size_t>(frameDurationMillis)) / 1000;
+    const Clock::duration framePeriod = std::chrono::milliseconds(static_cast<int>(frameDurationMillis));
+    const size_t nSignalFrames = signal.size() / frameSize;
+    const size_t nFrames = static_cast<size_t>(config.seconds * 1000.0) / static_cast<size_t>(frameDurationMillis);
+    if (nSignalFrames == 0)
+    {
+        throw std::invalid_argument("The signal is shorter than a frame");
+    }
+
+    // Calls are usually PCM16
+    std::vector<int16_t> wavDataIn(signal.size());
+    std::transform(signal.begin(), signal.end(), wavDataIn.begin(),
+                   [](float v) { return static_cast<int16_t>(std::lrint(v * 32767.0f)); });
+
+    ModelInfo ncModelInfo = getModelInfo(config.modelCache, config.weight);
+
+    NcSessionConfig ncCfg =
+        {
+            samplingRateResult.first,
+            frameDurationMillis,
+            samplingRateResult.first,
+            &ncModelInfo,
+            false,
+            nullptr
+        };
+
+    std::vector<ScheduledStream> streams(config.maxStreams);
+    std::vector<ScheduledWorker> workers;
+    Clock::time_point start;
+
+    // The frames of a call loop over the signal
+    auto runFrame = [&](unsigned worker, uint32_t s)
+    {
+        ScheduledStream &stream = streams[s];
+        const uint64_t k = stream.nextFrame++;
+        const Clock::time_point arrival = start + stream.offset + framePeriod * static_cast<int64_t>(k);
+        stream.session->process(&wavDataIn[(k % nSignalFrames) * frameSize], frameSize,
+                                stream.frameOut.data(), frameSize, config.noiseSuppressionLevel, nullptr);
+        const Clock::time_point end = Clock::now();
+        workers[worker].completion.record(toNs(end - arrival));
+        if (end > arrival + framePeriod)
+        {
+            ++workers[worker].nMissed;
+        }
+    };
+    // The sessions move between the threads, only the buffers of a thread
+    // stay on its NUMA node
+    auto placeThread = [&](unsigned worker)
+    {
+        config.placement.apply(worker, "nc-sched");
+    };
+    SessionScheduler scheduler(config.nThreads, config.maxStreams, runFrame, placeThread);
+    workers.resize(scheduler.size());
+
+    std::vector<ScheduledLoadStep> steps;
+    unsigned nCreated = 0;
+    unsigned n = std::max(1u, std::min(config.startStreams, config.maxStreams));
+    for (;;)
+    {
+        // The sessions are created before the step, the creation is not
+        // part of the real-time schedule
+        for (; nCreated < n; ++nCreated)
+        {
+            streams[nCreated].session = Nc<int16_t>::create(ncCfg);
+            streams[nCreated].frameOut.resize(frameSize);
+        }
+        for (unsigned s = 0; s < n; ++s)
+        {
+            streams[s].offset = framePeriod * s / n;
+            streams[s].nextFrame = 0;
+        }
+        for (auto &worker : workers)
+        {
+            worker.nMissed = 0;
+            worker.completion.reset();
+        }
+        scheduler.resetStats();
+
+        // The frames are submitted in the order of their arrival. A
+        // submission that falls behind the schedule is not skipped, the
+        // delay shows up in the completion time.
+        start = Clock::now() + kStartDelay;
+        for (size_t k = 0; k < nFrames; ++k)
+        {
+            for (unsigned s = 0; s < n; ++s)
+            {
+                const Clock::time_point arrival = start + streams[s].offset + framePeriod * static_cast<int64_t>(k);
+                if (arrival > Clock::now())
+                {
+                    std::this_thread::sleep_until(arrival);
+                }
+                scheduler.submit(s);
+            }
+        }
+        scheduler.wait();
+
+        ScheduledLoadStep step{};
+        step.nStreams = n;
+        step.nFrames = static_cast<uint64_t>(nFrames) * n;
+        for (const auto &worker : workers)
+        {
+            step.nMissed += worker.nMissed;
+            step.completion.merge(worker.completion);
+        }
+        for (const auto &workerStats : scheduler.getStats())
+        {
+            step.nSteals += workerStats.nSteals;
+        }
+        steps.push_back(step);
+        onStep(step);
+        if (n == config.maxStreams ||
+            static_cast<double>(step.nMissed) > kOverloadMissRate * static_cast<double>(step.nFrames))
+        {
+            break;
+        }
+        n = std::min(n * 2, config.maxStreams);
+    }
+    return steps;
+}
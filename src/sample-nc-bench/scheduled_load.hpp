@@ -0,0 +1,51 @@
+#ifndef SCHEDULED_LOAD_HPP
+#define SCHEDULED_LOAD_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "latency_histogram.hpp"
+#include "model_cache.hpp"
+#include "thread_control.hpp"
+
+struct ScheduledLoadConfig
+{
+    std::string weight;
+    ModelCache *modelCache; // null to load the model for every session
+    float noiseSuppressionLevel;
+    uint32_t samplingRate;
+    unsigned frameDurationMs;
+    double seconds;        // audio replayed by every stream at every step
+    unsigned nThreads;     // scheduler threads
+    unsigned startStreams; // streams of the first step, doubled at every step
+    unsigned maxStreams;
+    ThreadPlacement placement; // of the scheduler threads
+};
+
+struct ScheduledLoadStep
+{
+    unsigned nStreams;
+    uint64_t nFrames;
+    uint64_t nMissed;           // frames completed after the arrival of the next frame
+    uint64_t nSteals;           // sessions run by another thread than the one they were queued on
+    LatencyHistogram completion; // completion time minus arrival time
+};
+
+// Replays the signal as live calls through a SessionScheduler, one NC
+// session per call and one task per frame, with the arrivals of the calls
+// spread evenly over the frame period. The number of calls starts at
+// startStreams and doubles at every step up to maxStreams. The ramp stops
+// after the first step that misses more than kOverloadMissRate of its
+// deadlines. onStep is called after every step.
+std::vector<ScheduledLoadStep> runScheduledLoad(
+    const ScheduledLoadConfig &config,
+    const std::vector<float> &signal,
+    const std::function<void(const ScheduledLoadStep &)> &onStep);
+
+// A step is sustained when it misses at most this fraction of its deadlines
+constexpr double kSustainedMissRate = 0.001;
+constexpr double kOverloadMissRate = 0.01;
+
+#endif
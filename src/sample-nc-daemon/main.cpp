@@ -0,0 +1,119 @@
+#include <csignal>
+#include <iostream>
+#include <string>
+
+#include <krisp-audio-sdk.hpp>
+
+#include "argument_parser.hpp"
+#include "nc_daemon.hpp"
+
+using namespace Krisp::AudioSdk;
+
+template <typename T>
+int error(const T &e)
+{
+    std::cerr << e << std::endl;
+    return 1;
+}
+
+static void onStopSignal(int)
+{
+    stopNcDaemon();
+}
+
+static bool parseArguments(NcDaemonConfig &config, int argc, char **argv)
+{
+    ArgumentParser p(argc, argv);
+    p.addArgument("--socket", "-u", IMPORTANT);
+    p.addArgument("--model_path", "-m", IMPORTANT);
+    p.addArgument("--threads", "-t");
+    p.addArgument("--max_streams", "-n");
+    p.addArgument("--no_model_cache", "-nmc", OPTIONAL);
+    if (p.parse())
+    {
+        config.socketPath = p.getArgument("-u");
+        config.weight = p.getArgument("-m");
+        config.nThreads = static_cast<unsigned>(std::stoul(p.tryGetArgument("-t", "0")));
+        config.maxStreams = static_cast<unsigned>(std::stoul(p.tryGetArgument("-n", "4096")));
+        config.modelCache = !p.getOptionalArgument("-nmc");
+    }
+    else
+    {
+        std::cerr << p.getError();
+        return false;
+    }
+    return true;
+}
+
+static void printStats(const NcDaemonStats &stats)
+{
+    std::cout << "#--- NC daemon stats ---" << std::endl;
+    std::cout << "# - Streams served      : " << stats.nStreams << ", at most " << stats.maxActive << " at once" << std::endl;
+    std::cout << "# - Streams refused     : " << stats.nRefused << std::endl;
+    std::cout << "# - Frames processed    : " << stats.nFrames << std::endl;
+    if (stats.modelCacheHits + stats.modelCacheMisses != 0)
+    {
+        std::cout << "# - Model cache         : " << stats.modelCacheHits << " hits, "
+                  << stats.modelCacheMisses << " misses" << std::endl;
+    }
+    if (stats.frameLatency.getCount() != 0)
+    {
+        std::cout << "# - Frame latency (us)  : p50 " << stats.frameLatency.getPercentileNs(50) / 1000
+                  << ", p99 " << stats.frameLatency.getPercentileNs(99) / 1000
+                  << ", max " << stats.frameLatency.getMaxNs() / 1000 << std::endl;
+    }
+    std::cout << "#-----------------------" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    NcDaemonConfig config;
+
+    if (parseArguments(config, argc, argv))
+    {
+        int result = 0;
+        // A client that goes away is handled as a write error
+        std::signal(SIGPIPE, SIG_IGN);
+        std::signal(SIGINT, onStopSignal);
+        std::signal(SIGTERM, onStopSignal);
+        try
+        {
+            // The SDK is initialized once and stays resident for every stream
+            globalInit(L"");
+
+            NcDaemonStats stats{};
+            std::cout << "Listening on " << config.socketPath << std::endl;
+            auto daemonResult = runNcDaemon(config, &stats);
+            if (daemonResult.first)
+            {
+                printStats(stats);
+            }
+            else
+            {
+                result = error(daemonResult.second);
+            }
+
+            // runNcDaemon releases all NC sessions before returning
+            globalDestroy();
+        }
+        catch (const std::exception &ex)
+        {
+            std::cerr << "std::exception: " << ex.what() << std::endl;
+        }
+        catch (...)
+        {
+            std::cerr << "Unknown exception thrown..." << std::endl;
+        }
+        return result;
+    }
+    else
+    {
+        std::cerr << "\nUsage:\n\t" << argv[0] << " -u socket_path -m model_path [-t threads] [-n max_streams] [-nmc]"
+                  << std::endl;
+        if (argc == 1)
+        {
+            return 0;
+        }
+        return 1;
+    }
+}
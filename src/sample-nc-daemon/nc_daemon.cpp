@@ -0,0 +1,830 @@
+#include "nc_daemon.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <krisp-audio-sdk.hpp>
+#include <krisp-audio-sdk-nc.hpp>
+
+#include "frame_duration.hpp"
+#include "model_cache.hpp"
+#include "nc_socket_protocol.hpp"
+#include "sampling_rate.hpp"
+
+using namespace Krisp::AudioSdk;
+
+using Clock = std::chrono::steady_clock;
+
+// Frames a thread processes for one stream before it moves on to the next
+// one, so a stream with a backlog does not delay the others
+constexpr size_t kFramesPerTurn = 4;
+// Input buffered per stream before the daemon stops reading from it
+constexpr size_t kMaxBufferedInput = 1 << 18;
+// Output waiting for the client before the daemon stops processing and
+// reading the stream, both resume when the client has read half of it
+constexpr size_t kMaxBufferedOutput = 1 << 18;
+constexpr size_t kReadChunk = 1 << 16;
+constexpr int kMaxEvents = 64;
+
+// Event ids of the two descriptors that are not streams
+constexpr uint64_t kListenId = 0;
+constexpr uint64_t kWakeId = 1;
+
+static std::atomic<bool> g_stop(false);
+static std::atomic<int> g_wakeFd(-1);
+
+static uint64_t toNs(Clock::duration d)
+{
+    return static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(d).count()));
+}
+
+static void wakeEventLoop()
+{
+    int fd = g_wakeFd.load();
+    if (fd >= 0)
+    {
+        uint64_t one = 1;
+        ssize_t rc = ::write(fd, &one, sizeof(one));
+        (void)rc;
+    }
+}
+
+void stopNcDaemon()
+{
+    g_stop = true;
+    wakeEventLoop();
+}
+
+struct NcConnection
+{
+    uint64_t id;
+    int fd;
+
+    std::mutex mutex;
+    // Guarded by the mutex, shared by the event loop and the processing threads
+    std::vector<uint8_t> input;
+    size_t inputBegin;
+    uint64_t nReceived; // bytes appended to the input since the connection
+    uint64_t nConsumed; // bytes taken out of the input
+    // The end offset and the time of the reads, to time the frames they complete
+    std::deque<std::pair<uint64_t, Clock::time_point>> arrivals;
+    std::vector<uint8_t> output;
+    size_t outputBegin;
+    bool negotiated;
+    bool inputEnd;
+    bool queued;        // waiting for or held by a processing thread
+    bool finished;      // no more output, the socket is closed once it is sent
+    bool outputBlocked; // the client does not read, nothing is processed
+
+    // Used by the processing thread that holds the stream
+    NcStreamFormat format;
+    size_t sampleBytes;
+    size_t frameSize;
+    size_t frameBytes;
+    float noiseSuppressionLevel;
+    std::shared_ptr<Nc<int16_t>> session16;
+    std::shared_ptr<Nc<float>> sessionFloat;
+    std::vector<uint8_t> frameIn;
+    std::vector<uint8_t> frameOut;
+
+    // Used by the event loop only
+    bool closed;
+    bool readPaused;
+    uint32_t events; // the epoll interest of the socket
+
+    size_t getAvailable() const
+    {
+        return input.size() - inputBegin;
+    }
+
+    size_t getPendingOutput() const
+    {
+        return output.size() - outputBegin;
+    }
+
+    // Something a processing thread can do, the mutex must be held
+    bool hasWork() const
+    {
+        if (finished || outputBlocked)
+        {
+            return false;
+        }
+        if (!negotiated)
+        {
+            return getAvailable() >= kNcStreamRequestSize || inputEnd;
+        }
+        return getAvailable() >= frameBytes || inputEnd;
+    }
+};
+
+struct NcWorkerStats
+{
+    uint64_t nFrames;
+    uint64_t nRefused;
+    LatencyHistogram frameLatency;
+};
+
+class NcDaemon
+{
+private:
+    const NcDaemonConfig &m_config;
+    // Outlives the sessions of m_connections
+    ModelCache m_modelCache;
+    int m_epollFd;
+    int m_listenFd;
+    int m_wakeFd;
+    uint64_t m_nextId;
+    std::unordered_map<uint64_t, std::shared_ptr<NcConnection>> m_connections;
+    std::vector<uint8_t> m_readChunk;
+    uint64_t m_nStreams;
+    uint64_t m_nRefused;
+    unsigned m_maxActive;
+
+    // Streams waiting for a processing thread
+    std::mutex m_queueMutex;
+    std::condition_variable m_queueCv;
+    std::deque<std::shared_ptr<NcConnection>> m_queue;
+    bool m_stopWorkers;
+    std::vector<std::thread> m_workers;
+    std::vector<NcWorkerStats> m_workerStats;
+
+    // Streams with new output, handed from the processing threads to the event loop
+    std::mutex m_readyMutex;
+    std::vector<std::shared_ptr<NcConnection>> m_ready;
+
+    void enqueue(const std::shared_ptr<NcConnection> &conn);
+    void workerLoop(unsigned index);
+    NcStreamReply openSession(NcConnection &conn, const NcStreamRequest &request);
+    void serve(NcConnection &conn, NcWorkerStats &stats);
+
+    void accept();
+    void refuse(int fd);
+    void readInput(const std::shared_ptr<NcConnection> &conn);
+    void writeOutput(const std::shared_ptr<NcConnection> &conn);
+    void updateEvents(NcConnection &conn, bool outputPending);
+    void close(NcConnection &conn);
+
+public:
+    explicit NcDaemon(const NcDaemonConfig &config);
+    ~NcDaemon();
+
+    std::pair<bool, std::string> open();
+    // Returns once stopNcDaemon() is called
+    void run();
+    // The streams in flight are dropped
+    void stopWorkers();
+    void collectStats(NcDaemonStats *stats) const;
+};
+
+NcDaemon::NcDaemon(const NcDaemonConfig &config)
+    : m_config(config), m_epollFd(-1), m_listenFd(-1), m_wakeFd(-1), m_nextId(kWakeId + 1),
+      m_readChunk(kReadChunk), m_nStreams(0), m_nRefused(0), m_maxActive(0), m_stopWorkers(false)
+{
+}
+
+NcDaemon::~NcDaemon()
+{
+    stopWorkers();
+    // The sessions are released with the connections
+    for (auto &entry : m_connections)
+    {
+        ::close(entry.second->fd);
+    }
+    m_connections.clear();
+    m_queue.clear();
+    m_ready.clear();
+    g_wakeFd = -1;
+    if (m_wakeFd >= 0)
+    {
+        ::close(m_wakeFd);
+    }
+    if (m_listenFd >= 0)
+    {
+        ::close(m_listenFd);
+        ::unlink(m_config.socketPath.c_str());
+    }
+    if (m_epollFd >= 0)
+    {
+        ::close(m_epollFd);
+    }
+}
+
+void NcDaemon::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_stopWorkers = true;
+    }
+    m_queueCv.notify_all();
+    for (auto &worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+// A socket file nobody listens on, the one of a daemon that did not exit
+// cleanly. Any other file, and the socket of a running daemon, is left to
+// make bind fail.
+static bool isStaleSocket(const sockaddr_un &address)
+{
+    struct stat st;
+    if (lstat(address.sun_path, &st) != 0 || !S_ISSOCK(st.st_mode))
+    {
+        return false;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return false;
+    }
+    bool refused = connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 &&
+                   errno == ECONNREFUSED;
+    ::close(fd);
+    return refused;
+}
+
+std::pair<bool, std::string> NcDaemon::open()
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (m_config.socketPath.empty() || m_config.socketPath.size() >= sizeof(address.sun_path))
+    {
+        return std::make_pair(false, std::string("The socket path is empty or too long"));
+    }
+    std::memcpy(address.sun_path, m_config.socketPath.c_str(), m_config.socketPath.size() + 1);
+
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epollFd < 0 || m_wakeFd < 0)
+    {
+        return std::make_pair(false, std::string("epoll: ") + std::strerror(errno));
+    }
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0)
+    {
+        return std::make_pair(false, std::string("socket: ") + std::strerror(errno));
+    }
+    // A socket file left by a previous run would make bind fail
+    if (isStaleSocket(address))
+    {
+        ::unlink(m_config.socketPath.c_str());
+    }
+    if (bind(m_listenFd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+        listen(m_listenFd, SOMAXCONN) != 0)
+    {
+        std::string msg = m_config.socketPath + ": " + std::strerror(errno);
+        ::close(m_listenFd);
+        m_listenFd = -1;
+        return std::make_pair(false, msg);
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = kListenId;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_listenFd, &event);
+    event.data.u64 = kWakeId;
+    epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event);
+    g_wakeFd = m_wakeFd;
+
+    unsigned nThreads = m_config.nThreads != 0 ? m_config.nThreads : std::max(1u, std::thread::hardware_concurrency());
+    m_workerStats.resize(nThreads);
+    for (unsigned i = 0; i < nThreads; ++i)
+    {
+        m_workers.emplace_back(&NcDaemon::workerLoop, this, i);
+    }
+    return std::make_pair(true, std::string());
+}
+
+void NcDaemon::enqueue(const std::shared_ptr<NcConnection> &conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_queue.push_back(conn);
+    }
+    m_queueCv.notify_one();
+}
+
+void NcDaemon::workerLoop(unsigned index)
+{
+    NcWorkerStats &stats = m_workerStats[index];
+    for (;;)
+    {
+        std::shared_ptr<NcConnection> conn;
+        {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_queueCv.wait(lock, [this] { return m_stopWorkers || !m_queue.empty(); });
+            if (m_stopWorkers)
+            {
+                return;
+            }
+            conn = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        try
+        {
+            serve(*conn, stats);
+        }
+        catch (...)
+        {
+            // The SDK failed on this stream, the others go on
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            conn->finished = true;
+        }
+
+        bool requeue;
+        {
+            std::lock_guard<std::mutex> lock(conn->mutex);
+            requeue = conn->hasWork();
+            conn->queued = requeue;
+        }
+        if (requeue)
+        {
+            // Back to the end of the queue, behind the streams that wait
+            enqueue(conn);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_readyMutex);
+            m_ready.push_back(conn);
+        }
+        wakeEventLoop();
+    }
+}
+
+NcStreamReply NcDaemon::openSession(NcConnection &conn, const NcStreamRequest &request)
+{
+    auto samplingRateResult = getKrispSamplingRate(request.samplingRate);
+    bool knownDuration = false;
+    for (auto frameDuration : kFrameDurations)
+    {
+        knownDuration = knownDuration || request.frameDurationMs == static_cast<unsigned>(frameDuration);
+    }
+    if (!samplingRateResult.second || !knownDuration ||
+        (request.format != NcStreamFormat::PCM16 && request.format != NcStreamFormat::FLOAT))
+    {
+        return NcStreamReply{NcStreamStatus::UNSUPPORTED, 0};
+    }
+
+    const FrameDuration frameDurationMillis = static_cast<FrameDuration>(request.frameDurationMs);
+    conn.format = request.format;
+    conn.sampleBytes = getNcStreamSampleBytes(request.format);
+    conn.frameSize = (request.samplingRate * static_cast<size_t>(frameDurationMillis)) / 1000;
+    conn.frameBytes = conn.frameSize * conn.sampleBytes;
+    conn.noiseSuppressionLevel = request.noiseSuppressionLevel;
+    conn.frameIn.resize(conn.frameBytes);
+    conn.frameOut.resize(conn.frameBytes);
+
+    ModelInfo ncModelInfo = getModelInfo(m_config.modelCache ? &m_modelCache : nullptr, m_config.weight);
+
+    NcSessionConfig ncCfg =
+        {
+            samplingRateResult.first,
+            frameDurationMillis,
+            samplingRateResult.first,
+            &ncModelInfo,
+            false,
+            nullptr // Ringtone model cfg for inbound
+        };
+    try
+    {
+        if (request.format == NcStreamFormat::PCM16)
+        {
+            conn.session16 = Nc<int16_t>::create(ncCfg);
+        }
+        else
+        {
+            conn.sessionFloat = Nc<float>::create(ncCfg);
+        }
+    }
+    catch (const std::exception &)
+    {
+        return NcStreamReply{NcStreamStatus::SESSION_FAILED, 0};
+    }
+    return NcStreamReply{NcStreamStatus::OK, static_cast<uint32_t>(conn.frameSize)};
+}
+
+// Runs with the stream held by the calling thread. The mutex is released
+// while the session is created and while the frames are processed, the
+// event loop keeps appending input in the meantime.
+void NcDaemon::serve(NcConnection &conn, NcWorkerStats &stats)
+{
+    std::unique_lock<std::mutex> lock(conn.mutex);
+    if (!conn.negotiated)
+    {
+        if (conn.getAvailable() < kNcStreamRequestSize)
+        {
+            // The client left before sending its request
+            conn.finished = true;
+            return;
+        }
+        NcStreamRequest request{};
+        bool valid = decodeNcStreamRequest(conn.input.data() + conn.inputBegin, request) &&
+                     request.version == kNcStreamVersion;
+        conn.inputBegin += kNcStreamRequestSize;
+        conn.nConsumed += kNcStreamRequestSize;
+        lock.unlock();
+
+        NcStreamReply reply = valid ? openSession(conn, request) : NcStreamReply{NcStreamStatus::BAD_REQUEST, 0};
+        uint8_t replyBytes[kNcStreamReplySize];
+        encodeNcStreamReply(reply, replyBytes);
+
+        lock.lock();
+        conn.output.insert(conn.output.end(), replyBytes, replyBytes + kNcStreamReplySize);
+        conn.negotiated = true;
+        if (reply.status != NcStreamStatus::OK)
+        {
+            ++stats.nRefused;
+            conn.finished = true;
+            return;
+        }
+    }
+
+    for (size_t k = 0; k < kFramesPerTurn; ++k)
+    {
+        size_t nBytes = std::min(conn.getAvailable(), conn.frameBytes);
+        if (nBytes < conn.frameBytes && !conn.inputEnd)
+        {
+            break;
+        }
+        // A trailing partial sample at the end of the stream is dropped
+        nBytes -= nBytes % conn.sampleBytes;
+        if (nBytes == 0)
+        {
+            conn.finished = true;
+            break;
+        }
+        std::memcpy(conn.frameIn.data(), conn.input.data() + conn.inputBegin, nBytes);
+        conn.inputBegin += nBytes;
+        conn.nConsumed += nBytes;
+        while (conn.arrivals.size() > 1 && conn.arrivals.front().first < conn.nConsumed)
+        {
+            conn.arrivals.pop_front();
+        }
+        const Clock::time_point arrival = conn.arrivals.empty() ? Clock::now() : conn.arrivals.front().second;
+        lock.unlock();
+
+        if (nBytes < conn.frameBytes)
+        {
+            // The last frame of the stream is incomplete, pad it with silence
+            std::fill(conn.frameIn.begin() + static_cast<std::ptrdiff_t>(nBytes), conn.frameIn.end(), uint8_t(0));
+        }
+        if (conn.format == NcStreamFormat::PCM16)
+        {
+            conn.session16->process(reinterpret_cast<const int16_t *>(conn.frameIn.data()), conn.frameSize,
+                                    reinterpret_cast<int16_t *>(conn.frameOut.data()), conn.frameSize,
+                                    conn.noiseSuppressionLevel, nullptr);
+        }
+        else
+        {
+            conn.sessionFloat->process(reinterpret_cast<const float *>(conn.frameIn.data()), conn.frameSize,
+                                       reinterpret_cast<float *>(conn.frameOut.data()), conn.frameSize,
+                                       conn.noiseSuppressionLevel, nullptr);
+        }
+
+        lock.lock();
+        conn.output.insert(conn.output.end(), conn.frameOut.begin(),
+                           conn.frameOut.begin() + static_cast<std::ptrdiff_t>(nBytes));
+        stats.frameLatency.record(toNs(Clock::now() - arrival));
+        ++stats.nFrames;
+        if (nBytes < conn.frameBytes)
+        {
+            conn.finished = true;
+            break;
+        }
+        if (conn.getPendingOutput() >= kMaxBufferedOutput)
+        {
+            conn.outputBlocked = true;
+            break;
+        }
+    }
+}
+
+void NcDaemon::accept()
+{
+    for (;;)
+    {
+        int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        if (m_connections.size() >= m_config.maxStreams)
+        {
+            refuse(fd);
+            continue;
+        }
+        auto conn = std::make_shared<NcConnection>();
+        conn->id = m_nextId++;
+        conn->fd = fd;
+        conn->inputBegin = 0;
+        conn->nReceived = 0;
+        conn->nConsumed = 0;
+        conn->outputBegin = 0;
+        conn->negotiated = false;
+        conn->inputEnd = false;
+        conn->queued = false;
+        conn->finished = false;
+        conn->outputBlocked = false;
+        conn->closed = false;
+        conn->readPaused = false;
+        conn->events = EPOLLIN;
+
+        epoll_event event{};
+        event.events = conn->events;
+        event.data.u64 = conn->id;
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, fd, &event);
+        m_connections.emplace(conn->id, conn);
+        ++m_nStreams;
+        m_maxActive = std::max(m_maxActive, static_cast<unsigned>(m_connections.size()));
+    }
+}
+
+void NcDaemon::refuse(int fd)
+{
+    uint8_t replyBytes[kNcStreamReplySize];
+    encodeNcStreamReply(NcStreamReply{NcStreamStatus::BUSY, 0}, replyBytes);
+    // The reply fits in the empty socket buffer of a new connection
+    ssize_t rc = send(fd, replyBytes, sizeof(replyBytes), MSG_NOSIGNAL);
+    (void)rc;
+    ::close(fd);
+    ++m_nRefused;
+}
+
+void NcDaemon::readInput(const std::shared_ptr<NcConnection> &conn)
+{
+    bool enqueueConn = false;
+    for (;;)
+    {
+        ssize_t nRead = ::read(conn->fd, m_readChunk.data(), m_readChunk.size());
+        if (nRead < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (nRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        if (nRead < 0)
+        {
+            close(*conn);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        if (nRead == 0)
+        {
+            conn->inputEnd = true;
+        }
+        else
+        {
+            // The consumed bytes are dropped before the buffer grows
+            conn->input.erase(conn->input.begin(), conn->input.begin() + static_cast<std::ptrdiff_t>(conn->inputBegin));
+            conn->inputBegin = 0;
+            conn->input.insert(conn->input.end(), m_readChunk.data(), m_readChunk.data() + nRead);
+            conn->nReceived += static_cast<uint64_t>(nRead);
+            conn->arrivals.emplace_back(conn->nReceived, Clock::now());
+        }
+        if (!conn->queued && conn->hasWork())
+        {
+            conn->queued = true;
+            enqueueConn = true;
+        }
+        if (conn->inputEnd || conn->getAvailable() >= kMaxBufferedInput)
+        {
+            // Reading resumes when the processing threads catch up
+            conn->readPaused = !conn->inputEnd;
+            break;
+        }
+    }
+    if (enqueueConn)
+    {
+        enqueue(conn);
+    }
+    writeOutput(conn);
+}
+
+void NcDaemon::writeOutput(const std::shared_ptr<NcConnection> &conn)
+{
+    if (conn->closed)
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(conn->mutex);
+    while (conn->outputBegin < conn->output.size())
+    {
+        ssize_t nWritten = send(conn->fd, conn->output.data() + conn->outputBegin,
+                                conn->output.size() - conn->outputBegin, MSG_NOSIGNAL);
+        if (nWritten < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (nWritten < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        if (nWritten < 0)
+        {
+            conn->finished = true;
+            lock.unlock();
+            close(*conn);
+            return;
+        }
+        conn->outputBegin += static_cast<size_t>(nWritten);
+    }
+    bool outputPending = conn->outputBegin < conn->output.size();
+    if (!outputPending)
+    {
+        conn->output.clear();
+        conn->outputBegin = 0;
+    }
+    else if (conn->outputBegin >= kMaxBufferedOutput)
+    {
+        // The sent bytes are dropped, the buffer does not grow while the
+        // client keeps up with part of the output
+        conn->output.erase(conn->output.begin(), conn->output.begin() + static_cast<std::ptrdiff_t>(conn->outputBegin));
+        conn->outputBegin = 0;
+    }
+    if (conn->finished && !outputPending)
+    {
+        lock.unlock();
+        close(*conn);
+        return;
+    }
+    if (conn->readPaused && conn->getAvailable() < kMaxBufferedInput / 2)
+    {
+        conn->readPaused = false;
+    }
+    bool enqueueConn = false;
+    if (conn->outputBlocked && conn->getPendingOutput() < kMaxBufferedOutput / 2)
+    {
+        conn->outputBlocked = false;
+        if (!conn->queued && conn->hasWork())
+        {
+            conn->queued = true;
+            enqueueConn = true;
+        }
+    }
+    lock.unlock();
+    if (enqueueConn)
+    {
+        enqueue(conn);
+    }
+    updateEvents(*conn, outputPending);
+}
+
+void NcDaemon::updateEvents(NcConnection &conn, bool outputPending)
+{
+    uint32_t events = 0;
+    {
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        if (!conn.readPaused && !conn.outputBlocked && !conn.inputEnd)
+        {
+            events |= EPOLLIN;
+        }
+    }
+    if (outputPending)
+    {
+        events |= EPOLLOUT;
+    }
+    if (events != conn.events)
+    {
+        epoll_event event{};
+        event.events = events;
+        event.data.u64 = conn.id;
+        epoll_ctl(m_epollFd, EPOLL_CTL_MOD, conn.fd, &event);
+        conn.events = events;
+    }
+}
+
+void NcDaemon::close(NcConnection &conn)
+{
+    if (conn.closed)
+    {
+        return;
+    }
+    {
+        // Nothing is left for a processing thread that still holds the stream
+        std::lock_guard<std::mutex> lock(conn.mutex);
+        conn.finished = true;
+    }
+    conn.closed = true;
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    ::close(conn.fd);
+    m_connections.erase(conn.id);
+}
+
+void NcDaemon::run()
+{
+    epoll_event events[kMaxEvents];
+    while (!g_stop)
+    {
+        int nEvents = epoll_wait(m_epollFd, events, kMaxEvents, -1);
+        if (nEvents < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        for (int i = 0; i < nEvents; ++i)
+        {
+            const uint64_t id = events[i].data.u64;
+            if (id == kListenId)
+            {
+                accept();
+                continue;
+            }
+            if (id == kWakeId)
+            {
+                uint64_t count;
+                ssize_t rc = ::read(m_wakeFd, &count, sizeof(count));
+                (void)rc;
+                std::vector<std::shared_ptr<NcConnection>> ready;
+                {
+                    std::lock_guard<std::mutex> lock(m_readyMutex);
+                    ready.swap(m_ready);
+                }
+                for (const auto &conn : ready)
+                {
+                    writeOutput(conn);
+                }
+                continue;
+            }
+            auto it = m_connections.find(id);
+            if (it == m_connections.end())
+            {
+                // Closed earlier in this batch
+                continue;
+            }
+            std::shared_ptr<NcConnection> conn = it->second;
+            if (events[i].events & EPOLLIN)
+            {
+                readInput(conn);
+            }
+            else if (events[i].events & (EPOLLHUP | EPOLLERR))
+            {
+                close(*conn);
+            }
+            if (!conn->closed && (events[i].events & EPOLLOUT))
+            {
+                writeOutput(conn);
+            }
+        }
+    }
+}
+
+void NcDaemon::collectStats(NcDaemonStats *stats) const
+{
+    stats->nStreams = m_nStreams;
+    stats->nRefused = m_nRefused;
+    stats->nFrames = 0;
+    stats->maxActive = m_maxActive;
+    const ModelCache::Stats cacheStats = m_modelCache.getStats();
+    stats->modelCacheHits = cacheStats.hits;
+    stats->modelCacheMisses = cacheStats.misses;
+    stats->frameLatency.reset();
+    for (const auto &workerStats : m_workerStats)
+    {
+        stats->nFrames += workerStats.nFrames;
+        stats->nRefused += workerStats.nRefused;
+        stats->frameLatency.merge(workerStats.frameLatency);
+    }
+}
+
+std::pair<bool, std::string> runNcDaemon(const NcDaemonConfig &config, NcDaemonStats *stats)
+{
+    g_stop = false;
+    NcDaemon daemon(config);
+    auto openResult = daemon.open();
+    if (!openResult.first)
+    {
+        return openResult;
+    }
+    daemon.run();
+    daemon.stopWorkers();
+    if (stats)
+    {
+        daemon.collectStats(stats);
+    }
+    return std::make_pair(true, std::string());
+}
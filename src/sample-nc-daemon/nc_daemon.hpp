@@ -0,0 +1,44 @@
+#ifndef NC_DAEMON_HPP
+#define NC_DAEMON_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "latency_histogram.hpp"
+
+struct NcDaemonConfig
+{
+    std::string socketPath;
+    std::string weight;
+    unsigned nThreads;   // processing threads, the hardware concurrency if 0
+    unsigned maxStreams; // streams over the limit are refused with BUSY
+    bool modelCache;     // the sessions share one mapping of the model file
+};
+
+struct NcDaemonStats
+{
+    uint64_t nStreams;   // streams accepted
+    uint64_t nRefused;   // streams refused or failed during the negotiation
+    uint64_t nFrames;    // frames processed
+    unsigned maxActive;  // peak of concurrent streams
+    uint64_t modelCacheHits;
+    uint64_t modelCacheMisses;
+    // From the read that completed a frame to its output being queued for
+    // the socket, the time the frame waits for a processing thread included
+    LatencyHistogram frameLatency;
+};
+
+// Serves NC streams on a Unix domain socket until stopNcDaemon() is called.
+// One thread runs an epoll loop that accepts the clients and does all the
+// socket I/O, a fixed pool of threads creates the sessions and processes
+// the frames. Every stream has its own Nc<int16_t> or Nc<float> session
+// and is processed by one thread at a time, so its frames stay in order.
+// The caller is responsible for the Krisp SDK globalInit/globalDestroy
+// calls, every session is released before the function returns.
+std::pair<bool, std::string> runNcDaemon(const NcDaemonConfig &config, NcDaemonStats *stats);
+
+// Makes runNcDaemon return, safe to call from a signal handler
+void stopNcDaemon();
+
+#endif
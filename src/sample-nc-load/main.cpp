@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "argument_parser.hpp"
+#include "frame_duration.hpp"
+#include "latency_histogram.hpp"
+#include "nc_socket_protocol.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Delay before the first frame, leaves time to connect every stream
+constexpr auto kStartDelay = std::chrono::milliseconds(200);
+
+template <typename T>
+int error(const T &e)
+{
+    std::cerr << e << std::endl;
+    return 1;
+}
+
+struct LoadConfig
+{
+    std::string socketPath;
+    unsigned nStreams;
+    double seconds;       // audio sent by every stream
+    std::vector<uint32_t> samplingRates; // the streams cycle through the rates and formats
+    std::vector<NcStreamFormat> formats;
+    unsigned frameDurationMs;
+    float noiseSuppressionLevel;
+    bool paced; // send a frame per frame duration instead of as fast as possible
+};
+
+struct StreamResult
+{
+    uint64_t nFrames;
+    uint64_t nMissed; // paced frames returned after the arrival of the next one
+    LatencyHistogram roundTrip;
+    double audioSeconds;
+    bool refused;
+    std::string errorMsg;
+};
+
+static bool parseList(const std::string &value, std::vector<std::string> &items)
+{
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (item.empty())
+        {
+            return false;
+        }
+        items.push_back(item);
+    }
+    return !items.empty();
+}
+
+static bool parseArguments(LoadConfig &config, int argc, char **argv)
+{
+    ArgumentParser p(argc, argv);
+    p.addArgument("--socket", "-u", IMPORTANT);
+    p.addArgument("--streams", "-n");
+    p.addArgument("--duration", "-d");
+    p.addArgument("--rate", "-r");
+    p.addArgument("--format", "-f");
+    p.addArgument("--frame_duration", "-fd");
+    p.addArgument("--suppress_level", "-sl");
+    p.addArgument("--unpaced", "-x", OPTIONAL);
+    if (!p.parse())
+    {
+        std::cerr << p.getError();
+        return false;
+    }
+    config.socketPath = p.getArgument("-u");
+    config.nStreams = static_cast<unsigned>(std::stoul(p.tryGetArgument("-n", "1")));
+    config.seconds = std::stod(p.tryGetArgument("-d", "10"));
+    config.noiseSuppressionLevel = std::stof(p.tryGetArgument("-sl", "100.0"));
+    config.paced = !p.getOptionalArgument("-x");
+    if (!parseFrameDuration(p.tryGetArgument("-fd", "10"), config.frameDurationMs))
+    {
+        std::cerr << "argument -fd should be one of " << getFrameDurationNames() << "!";
+        return false;
+    }
+    std::vector<std::string> rates;
+    std::vector<std::string> formats;
+    if (!parseList(p.tryGetArgument("-r", "16000"), rates) || !parseList(p.tryGetArgument("-f", "s16"), formats))
+    {
+        std::cerr << "arguments -r and -f take comma separated lists!";
+        return false;
+    }
+    for (const auto &rate : rates)
+    {
+        config.samplingRates.push_back(static_cast<uint32_t>(std::stoul(rate)));
+    }
+    for (const auto &format : formats)
+    {
+        if (format != "s16" && format != "f32")
+        {
+            std::cerr << "argument -f should list s16 or f32!";
+            return false;
+        }
+        config.formats.push_back(format == "s16" ? NcStreamFormat::PCM16 : NcStreamFormat::FLOAT);
+    }
+    if (config.nStreams == 0)
+    {
+        std::cerr << "argument -n should be at least 1!";
+        return false;
+    }
+    return true;
+}
+
+// Deterministic test signal: a few harmonics with a slow amplitude
+// modulation over pseudo random noise
+static std::vector<float> makeSignal(uint32_t samplingRate, size_t nSamples)
+{
+    const double pi = std::acos(-1.0);
+    std::vector<float> signal(nSamples);
+    uint32_t lcg = 12345;
+    for (size_t n = 0; n < nSamples; ++n)
+    {
+        double t = static_cast<double>(n) / samplingRate;
+        double envelope = 0.5 + 0.5 * std::sin(2 * pi * 2.0 * t);
+        double voice = 0.2 * std::sin(2 * pi * 220.0 * t) + 0.1 * std::sin(2 * pi * 440.0 * t) +
+                       0.05 * std::sin(2 * pi * 880.0 * t);
+        lcg = lcg * 1664525u + 1013904223u;
+        double noise = (static_cast<double>(lcg >> 8) / static_cast<double>(1u << 24) - 0.5) * 0.1;
+        signal[n] = static_cast<float>(envelope * voice + noise);
+    }
+    return signal;
+}
+
+static std::vector<uint8_t> encodeSignal(const std::vector<float> &signal, NcStreamFormat format)
+{
+    std::vector<uint8_t> bytes(signal.size() * getNcStreamSampleBytes(format));
+    if (format == NcStreamFormat::FLOAT)
+    {
+        std::memcpy(bytes.data(), signal.data(), bytes.size());
+        return bytes;
+    }
+    for (size_t n = 0; n < signal.size(); ++n)
+    {
+        int16_t sample = static_cast<int16_t>(std::lrint(signal[n] * 32767.0f));
+        std::memcpy(bytes.data() + n * sizeof(sample), &sample, sizeof(sample));
+    }
+    return bytes;
+}
+
+static bool sendAll(int fd, const uint8_t *data, size_t nBytes)
+{
+    while (nBytes > 0)
+    {
+        ssize_t nSent = send(fd, data, nBytes, MSG_NOSIGNAL);
+        if (nSent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (nSent <= 0)
+        {
+            return false;
+        }
+        data += nSent;
+        nBytes -= static_cast<size_t>(nSent);
+    }
+    return true;
+}
+
+// Returns the number of bytes received, less than nBytes at the end of the stream
+static size_t receiveAll(int fd, uint8_t *data, size_t nBytes)
+{
+    size_t nReceived = 0;
+    while (nReceived < nBytes)
+    {
+        ssize_t n = recv(fd, data + nReceived, nBytes - nReceived, 0);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        nReceived += static_cast<size_t>(n);
+    }
+    return nReceived;
+}
+
+static int connectDaemon(const std::string &socketPath)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        return -1;
+    }
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// Sends every frame and waits for the processed frame before the next one,
+// the round trip of a frame is measured from its arrival time when paced
+static void runStream(const LoadConfig &config, unsigned index, Clock::time_point start, StreamResult &result)
+{
+    const uint32_t samplingRate = config.samplingRates[index % config.samplingRates.size()];
+    const NcStreamFormat format =
+        config.formats[(index / config.samplingRates.size()) % config.formats.size()];
+    const Clock::duration framePeriod = std::chrono::milliseconds(config.frameDurationMs);
+    // The arrivals of the streams are spread over the frame period
+    const Clock::duration offset = framePeriod * index / config.nStreams;
+
+    int fd = connectDaemon(config.socketPath);
+    if (fd < 0)
+    {
+        result.errorMsg = config.socketPath + ": " + std::strerror(errno);
+        return;
+    }
+
+    NcStreamRequest request{kNcStreamVersion, format, samplingRate, config.frameDurationMs, config.noiseSuppressionLevel};
+    uint8_t requestBytes[kNcStreamRequestSize];
+    uint8_t replyBytes[kNcStreamReplySize];
+    encodeNcStreamRequest(request, requestBytes);
+    NcStreamReply reply{};
+    if (!sendAll(fd, requestBytes, sizeof(requestBytes)) ||
+        receiveAll(fd, replyBytes, sizeof(replyBytes)) != sizeof(replyBytes) ||
+        !decodeNcStreamReply(replyBytes, reply))
+    {
+        result.errorMsg = "The negotiation failed";
+        close(fd);
+        return;
+    }
+    if (reply.status != NcStreamStatus::OK)
+    {
+        result.refused = reply.status == NcStreamStatus::BUSY;
+        result.errorMsg = getNcStreamStatusName(reply.status);
+        close(fd);
+        return;
+    }
+
+    const size_t frameBytes = reply.frameSize * getNcStreamSampleBytes(format);
+    const size_t nFrames = static_cast<size_t>(config.seconds * 1000.0) / config.frameDurationMs;
+    const std::vector<uint8_t> signal = encodeSignal(makeSignal(samplingRate, nFrames * reply.frameSize), format);
+    std::vector<uint8_t> frameOut(frameBytes);
+
+    for (size_t k = 0; k < nFrames; ++k)
+    {
+        Clock::time_point arrival = start + offset + framePeriod * static_cast<int64_t>(k);
+        if (config.paced)
+        {
+            std::this_thread::sleep_until(arrival);
+        }
+        else
+        {
+            arrival = Clock::now();
+        }
+        if (!sendAll(fd, signal.data() + k * frameBytes, frameBytes) ||
+            receiveAll(fd, frameOut.data(), frameBytes) != frameBytes)
+        {
+            result.errorMsg = "The stream was cut after " + std::to_string(k) + " frames";
+            break;
+        }
+        const Clock::time_point end = Clock::now();
+        result.roundTrip.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - arrival).count()));
+        if (config.paced && end > arrival + framePeriod)
+        {
+            ++result.nMissed;
+        }
+        ++result.nFrames;
+    }
+
+    // The daemon closes the stream once the input ends, nothing is left
+    // to receive since only whole frames were sent
+    shutdown(fd, SHUT_WR);
+    if (result.errorMsg.empty() && receiveAll(fd, frameOut.data(), frameOut.size()) != 0)
+    {
+        result.errorMsg = "Unexpected output after the end of the stream";
+    }
+    close(fd);
+    result.audioSeconds = static_cast<double>(result.nFrames * config.frameDurationMs) / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+    LoadConfig config;
+    if (!parseArguments(config, argc, argv))
+    {
+        std::cerr << "\nUsage:\n\t" << argv[0]
+                  << " -u socket_path [-n streams] [-d seconds] [-r rate[,rate...]] [-f s16|f32[,...]] [-fd ms] [-x]"
+                  << std::endl;
+        return argc == 1 ? 0 : 1;
+    }
+
+    std::vector<StreamResult> results(config.nStreams);
+    std::vector<std::thread> threads;
+    threads.reserve(config.nStreams);
+    const Clock::time_point start = Clock::now() + kStartDelay;
+    for (unsigned s = 0; s < config.nStreams; ++s)
+    {
+        threads.emplace_back(runStream, std::cref(config), s, start, std::ref(results[s]));
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    const double wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    StreamResult total{};
+    unsigned nFailed = 0;
+    unsigned nRefused = 0;
+    for (const auto &result : results)
+    {
+        total.nFrames += result.nFrames;
+        total.nMissed += result.nMissed;
+        total.audioSeconds += result.audioSeconds;
+        total.roundTrip.merge(result.roundTrip);
+        nRefused += result.refused ? 1 : 0;
+        if (!result.errorMsg.empty())
+        {
+            if (nFailed == 0)
+            {
+                std::cerr << "Stream error: " << result.errorMsg << std::endl;
+            }
+            ++nFailed;
+        }
+    }
+
+    std::cout << "Streams: " << config.nStreams - nFailed << "/" << config.nStreams << " completed, "
+              << nRefused << " refused, " << total.nFrames << " frames"
+              << (config.paced ? ", paced" : ", unpaced") << std::endl;
+    if (total.roundTrip.getCount() != 0)
+    {
+        std::cout << "Round trip (us): p50 " << total.roundTrip.getPercentileNs(50) / 1000
+                  << ", p90 " << total.roundTrip.getPercentileNs(90) / 1000
+                  << ", p99 " << total.roundTrip.getPercentileNs(99) / 1000
+                  << ", max " << total.roundTrip.getMaxNs() / 1000 << std::endl;
+    }
+    if (config.paced)
+    {
+        std::cout << "Missed deadlines: " << total.nMissed << std::endl;
+    }
+    if (wallSeconds > 0)
+    {
+        std::cout << "Throughput: " << total.audioSeconds / wallSeconds << " audio-seconds per wall-second" << std::endl;
+    }
+    return nFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "argument_parser.hpp"
+#include "stats_sink.hpp"
+
+template <typename T>
+int error(const T &e)
+{
+    std::cerr << e << std::endl;
+    return 1;
+}
+
+struct ChannelSummary
+{
+    uint64_t nFrames;
+    uint64_t noiseEnergySum;
+    uint64_t voiceEnergySum;
+    uint32_t noiseEnergyMax;
+    uint32_t voiceEnergyMax;
+    uint64_t voicedFrames;      // voice energy above zero
+    uint64_t noiseEnergyHistogram[11]; // buckets of 10, the last one is 100
+    bool hasSession;
+    bool finalSession;
+    uint32_t sessionFrame;
+    SessionStatsRecord session; // the last one of the channel
+};
+
+struct StatsSummary
+{
+    unsigned frameDurationMs;
+    std::vector<ChannelSummary> channels;
+    uint64_t nSessionRecords;
+};
+
+static ChannelSummary &getChannel(StatsSummary &summary, unsigned channel)
+{
+    if (channel >= summary.channels.size())
+    {
+        summary.channels.resize(channel + 1, ChannelSummary{});
+    }
+    return summary.channels[channel];
+}
+
+static void addFrame(StatsSummary &summary, unsigned channel, uint32_t noiseEnergy, uint32_t voiceEnergy)
+{
+    ChannelSummary &c = getChannel(summary, channel);
+    ++c.nFrames;
+    c.noiseEnergySum += noiseEnergy;
+    c.voiceEnergySum += voiceEnergy;
+    c.noiseEnergyMax = std::max(c.noiseEnergyMax, noiseEnergy);
+    c.voiceEnergyMax = std::max(c.voiceEnergyMax, voiceEnergy);
+    c.voicedFrames += voiceEnergy > 0 ? 1 : 0;
+    ++c.noiseEnergyHistogram[std::min<uint32_t>(noiseEnergy, 100) / 10];
+}
+
+static void addSession(StatsSummary &summary, uint32_t frame, unsigned channel,
+                       const SessionStatsRecord &session, bool final)
+{
+    ChannelSummary &c = getChannel(summary, channel);
+    ++summary.nSessionRecords;
+    if (!c.hasSession || frame >= c.sessionFrame || final)
+    {
+        c.hasSession = true;
+        c.finalSession = final;
+        c.sessionFrame = frame;
+        c.session = session;
+    }
+}
+
+template <typename T>
+static bool readColumn(std::istream &in, std::vector<T> &column, size_t n)
+{
+    column.resize(n);
+    return n == 0 || static_cast<bool>(in.read(reinterpret_cast<char *>(column.data()),
+                                               static_cast<std::streamsize>(n * sizeof(T))));
+}
+
+static bool readBinary(std::istream &in, StatsSummary &summary)
+{
+    uint32_t header[4];
+    if (!in.read(reinterpret_cast<char *>(header), sizeof(header)) || header[0] != kStatsVersion)
+    {
+        return false;
+    }
+    summary.frameDurationMs = header[1];
+    summary.channels.resize(header[2], ChannelSummary{});
+
+    uint32_t counts[2];
+    std::vector<uint32_t> frame, noise, voice, sessionFrame;
+    std::vector<uint16_t> channel, sessionChannel;
+    std::vector<uint8_t> sessionFinal;
+    std::vector<uint32_t> fields[5];
+    while (in.read(reinterpret_cast<char *>(counts), sizeof(counts)))
+    {
+        bool ok = readColumn(in, frame, counts[0]) && readColumn(in, channel, counts[0]) &&
+                  readColumn(in, noise, counts[0]) && readColumn(in, voice, counts[0]) &&
+                  readColumn(in, sessionFrame, counts[1]) && readColumn(in, sessionChannel, counts[1]) &&
+                  readColumn(in, sessionFinal, counts[1]);
+        for (auto &field : fields)
+        {
+            ok = ok && readColumn(in, field, counts[1]);
+        }
+        if (!ok)
+        {
+            return false;
+        }
+        for (size_t f = 0; f < counts[0]; ++f)
+        {
+            addFrame(summary, channel[f], noise[f], voice[f]);
+        }
+        for (size_t s = 0; s < counts[1]; ++s)
+        {
+            SessionStatsRecord session = {fields[0][s], fields[1][s], fields[2][s], fields[3][s], fields[4][s]};
+            addSession(summary, sessionFrame[s], sessionChannel[s], session, sessionFinal[s] != 0);
+        }
+    }
+    return in.eof();
+}
+
+static uint32_t toUint(const std::string &field)
+{
+    return field.empty() ? 0 : static_cast<uint32_t>(std::stoul(field));
+}
+
+static bool readCsv(std::istream &in, StatsSummary &summary)
+{
+    std::string line;
+    summary.frameDurationMs = 10;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line.compare(0, 7, "record,") == 0)
+        {
+            continue;
+        }
+        if (line[0] == '#')
+        {
+            unsigned frameDurationMs = 0;
+            if (std::sscanf(line.c_str(), "# frame_duration_ms: %u", &frameDurationMs) == 1)
+            {
+                summary.frameDurationMs = frameDurationMs;
+            }
+            continue;
+        }
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ','))
+        {
+            fields.push_back(field);
+        }
+        fields.resize(10);
+        if (fields[0] == "frame")
+        {
+            addFrame(summary, toUint(fields[2]), toUint(fields[3]), toUint(fields[4]));
+        }
+        else if (fields[0] == "session" || fields[0] == "final")
+        {
+            SessionStatsRecord session = {toUint(fields[5]), toUint(fields[6]), toUint(fields[7]),
+                                          toUint(fields[8]), toUint(fields[9])};
+            addSession(summary, toUint(fields[1]), toUint(fields[2]), session, fields[0] == "final");
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void printSummary(const StatsSummary &summary)
+{
+    std::cout << std::fixed << std::setprecision(2);
+    for (size_t c = 0; c < summary.channels.size(); ++c)
+    {
+        const ChannelSummary &s = summary.channels[c];
+        double n = s.nFrames ? static_cast<double>(s.nFrames) : 1.0;
+        std::cout << "#--- Channel " << c << " ---" << std::endl;
+        std::cout << "# - Frames       : " << s.nFrames << " ("
+                  << static_cast<double>(s.nFrames * summary.frameDurationMs) / 1000.0 << " s)" << std::endl;
+        std::cout << "# - Noise energy : mean " << static_cast<double>(s.noiseEnergySum) / n
+                  << ", max " << s.noiseEnergyMax << std::endl;
+        std::cout << "# - Voice energy : mean " << static_cast<double>(s.voiceEnergySum) / n
+                  << ", max " << s.voiceEnergyMax << std::endl;
+        std::cout << "# - Voiced frames: " << 100.0 * static_cast<double>(s.voicedFrames) / n << " %" << std::endl;
+        std::cout << "# - Noise energy histogram:" << std::endl;
+        for (unsigned b = 0; b < 11; ++b)
+        {
+            if (s.noiseEnergyHistogram[b] == 0)
+            {
+                continue;
+            }
+            size_t bar = static_cast<size_t>(50.0 * static_cast<double>(s.noiseEnergyHistogram[b]) / n + 0.5);
+            std::cout << "#   " << std::setw(3) << b * 10 << (b < 10 ? "-" + std::to_string(b * 10 + 9) : "   ")
+                      << std::setw(6) << "" << std::setw(10) << s.noiseEnergyHistogram[b] << " "
+                      << std::string(bar, '#') << std::endl;
+        }
+        if (s.hasSession)
+        {
+            std::cout << "# - " << (s.finalSession ? "Final" : "Last") << " session stats at frame "
+                      << s.sessionFrame << ":" << std::endl;
+            std::cout << "#   No noise " << s.session.noNoiseMs << " ms, low " << s.session.lowNoiseMs
+                      << " ms, medium " << s.session.mediumNoiseMs << " ms, high " << s.session.highNoiseMs
+                      << " ms, talk time " << s.session.talkTimeMs << " ms" << std::endl;
+        }
+    }
+    std::cout << std::defaultfloat;
+}
+
+int main(int argc, char **argv)
+{
+    ArgumentParser p(argc, argv);
+    p.addArgument("--input", "-i", IMPORTANT);
+    if (!p.parse())
+    {
+        std::cerr << p.getError();
+        std::cerr << "\nUsage:\n\t" << argv[0] << " -i stats.bin|stats.csv" << std::endl;
+        return argc == 1 ? 0 : 1;
+    }
+    const std::string path = p.getArgument("-i");
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        return error("Failed to open the stats file: " + path);
+    }
+
+    StatsSummary summary{};
+    char magic[sizeof(kStatsMagic)] = {};
+    in.read(magic, sizeof(magic));
+    bool ok;
+    if (in && std::memcmp(magic, kStatsMagic, sizeof(magic)) == 0)
+    {
+        ok = readBinary(in, summary);
+    }
+    else
+    {
+        in.clear();
+        in.seekg(0);
+        ok = readCsv(in, summary);
+    }
+    if (!ok)
+    {
+        return error("The stats file is truncated or not a stats file: " + path);
+    }
+    printSummary(summary);
+    return 0;
+}
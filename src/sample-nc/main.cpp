@@ -1,14 +1,20 @@
+#include <cmath>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
-#include <vector>
-#include <locale>
-#include <codecvt>
 
 #include <krisp-audio-sdk.hpp>
-#include <krisp-audio-sdk-nc.hpp>
 
 #include "argument_parser.hpp"
-#include "sound_file.hpp"
+#include "frame_duration.hpp"
+#include "metrics.hpp"
+#include "model_cache.hpp"
+#include "nc_batch.hpp"
+#include "nc_metrics.hpp"
+#include "nc_stream.hpp"
+#include "nc_wav_file.hpp"
+#include "thread_control.hpp"
 
 using namespace Krisp::AudioSdk;
 
@@ -19,265 +25,464 @@ int error(const T &e)
     return 1;
 }
 
-static bool parseArguments(std::string &input, std::string &output,
-                           std::string &weight, float &noiseSuppressionLevel, bool &stats, int argc, char **argv)
+struct Arguments
 {
-    ArgumentParser p(argc, argv);
-    p.addArgument("--input", "-i", IMPORTANT);
-    p.addArgument("--output", "-o", IMPORTANT);
-    p.addArgument("--model_path", "-m", IMPORTANT);
-    p.addArgument("--suppress_level", "-sl", OPTIONAL);
-    p.addArgument("--stats", "-s", OPTIONAL);
-    if (p.parse())
-    {
-        input = p.getArgument("-i");
-        output = p.getArgument("-o");
-        weight = p.getArgument("-m");
-        stats = p.getOptionalArgument("-s");
+    std::string input;
+    std::string output;
+    NcConfig nc;
+    NcBatchConfig batch;
+    NcStreamConfig stream;
+    unsigned libraryThreads;
+    bool threadReport;
+    std::string metricsPort; // empty without the HTTP endpoint
+    std::string metricsFile;
+    unsigned metricsIntervalMs;
+    bool modelCache; // share one mapping of the model, off with -nmc
+};
+
+static bool isBatchMode(const Arguments &args)
+{
+    return !args.batch.inputDir.empty() || !args.batch.inputList.empty();
+}
 
-        const auto noiseSuppressionLevelStr = p.tryGetArgument("-sl", "100.0");
-        noiseSuppressionLevel = std::stof(noiseSuppressionLevelStr);
+// "-i -" reads the audio from stdin and "-o -" writes it to stdout
+static bool isStreamMode(const Arguments &args)
+{
+    return args.input == "-" || args.output == "-";
+}
+
+static bool parseStreamFormat(const std::string &name, SoundFileFormat &format)
+{
+    if (name == "s16")
+    {
+        format = SoundFileFormat::PCM16;
+    }
+    else if (name == "f32")
+    {
+        format = SoundFileFormat::FLOAT;
     }
     else
     {
-        std::cerr << p.getError();
         return false;
     }
     return true;
 }
 
-static std::pair<SamplingRate, bool> getKrispSamplingRate(uint32_t rate)
+static bool parseNearSilencePolicy(const std::string &name, NearSilencePolicy &policy)
 {
-    std::pair<SamplingRate, bool> result;
-    result.second = true;
-    switch (rate)
+    if (name == "mute")
     {
-    case 8000:
-        result.first = SamplingRate::Sr8000Hz;
-        break;
-    case 16000:
-        result.first = SamplingRate::Sr16000Hz;
-        break;
-    case 32000:
-        result.first = SamplingRate::Sr32000Hz;
-        break;
-    case 44100:
-        result.first = SamplingRate::Sr44100Hz;
-        break;
-    case 48000:
-        result.first = SamplingRate::Sr48000Hz;
-        break;
-    case 88200:
-        result.first = SamplingRate::Sr88200Hz;
-        break;
-    case 96000:
-        result.first = SamplingRate::Sr96000Hz;
-        break;
+        policy = NearSilencePolicy::Mute;
     }
-    return result;
+    else if (name == "skip")
+    {
+        policy = NearSilencePolicy::Skip;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
 }
 
-static void readAllFrames(const SoundFile &sndFile,
-                          std::vector<short> &frames)
+static bool parseArguments(Arguments &args, int argc, char **argv)
 {
-    sndFile.readAllFramesPCM16(&frames);
-}
+    ArgumentParser p(argc, argv);
+    p.addArgument("--input", "-i");
+    p.addArgument("--output", "-o");
+    p.addArgument("--input_dir", "-id");
+    p.addArgument("--input_list", "-il");
+    p.addArgument("--output_dir", "-od");
+    p.addArgument("--jobs", "-j");
+    p.addArgument("--model_path", "-m", IMPORTANT);
+    p.addArgument("--suppress_level", "-sl", OPTIONAL);
+    p.addArgument("--stats", "-s", OPTIONAL);
+    p.addArgument("--stats_output", "-so");
+    p.addArgument("--pipeline", "-p", OPTIONAL);
+    p.addArgument("--no_mmap", "-nm", OPTIONAL);
+    p.addArgument("--resample_back", "-rb", OPTIONAL);
+    p.addArgument("--fsync", "-fs", OPTIONAL);
+    p.addArgument("--in_place", "-ip", OPTIONAL);
+    p.addArgument("--huge_pages", "-hp", OPTIONAL);
+    p.addArgument("--rate", "-r");
+    p.addArgument("--format", "-f");
+    p.addArgument("--channels", "-c");
+    p.addArgument("--wav_header", "-wh", OPTIONAL);
+    p.addArgument("--frame_duration", "-fd");
+    p.addArgument("--lib_threads", "-lt");
+    p.addArgument("--cpus", "-cpu");
+    p.addArgument("--numa_local", "-nl", OPTIONAL);
+    p.addArgument("--thread_report", "-tr", OPTIONAL);
+    p.addArgument("--skip_silence", "-ss", OPTIONAL);
+    p.addArgument("--near_silence", "-ns");
+    p.addArgument("--near_silence_policy", "-np");
+    p.addArgument("--verify_silence", "-sv", OPTIONAL);
+    p.addArgument("--metrics_port", "-mp");
+    p.addArgument("--metrics_file", "-mf");
+    p.addArgument("--metrics_interval", "-mi");
+    p.addArgument("--no_model_cache", "-nmc", OPTIONAL);
+    if (p.parse())
+    {
+        args.input = p.getArgument("-i");
+        args.output = p.getArgument("-o");
+        args.batch.inputDir = p.getArgument("-id");
+        args.batch.inputList = p.getArgument("-il");
+        args.batch.outputDir = p.getArgument("-od");
+        args.batch.jobs = static_cast<unsigned>(std::stoul(p.tryGetArgument("-j", "0")));
+        args.nc.weight = p.getArgument("-m");
+        args.nc.statsPath = p.getArgument("-so");
+        args.nc.withStats = p.getOptionalArgument("-s") || !args.nc.statsPath.empty();
+        args.nc.pipelined = p.getOptionalArgument("-p");
+        args.nc.useMmap = !p.getOptionalArgument("-nm");
+        args.nc.resampleBack = p.getOptionalArgument("-rb");
+        args.nc.fsync = p.getOptionalArgument("-fs");
+        args.nc.inPlace = p.getOptionalArgument("-ip");
+        args.nc.hugePages = p.getOptionalArgument("-hp");
+        args.stream.format.samplingRate = static_cast<uint32_t>(std::stoul(p.tryGetArgument("-r", "0")));
+        args.stream.format.channels = static_cast<unsigned>(std::stoul(p.tryGetArgument("-c", "1")));
+        args.stream.wavHeader = p.getOptionalArgument("-wh");
+        args.threadReport = p.getOptionalArgument("-tr");
+        // Parallel sessions get one library thread each unless told otherwise,
+        // one session alone keeps the library defaults
+        const bool parallel = isBatchMode(args) && args.batch.jobs != 1;
+        args.libraryThreads = static_cast<unsigned>(std::stoul(p.tryGetArgument("-lt", parallel ? "1" : "0")));
+        const std::string cpus = p.getArgument("-cpu");
+        if (!cpus.empty() && !args.batch.placement.setCpus(cpus))
+        {
+            std::cerr << args.batch.placement.getErrorMsg() << "!";
+            return false;
+        }
+        args.batch.placement.setNumaLocal(p.getOptionalArgument("-nl"));
+        // "auto" leaves 0 to let the tuner pick the duration
+        const std::string frameDuration = p.tryGetArgument("-fd", "10");
+        args.nc.frameDurationMs = 0;
+        if (frameDuration != "auto" && !parseFrameDuration(frameDuration, args.nc.frameDurationMs))
+        {
+            std::cerr << "argument -fd should be auto or one of " << getFrameDurationNames() << "!";
+            return false;
+        }
+        if (!parseStreamFormat(p.tryGetArgument("-f", "s16"), args.stream.format.format))
+        {
+            std::cerr << "argument -f should be s16 or f32!";
+            return false;
+        }
 
-static void readAllFrames(const SoundFile &sndFile,
-                          std::vector<float> &frames)
-{
-    sndFile.readAllFramesFloat(&frames);
-}
+        const auto noiseSuppressionLevelStr = p.tryGetArgument("-sl", "100.0");
+        args.nc.noiseSuppressionLevel = std::stof(noiseSuppressionLevelStr);
 
-static std::pair<bool, std::string> WriteFramesToFile(
-    const std::string &fileName,
-    const std::vector<int16_t> &frames,
-    uint32_t samplingRate)
-{
-    return writeSoundFilePCM16(fileName, frames, samplingRate);
+        args.nc.skipSilence = p.getOptionalArgument("-ss");
+        args.nc.nearSilence = NearSilencePolicy::Off;
+        args.nc.nearSilenceDb = 0.0f;
+        const std::string nearSilence = p.getArgument("-ns");
+        if (!nearSilence.empty())
+        {
+            args.nc.nearSilenceDb = std::stof(nearSilence);
+            if (!parseNearSilencePolicy(p.tryGetArgument("-np", "mute"), args.nc.nearSilence))
+            {
+                std::cerr << "argument -np should be mute or skip!";
+                return false;
+            }
+        }
+        args.nc.verifySilence = p.getOptionalArgument("-sv");
+        args.metricsPort = p.getArgument("-mp");
+        args.metricsFile = p.getArgument("-mf");
+        args.metricsIntervalMs = static_cast<unsigned>(std::stoul(p.tryGetArgument("-mi", "1000")));
+        args.nc.metrics = nullptr;
+        args.modelCache = !p.getOptionalArgument("-nmc");
+        args.nc.modelCache = nullptr;
+        args.nc.channelThreads = true;
+        args.nc.placement = &args.batch.placement;
+        if (args.nc.verifySilence && !args.nc.skipSilence && args.nc.nearSilence == NearSilencePolicy::Off)
+        {
+            std::cerr << "argument -sv requires -ss or -ns!";
+            return false;
+        }
+    }
+    else
+    {
+        std::cerr << p.getError();
+        return false;
+    }
+    if (isBatchMode(args))
+    {
+        if (args.batch.outputDir.empty() || !args.input.empty() || !args.output.empty())
+        {
+            std::cerr << "Batch mode requires -od and does not accept -i/-o!";
+            return false;
+        }
+        if (args.nc.withStats)
+        {
+            std::cerr << "Per frame stats are not supported in batch mode!";
+            return false;
+        }
+    }
+    else if (isStreamMode(args))
+    {
+        if (args.input != "-" || args.output != "-")
+        {
+            std::cerr << "The streaming mode requires both -i - and -o -!";
+            return false;
+        }
+        if (args.nc.withStats && args.nc.statsPath.empty())
+        {
+            std::cerr << "The streaming mode writes the audio to stdout, per frame stats require -so!";
+            return false;
+        }
+        if (args.nc.skipSilence || args.nc.nearSilence != NearSilencePolicy::Off)
+        {
+            std::cerr << "The silence fast path is not supported in the streaming mode!";
+            return false;
+        }
+        if (args.nc.frameDurationMs == 0)
+        {
+            // A live stream keeps the lowest latency instead of the highest throughput
+            args.nc.frameDurationMs = static_cast<unsigned>(kFrameDurations[0]);
+        }
+    }
+    else if (args.input.empty() || args.output.empty())
+    {
+        std::cerr << "argument -i and -o are important!";
+        return false;
+    }
+    return true;
 }
 
-static std::pair<bool, std::string> WriteFramesToFile(
-    const std::string &fileName,
-    const std::vector<float> &frames,
-    uint32_t samplingRate)
+static void printPipelineStats(const BlockPipelineStats &stats)
 {
-    return writeSoundFileFloat(fileName, frames, samplingRate);
+    std::cout << "#--- Pipeline stats ---" << std::endl;
+    std::cout << "# - Blocks processed    : " << stats.blocks << std::endl;
+    std::cout << "# - Reader stalls       : " << stats.readerStalls << std::endl;
+    std::cout << "# - NC input stalls     : " << stats.processInputStalls << std::endl;
+    std::cout << "# - NC output stalls    : " << stats.processOutputStalls << std::endl;
+    std::cout << "# - Writer stalls       : " << stats.writerStalls << std::endl;
+    std::cout << "# - Input queue depth   : avg " << stats.avgInputDepth << ", max " << stats.maxInputDepth << std::endl;
+    std::cout << "# - Output queue depth  : avg " << stats.avgOutputDepth << ", max " << stats.maxOutputDepth << std::endl;
+    std::cout << "#----------------------" << std::endl;
 }
 
-template <typename SamplingFormat>
-static void getNcStats(std::shared_ptr<Nc<SamplingFormat>> ncSession)
+static void printTuneResult(const NcTuneResult &tune)
 {
-    SessionStats ncSessionStats;
-
-    ncSession->getSessionStats(&ncSessionStats);
-
-    std::cout << "#--- Noise/Voice stats ---" << std::endl;
-    std::cout << "# - No     Noise: " << ncSessionStats.noiseStats.noNoiseMs << " ms" << std::endl;
-    std::cout << "# - Low    Noise: " << ncSessionStats.noiseStats.lowNoiseMs << " ms" << std::endl;
-    std::cout << "# - Medium Noise: " << ncSessionStats.noiseStats.mediumNoiseMs << " ms" << std::endl;
-    std::cout << "# - High   Noise: " << ncSessionStats.noiseStats.highNoiseMs << " ms" << std::endl;
-    std::cout << "#-------------------------" << std::endl;
-    std::cout << "# - Talk time :   " << ncSessionStats.voiceStats.talkTimeMs << " ms" << std::endl;
-    std::cout << "#-------------------------" << std::endl;
-}
-
-template <typename SamplingFormat>
-int ncWavFileTmpl(
-    const SoundFile &inSndFile,
-    const std::string &output,
-    const std::string &weight,
-    float noiseSuppressionLevel,
-    bool withStats)
-{
-    std::vector<SamplingFormat> wavDataIn;
-    readAllFrames(inSndFile, wavDataIn);
-
-    if (inSndFile.getHasError())
+    if (tune.frameDurationMs == 0)
     {
-        return error(inSndFile.getErrorMsg());
+        return;
     }
-
-    uint32_t samplingRate = inSndFile.getHeader().getSamplingRate();
-    auto samplingRateResult = getKrispSamplingRate(samplingRate);
-    if (!samplingRateResult.second)
+    std::cout << "#--- Frame duration tuning on " << tune.sampleSeconds << " s ---" << std::endl;
+    for (const auto &tuneCase : tune.cases)
     {
-        return error("Unsupported sample rate");
+        std::cout << "# - " << tuneCase.frameDurationMs << " ms: real-time factor " << tuneCase.realTimeFactor
+                  << ", " << tuneCase.frameMs << " ms per frame"
+                  << (tuneCase.frameDurationMs == tune.frameDurationMs ? " <- selected" : "") << std::endl;
     }
+    std::cout << "#-------------------------------" << std::endl;
+}
 
-    SamplingRate inRate = samplingRateResult.first;
-    const SamplingRate outRate = inRate;
-    constexpr FrameDuration frameDurationMillis = FrameDuration::Fd10ms;
-    size_t inputFrameSize = (samplingRate * static_cast<size_t>(frameDurationMillis)) / 1000;
-    size_t outputFrameSize = inputFrameSize;
-
-    try
+static void printSilenceStats(const NcSilenceStats &stats, bool verified)
+{
+    if (stats.frames == 0)
     {
-        globalInit(L"");
-
-        std::wstring_convert<std::codecvt_utf8<wchar_t>> wstringConverter;
-
-        ModelInfo ncModelInfo;
-        ncModelInfo.path = wstringConverter.from_bytes(weight);
-
-        NcSessionConfig ncCfg =
-            {
-                inRate,
-                frameDurationMillis,
-                outRate,
-                &ncModelInfo,
-                withStats,
-                nullptr // Ringtone model cfg for inbound
-            };
-
-        std::shared_ptr<Nc<SamplingFormat>> ncSession = Nc<SamplingFormat>::create(ncCfg);
-
-        //
-        // End of the SDK initialization
-        // Start of the Stream's frame by frame processing
-        //
-
-        PerFrameStats perFrameStats;
-
-        std::vector<SamplingFormat> wavDataOut(wavDataIn.size() * outputFrameSize / inputFrameSize);
-        size_t i;
-
-        for (i = 0; (i + 1) * inputFrameSize <= wavDataIn.size(); ++i)
+        return;
+    }
+    std::cout << "#--- Silence fast path ---" << std::endl;
+    std::cout << "# - Frames analysed     : " << stats.frames << std::endl;
+    std::cout << "# - Digital silence     : " << stats.silentFrames << std::endl;
+    std::cout << "# - Near silence        : " << stats.nearSilentFrames << std::endl;
+    std::cout << "# - NC skipped          : " << stats.skippedFrames << " ("
+              << 100.0 * static_cast<double>(stats.skippedFrames) / static_cast<double>(stats.frames) << "%)" << std::endl;
+    std::cout << "# - Muted               : " << stats.mutedFrames << std::endl;
+    if (verified)
+    {
+        std::cout << "# - Bit-exact           : ";
+        if (stats.mismatchedFrames == 0)
         {
-            ncSession->process(
-                &wavDataIn[i * inputFrameSize],
-                static_cast<size_t>(inputFrameSize),
-                &wavDataOut[i * outputFrameSize],
-                static_cast<size_t>(outputFrameSize),
-                noiseSuppressionLevel,
-                withStats ? &perFrameStats : nullptr);
-
-            if (withStats)
-            {
-                std::cout << "[" << i + 1 << " x " << static_cast<uint64_t>(frameDurationMillis) << "ms]"
-                          << " noiseEn: " << perFrameStats.energy.noiseEnergy
-                          << ", voiceEn: " << perFrameStats.energy.voiceEnergy << std::endl;
-
-                if (withStats && i % 100 == 0)
-                {
-                    // Get NC session stats in the middle of the processing
-                    // calculated from the start of the session processing
-                    getNcStats(ncSession);
-                }
-            }
+            std::cout << "yes" << std::endl;
         }
-
-        //
-        // End of the Stream's frame by frame processing
-        // Finalizing and closing the SDK
-        //
-
-        if (withStats)
+        else
         {
-            std::cout << "Getting Final NC session stats..." << std::endl;
-            getNcStats(ncSession);
+            std::cout << "no, " << stats.mismatchedFrames << " frames differ, "
+                      << stats.mismatchedSkippedFrames << " of them skipped, max difference "
+                      << 20.0 * std::log10(stats.maxDifference) << " dBFS" << std::endl;
         }
-
-        // ncSession is a shared_ptr. Need to make sure to free pointer before calling globalDestroy()
-        ncSession.reset();
-        globalDestroy();
-
-        // Write the output to the file
-        // wavDataOut.resize(i * outputFrameSize);
-        auto pairResult = WriteFramesToFile(output, wavDataOut, samplingRate);
-        if (!pairResult.first)
+        std::cout << "# - NC time             : full " << stats.fullSeconds << " s, fast path "
+                  << stats.fastPathSeconds << " s";
+        if (stats.fastPathSeconds > 0)
         {
-            return error(pairResult.second);
+            std::cout << ", speedup " << stats.fullSeconds / stats.fastPathSeconds << "x";
         }
+        std::cout << std::endl;
+    }
+    std::cout << "#-------------------------" << std::endl;
+}
+
+static void printThreadReport(const ThreadMonitor &monitor, std::ostream &out)
+{
+    out << "#--- Threads ---" << std::endl;
+    out << "# - Created              : " << monitor.getSeen() << ", at most " << monitor.getMaxAlive() << " at once" << std::endl;
+    for (const auto &group : monitor.getGroups())
+    {
+        out << "# - " << std::left << std::setw(20) << group.first << std::right << " : "
+            << group.second.nSeen << ", at most " << group.second.maxAlive << " at once" << std::endl;
+    }
+    out << "#---------------" << std::endl;
+}
+
+static int ncSingleFile(const Arguments &args)
+{
+    NcFileStats fileStats{};
+    auto result = ncWavFile(args.input, args.output, args.nc, &fileStats);
+    if (!result.first)
+    {
+        return error(result.second);
     }
-    catch (const std::exception &ex)
+    printTuneResult(fileStats.tune);
+    if (fileStats.ncSamplingRate != fileStats.inSamplingRate)
     {
-        std::cout << "std::exception: " << ex.what() << std::endl;
+        std::cout << "Resampled " << fileStats.inSamplingRate << " Hz to " << fileStats.ncSamplingRate
+                  << " Hz for NC" << (args.nc.resampleBack ? " and back" : "")
+                  << ", added latency " << fileStats.resamplerDelaySeconds * 1000.0 << " ms" << std::endl;
     }
-    catch (...)
+    if (args.nc.pipelined)
     {
-        std::cout << "Unknown exception thrown..." << std::endl;
+        printPipelineStats(fileStats.pipeline);
     }
+    std::cout << "Frame buffers: " << fileStats.bufferBytes / 1024 << " KiB" << std::endl;
+    printSilenceStats(fileStats.silence, args.nc.verifySilence);
+    return 0;
+}
 
+// stdout carries the audio, the summary goes to stderr
+static int ncStreamPipe(const Arguments &args)
+{
+    NcStreamStats streamStats{};
+    auto result = ncStream(args.stream, args.nc, &streamStats);
+    if (!result.first)
+    {
+        return error(result.second);
+    }
+    std::cerr << "Processed " << streamStats.audioSeconds << " s of "
+              << (streamStats.wavInput ? "WAV" : "raw") << " input at "
+              << streamStats.format.samplingRate << " Hz" << std::endl;
     return 0;
 }
 
-static int ncWavFile(const std::string &input, const std::string &output,
-                     const std::string &weight, float noiseSuppressionLevel, bool withStats)
+static int ncBatchFiles(const Arguments &args)
 {
-    SoundFile inSndFile;
-    inSndFile.loadHeader(input);
-    if (inSndFile.getHasError())
+    NcBatchResult result{};
+    auto batchResult = ncBatch(args.batch, args.nc, &result);
+    if (!batchResult.first)
     {
-        return error(inSndFile.getErrorMsg());
+        return error(batchResult.second);
     }
-    auto sndFileHeader = inSndFile.getHeader();
-    if (sndFileHeader.getFormat() == SoundFileFormat::PCM16)
+    printTuneResult(result.tune);
+    std::cout << "Processed " << result.nFiles - result.nFailed << "/" << result.nFiles << " files, "
+              << result.audioSeconds << " s of audio in " << result.wallSeconds << " s" << std::endl;
+    if (result.wallSeconds > 0)
     {
-        return ncWavFileTmpl<int16_t>(inSndFile, output, weight, noiseSuppressionLevel, withStats);
+        std::cout << "Throughput: " << result.audioSeconds / result.wallSeconds
+                  << " audio-seconds per wall-second" << std::endl;
     }
-    if (sndFileHeader.getFormat() == SoundFileFormat::FLOAT)
+    std::cout << "Frame buffers: " << result.arenaBytes / 1024 << " KiB in " << result.arenaChunks
+              << " arena allocations" << std::endl;
+    if (args.nc.modelCache)
     {
-        return ncWavFileTmpl<float>(inSndFile, output, weight, noiseSuppressionLevel, withStats);
+        const ModelCache::Stats cacheStats = args.nc.modelCache->getStats();
+        std::cout << "Model cache: " << cacheStats.hits << " hits, " << cacheStats.misses << " misses, "
+                  << cacheStats.bytes / 1024 << " KiB mapped" << std::endl;
     }
-    return error("The sound file format should be PCM16 or FLOAT.");
+    printSilenceStats(result.silence, args.nc.verifySilence);
+    return result.nFailed == 0 ? 0 : 1;
 }
 
 int main(int argc, char **argv)
 {
-    std::string in;
-    std::string out;
-    std::string weight;
-    float noiseSuppressionLevel = 100;
-    bool stats = false;
+    Arguments args;
 
-    if (parseArguments(in, out, weight, noiseSuppressionLevel, stats, argc, argv))
+    if (parseArguments(args, argc, argv))
     {
-        return ncWavFile(in, out, weight, noiseSuppressionLevel, stats);
+        int result = 0;
+        ThreadMonitor monitor;
+        if (args.threadReport)
+        {
+            monitor.start();
+        }
+        // Declared first, the sessions use its mappings until they are released
+        ModelCache modelCache;
+        if (args.modelCache)
+        {
+            args.nc.modelCache = &modelCache;
+        }
+        // The metrics are recorded only when they are exported
+        std::unique_ptr<NcMetrics> metrics;
+        std::unique_ptr<MetricsExporter> exporter;
+        if (!args.metricsPort.empty() || !args.metricsFile.empty())
+        {
+            metrics.reset(new NcMetrics());
+            args.nc.metrics = metrics.get();
+            exporter.reset(new MetricsExporter(metrics->registry));
+            if (!args.metricsPort.empty())
+            {
+                if (!exporter->startHttp(static_cast<unsigned>(std::stoul(args.metricsPort))))
+                {
+                    return error(exporter->getErrorMsg());
+                }
+                // stdout carries the audio in the streaming mode
+                std::cerr << "Metrics at http://127.0.0.1:" << exporter->getPort() << "/metrics" << std::endl;
+            }
+            if (!args.metricsFile.empty() && !exporter->startFile(args.metricsFile, args.metricsIntervalMs))
+            {
+                return error(exporter->getErrorMsg());
+            }
+        }
+        try
+        {
+            // The library pools are sized when the SDK creates them
+            limitLibraryThreads(args.libraryThreads);
+            // The batch places its workers, a single session runs on this thread
+            if (!isBatchMode(args) && !args.batch.placement.apply(0, nullptr))
+            {
+                std::cerr << "Failed to apply the CPU placement" << std::endl;
+            }
+
+            // The SDK is initialized once for the process, even for the batch mode
+            globalInit(L"");
+
+            if (isBatchMode(args))
+            {
+                result = ncBatchFiles(args);
+            }
+            else
+            {
+                result = isStreamMode(args) ? ncStreamPipe(args) : ncSingleFile(args);
+            }
+
+            // All NC sessions must be released before calling globalDestroy()
+            globalDestroy();
+        }
+        catch (const std::exception &ex)
+        {
+            std::cerr << "std::exception: " << ex.what() << std::endl;
+        }
+        catch (...)
+        {
+            std::cerr << "Unknown exception thrown..." << std::endl;
+        }
+        if (exporter)
+        {
+            exporter->stop();
+        }
+        if (args.threadReport)
+        {
+            monitor.stop();
+            // stdout carries the audio in the streaming mode
+            printThreadReport(monitor, isStreamMode(args) ? std::cerr : std::cout);
+        }
+        return result;
     }
     else
     {
-        std::cerr << "\nUsage:\n\t" << argv[0] << " -i input.wav -o output.wav -m model_path" << std::endl;
+        std::cerr << "\nUsage:\n\t" << argv[0] << " -i input.wav -o output.wav -m model_path [-fd ms|auto] [-s] [-so stats.bin|stats.csv] [-p] [-rb] [-fs] [-ip] [-hp] [-lt n] [-cpu list] [-nl] [-tr] [-ss] [-ns dBFS [-np mute|skip]] [-sv] [-mp port] [-mf file [-mi ms]] [-nmc]"
+                  << "\n\t" << argv[0] << " -i - -o - -m model_path [-fd ms] [-r rate] [-f s16|f32] [-c channels] [-wh] [-so stats.bin|stats.csv] [-lt n] [-cpu list] [-nl] [-tr] [-mp port] [-mf file [-mi ms]] [-nmc]"
+                  << "\n\t" << argv[0] << " -id input_dir|-il input_list -od output_dir -m model_path [-fd ms|auto] [-j jobs] [-p] [-rb] [-fs] [-ip] [-hp] [-lt n] [-cpu list] [-nl] [-tr] [-ss] [-ns dBFS [-np mute|skip]] [-sv] [-mp port] [-mf file [-mi ms]] [-nmc]"
+                  << std::endl;
         if (argc == 1)
         {
             return 0;
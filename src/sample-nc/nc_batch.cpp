@@ -0,0 +1,211 @@
+#include "nc_batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "frame_arena.hpp"
+#include "nc_metrics.hpp"
+#include "sound_file.hpp"
+
+namespace fs = std::filesystem;
+
+static std::pair<bool, std::string> collectInputFiles(
+    const NcBatchConfig &batchConfig,
+    std::vector<fs::path> &inputs)
+{
+    std::error_code ec;
+    if (!batchConfig.inputDir.empty())
+    {
+        for (fs::directory_iterator it(batchConfig.inputDir, ec), end; !ec && it != end; it.increment(ec))
+        {
+            if (it->is_regular_file() && hasSoundFileExtension(it->path().string()))
+            {
+                inputs.push_back(it->path());
+            }
+        }
+        if (ec)
+        {
+            return std::make_pair(false, "Failed to list the input directory: " + batchConfig.inputDir);
+        }
+        std::sort(inputs.begin(), inputs.end());
+    }
+    if (!batchConfig.inputList.empty())
+    {
+        std::ifstream list(batchConfig.inputList);
+        if (!list)
+        {
+            return std::make_pair(false, "Failed to open the input list: " + batchConfig.inputList);
+        }
+        std::string line;
+        while (std::getline(list, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (!line.empty())
+            {
+                inputs.emplace_back(line);
+            }
+        }
+    }
+    // The output file name is taken from the input file name
+    std::set<fs::path> names;
+    for (const auto &input : inputs)
+    {
+        if (!names.insert(input.filename()).second)
+        {
+            return std::make_pair(false, "Duplicate input file name: " + input.filename().string());
+        }
+    }
+    return std::make_pair(true, std::string());
+}
+
+std::pair<bool, std::string> ncBatch(
+    const NcBatchConfig &batchConfig,
+    const NcConfig &inConfig,
+    NcBatchResult *result)
+{
+    NcConfig config = inConfig;
+    std::vector<fs::path> inputs;
+    auto collectResult = collectInputFiles(batchConfig, inputs);
+    if (!collectResult.first)
+    {
+        return collectResult;
+    }
+    std::error_code ec;
+    fs::create_directories(batchConfig.outputDir, ec);
+    if (ec)
+    {
+        return std::make_pair(false, "Failed to create the output directory: " + batchConfig.outputDir);
+    }
+
+    result->tune = NcTuneResult{};
+    if (config.frameDurationMs == 0 && !inputs.empty())
+    {
+        auto tuned = ncTuneFrameDuration(inputs.front().string(), config, &result->tune);
+        if (!tuned.first)
+        {
+            return std::make_pair(false, inputs.front().string() + ": " + tuned.second);
+        }
+        config.frameDurationMs = result->tune.frameDurationMs;
+    }
+
+    unsigned jobs = batchConfig.jobs;
+    if (jobs == 0)
+    {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    jobs = static_cast<unsigned>(std::min<size_t>(jobs, std::max<size_t>(1, inputs.size())));
+    // The jobs already take the cores, threads per channel on top of them
+    // would oversubscribe the CPUs and run outside the placement
+    if (jobs > 1)
+    {
+        config.channelThreads = false;
+    }
+
+    // The files are handed out one by one through the shared index, the
+    // workers do not share anything else until the results are summed up
+    std::atomic<size_t> nextInput{0};
+    std::atomic<size_t> nFailed{0};
+    std::vector<double> audioSeconds(jobs, 0.0);
+    std::vector<NcSilenceStats> silence(jobs, NcSilenceStats{});
+    std::vector<std::unique_ptr<FrameArena>> arenas;
+    for (unsigned w = 0; w < jobs; ++w)
+    {
+        arenas.emplace_back(new FrameArena(config.hugePages));
+    }
+    std::mutex logMutex;
+    // Every worker sets the gauge when it takes a file, the last one wins
+    std::shared_ptr<MetricsShard> batchMetrics = config.metrics ? config.metrics->registry.acquireShard() : nullptr;
+    if (batchMetrics)
+    {
+        batchMetrics->setGauge(config.metrics->pendingFiles, static_cast<int64_t>(inputs.size()));
+    }
+
+    auto worker = [&](unsigned workerId) {
+        if (!batchConfig.placement.apply(workerId, "nc-worker"))
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            std::cerr << "Failed to apply the CPU placement of worker " << workerId << std::endl;
+        }
+        for (size_t idx = nextInput++; idx < inputs.size(); idx = nextInput++)
+        {
+            const fs::path &input = inputs[idx];
+            if (batchMetrics)
+            {
+                batchMetrics->setGauge(config.metrics->pendingFiles, static_cast<int64_t>(inputs.size() - idx - 1));
+            }
+            const fs::path output = fs::path(batchConfig.outputDir) / input.filename();
+            NcFileStats fileStats{};
+            std::pair<bool, std::string> fileResult;
+            try
+            {
+                fileResult = ncWavFile(input.string(), output.string(), config, &fileStats, arenas[workerId].get());
+            }
+            catch (const std::exception &ex)
+            {
+                fileResult = std::make_pair(false, std::string("std::exception: ") + ex.what());
+            }
+            catch (...)
+            {
+                fileResult = std::make_pair(false, std::string("Unknown exception thrown..."));
+            }
+            if (fileResult.first)
+            {
+                audioSeconds[workerId] += fileStats.audioSeconds;
+                addSilenceStats(silence[workerId], fileStats.silence);
+            }
+            else
+            {
+                ++nFailed;
+                std::lock_guard<std::mutex> lock(logMutex);
+                std::cerr << input.string() << ": " << fileResult.second << std::endl;
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < jobs; ++w)
+    {
+        workers.emplace_back(worker, w);
+    }
+    for (auto &thread : workers)
+    {
+        thread.join();
+    }
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - start;
+
+    result->nFiles = inputs.size();
+    result->nFailed = nFailed;
+    result->audioSeconds = 0;
+    for (double seconds : audioSeconds)
+    {
+        result->audioSeconds += seconds;
+    }
+    result->silence = NcSilenceStats{};
+    for (const auto &workerSilence : silence)
+    {
+        addSilenceStats(result->silence, workerSilence);
+    }
+    result->wallSeconds = wall.count();
+    result->arenaBytes = 0;
+    result->arenaChunks = 0;
+    for (const auto &arena : arenas)
+    {
+        result->arenaBytes += arena->getCapacity();
+        result->arenaChunks += arena->getChunkAllocations();
+    }
+    return std::make_pair(true, std::string());
+}
@@ -0,0 +1,42 @@
+#ifndef NC_BATCH_HPP
+#define NC_BATCH_HPP
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "nc_wav_file.hpp"
+#include "thread_control.hpp"
+
+struct NcBatchConfig
+{
+    std::string inputDir;  // every .wav, .flac, .ogg, .oga and .opus file of the directory is processed
+    std::string inputList; // or a text file with one input path per line
+    std::string outputDir;
+    unsigned jobs;         // number of worker threads, 0 for all cores
+    ThreadPlacement placement; // worker w is placed as index w
+};
+
+struct NcBatchResult
+{
+    size_t nFiles;
+    size_t nFailed;
+    double audioSeconds;
+    double wallSeconds;
+    size_t arenaBytes;     // frame arenas of all workers at the end
+    uint64_t arenaChunks;  // chunks the arenas allocated over the batch
+    NcTuneResult tune; // filled when the frame duration was tuned
+    NcSilenceStats silence; // summed over the files
+};
+
+// Processes the batch on a pool of worker threads, each worker runs its own
+// NC session and creates it after its placement. Every worker keeps one
+// frame arena for all of its files. The caller is responsible for the Krisp SDK
+// globalInit/globalDestroy calls. If config.frameDurationMs is 0 the frame
+// duration is tuned once on the first input and used for every file.
+std::pair<bool, std::string> ncBatch(
+    const NcBatchConfig &batchConfig,
+    const NcConfig &config,
+    NcBatchResult *result);
+
+#endif
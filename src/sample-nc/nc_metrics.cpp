@@ -0,0 +1,39 @@
+#include "nc_metrics.hpp"
+
+NcMetrics::NcMetrics()
+{
+    frames = registry.addCounter("nc_frames_processed_total", "Frames processed by NC sessions");
+    skippedFrames = registry.addCounter("nc_frames_skipped_total", "Silent frames not passed to NC");
+    sessions = registry.addCounter("nc_sessions_created_total", "NC sessions created");
+    inputBytes = registry.addCounter("nc_input_bytes_total", "Bytes of decoded samples read");
+    outputBytes = registry.addCounter("nc_output_bytes_total", "Bytes of samples written");
+    noNoiseMs = registry.addCounter("nc_no_noise_milliseconds_total", "Audio without noise");
+    lowNoiseMs = registry.addCounter("nc_low_noise_milliseconds_total", "Audio with low noise");
+    mediumNoiseMs = registry.addCounter("nc_medium_noise_milliseconds_total", "Audio with medium noise");
+    highNoiseMs = registry.addCounter("nc_high_noise_milliseconds_total", "Audio with high noise");
+    talkTimeMs = registry.addCounter("nc_talk_time_milliseconds_total", "Audio with voice");
+    activeSessions = registry.addGauge("nc_sessions_active", "NC sessions alive");
+    inputQueueDepth = registry.addGauge("nc_input_queue_depth", "Input blocks waiting for NC in the pipelined mode");
+    outputQueueDepth = registry.addGauge("nc_output_queue_depth", "Output blocks waiting for the writer in the pipelined mode");
+    pendingFiles = registry.addGauge("nc_batch_files_pending", "Batch files not started yet");
+    processLatency = registry.addHistogram("nc_process_seconds", "Duration of a process() call");
+}
+
+static void addDelta(MetricsShard &shard, unsigned counter, uint32_t value, uint32_t &total)
+{
+    if (value > total)
+    {
+        shard.add(counter, value - total);
+        total = value;
+    }
+}
+
+void addNcSessionStats(MetricsShard &shard, const NcMetrics &metrics,
+                       const Krisp::AudioSdk::SessionStats &stats, NcSessionTotals &totals)
+{
+    addDelta(shard, metrics.noNoiseMs, stats.noiseStats.noNoiseMs, totals.noNoiseMs);
+    addDelta(shard, metrics.lowNoiseMs, stats.noiseStats.lowNoiseMs, totals.lowNoiseMs);
+    addDelta(shard, metrics.mediumNoiseMs, stats.noiseStats.mediumNoiseMs, totals.mediumNoiseMs);
+    addDelta(shard, metrics.highNoiseMs, stats.noiseStats.highNoiseMs, totals.highNoiseMs);
+    addDelta(shard, metrics.talkTimeMs, stats.voiceStats.talkTimeMs, totals.talkTimeMs);
+}
@@ -0,0 +1,53 @@
+#ifndef NC_METRICS_HPP
+#define NC_METRICS_HPP
+
+#include <cstdint>
+
+#include <krisp-audio-sdk-nc.hpp>
+
+#include "metrics.hpp"
+
+// The metrics of sample-nc, one registry for the process. Every NC channel
+// records into a shard of its own, the I/O of a file into another one.
+struct NcMetrics
+{
+    MetricsRegistry registry;
+    // Counters
+    unsigned frames;        // process() calls
+    unsigned skippedFrames; // frames the silence fast path did not process
+    unsigned sessions;      // sessions created
+    unsigned inputBytes;    // decoded samples read
+    unsigned outputBytes;   // samples written before encoding
+    // SessionStats totals of all sessions
+    unsigned noNoiseMs;
+    unsigned lowNoiseMs;
+    unsigned mediumNoiseMs;
+    unsigned highNoiseMs;
+    unsigned talkTimeMs;
+    // Gauges
+    unsigned activeSessions;
+    unsigned inputQueueDepth;  // filled input blocks of the pipelined mode
+    unsigned outputQueueDepth; // filled output blocks of the pipelined mode
+    unsigned pendingFiles;     // batch files no worker has taken yet
+    // Histograms
+    unsigned processLatency;
+
+    NcMetrics();
+};
+
+// Totals of SessionStats the metrics have seen, the session reports its
+// totals since it was created
+struct NcSessionTotals
+{
+    uint32_t noNoiseMs;
+    uint32_t lowNoiseMs;
+    uint32_t mediumNoiseMs;
+    uint32_t highNoiseMs;
+    uint32_t talkTimeMs;
+};
+
+// Adds what the session reported since the totals were last updated
+void addNcSessionStats(MetricsShard &shard, const NcMetrics &metrics,
+                       const Krisp::AudioSdk::SessionStats &stats, NcSessionTotals &totals);
+
+#endif
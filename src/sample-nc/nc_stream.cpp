@@ -0,0 +1,279 @@
+#include "nc_stream.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <unistd.h>
+#else
+#include <io.h>
+#define STDIN_FILENO 0
+#define STDOUT_FILENO 1
+#endif
+
+#include <krisp-audio-sdk.hpp>
+#include <krisp-audio-sdk-nc.hpp>
+
+#include "interleave.hpp"
+#include "model_cache.hpp"
+#include "nc_metrics.hpp"
+#include "nc_session_stats.hpp"
+#include "sampling_rate.hpp"
+#include "stats_sink.hpp"
+
+using namespace Krisp::AudioSdk;
+
+// One frame is read, processed and written at a time, the frame duration
+// is the latency the stream adds on top of the SDK. The resampler of the
+// file mode is not used, it would add its own delay to the stream.
+template <typename SamplingFormat>
+static std::pair<bool, std::string> ncStreamTmpl(
+    PcmStreamReader &reader,
+    const PcmStreamFormat &format,
+    const NcStreamConfig &streamConfig,
+    const NcConfig &config,
+    NcStreamStats *streamStats)
+{
+    const unsigned channels = format.channels;
+    auto samplingRateResult = getKrispSamplingRate(format.samplingRate);
+    if (!samplingRateResult.second)
+    {
+        return std::make_pair(false, std::string(
+            "The streaming mode requires a sampling rate supported by the SDK"));
+    }
+    if (channels == 0)
+    {
+        return std::make_pair(false, std::string("The stream has no channels"));
+    }
+
+    SamplingRate inRate = samplingRateResult.first;
+    const SamplingRate outRate = inRate;
+    const FrameDuration frameDurationMillis = static_cast<FrameDuration>(config.frameDurationMs);
+    const size_t frameSize = (format.samplingRate * static_cast<size_t>(frameDurationMillis)) / 1000;
+    const size_t frameBytes = frameSize * channels * sizeof(SamplingFormat);
+    const size_t sampleFrameBytes = channels * sizeof(SamplingFormat);
+    const bool withStats = config.withStats;
+    NcMetrics *metrics = config.metrics;
+    std::shared_ptr<MetricsShard> streamMetrics = metrics ? metrics->registry.acquireShard() : nullptr;
+
+    ModelInfo ncModelInfo = getModelInfo(config.modelCache, config.weight);
+
+    NcSessionConfig ncCfg =
+        {
+            inRate,
+            frameDurationMillis,
+            outRate,
+            &ncModelInfo,
+            // The metrics export the session stats totals
+            withStats || metrics,
+            nullptr // Ringtone model cfg for inbound
+        };
+
+    std::vector<PerFrameStats> frameStats(channels);
+    std::vector<std::shared_ptr<Nc<SamplingFormat>>> ncSessions(channels);
+    for (auto &ncSession : ncSessions)
+    {
+        ncSession = Nc<SamplingFormat>::create(ncCfg);
+    }
+    std::vector<NcSessionTotals> sessionTotals(channels, NcSessionTotals{});
+    if (streamMetrics)
+    {
+        streamMetrics->add(metrics->sessions, channels);
+        streamMetrics->setGauge(metrics->activeSessions, channels);
+    }
+    auto processFrame = [&](unsigned c, const SamplingFormat *in, SamplingFormat *out)
+    {
+        if (!streamMetrics)
+        {
+            ncSessions[c]->process(in, frameSize, out, frameSize,
+                                   config.noiseSuppressionLevel, withStats ? &frameStats[c] : nullptr);
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        ncSessions[c]->process(in, frameSize, out, frameSize,
+                               config.noiseSuppressionLevel, withStats ? &frameStats[c] : nullptr);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        streamMetrics->add(metrics->frames);
+        streamMetrics->observeNs(metrics->processLatency, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    };
+    StatsSink statsSink;
+    if (withStats && !statsSink.open(config.statsPath, static_cast<unsigned>(frameDurationMillis), channels))
+    {
+        return std::make_pair(false, statsSink.getErrorMsg());
+    }
+
+    std::vector<SamplingFormat> frameIn(frameSize * channels);
+    std::vector<SamplingFormat> frameOut(frameSize * channels);
+    std::vector<SamplingFormat> planar(2 * frameSize * channels);
+    std::vector<SamplingFormat *> planarIn(channels);
+    std::vector<SamplingFormat *> planarOut(channels);
+    std::vector<const SamplingFormat *> interleaveIn(channels);
+    for (unsigned c = 0; c < channels; ++c)
+    {
+        planarIn[c] = planar.data() + c * frameSize;
+        planarOut[c] = planar.data() + (channels + c) * frameSize;
+        interleaveIn[c] = planarOut[c];
+    }
+
+    PcmStreamWriter writer;
+    writer.open(STDOUT_FILENO);
+    if (streamConfig.wavHeader && !writer.writeWavHeader(format))
+    {
+        return std::make_pair(false, writer.getErrorMsg());
+    }
+
+    //
+    // End of the SDK initialization
+    // Start of the Stream's frame by frame processing
+    //
+
+    size_t i = 0;
+    size_t nInputFrames = 0;
+    for (;;)
+    {
+        if (!reader.fill(frameBytes))
+        {
+            return std::make_pair(false, reader.getErrorMsg());
+        }
+        // A trailing partial sample frame at the end of the stream is dropped
+        size_t nFrameSamples = std::min(reader.getSize(), frameBytes) / sampleFrameBytes;
+        if (nFrameSamples == 0)
+        {
+            break;
+        }
+        // The bytes are copied out of the read buffer, they are not aligned
+        std::memcpy(frameIn.data(), reader.getData(), nFrameSamples * sampleFrameBytes);
+        reader.consume(nFrameSamples * sampleFrameBytes);
+        if (nFrameSamples < frameSize)
+        {
+            // The last frame of the stream is incomplete, pad it with silence
+            std::fill(frameIn.begin() + static_cast<std::ptrdiff_t>(nFrameSamples * channels),
+                      frameIn.end(), SamplingFormat(0));
+        }
+
+        if (channels == 1)
+        {
+            processFrame(0, frameIn.data(), frameOut.data());
+        }
+        else
+        {
+            deinterleave(frameIn.data(), frameSize, channels, planarIn.data());
+            for (unsigned c = 0; c < channels; ++c)
+            {
+                processFrame(c, planarIn[c], planarOut[c]);
+            }
+            interleave(interleaveIn.data(), frameSize, channels, frameOut.data());
+        }
+        if (!writer.write(frameOut.data(), nFrameSamples * sampleFrameBytes))
+        {
+            return std::make_pair(false, writer.getErrorMsg());
+        }
+        nInputFrames += nFrameSamples;
+        if (streamMetrics)
+        {
+            streamMetrics->add(metrics->inputBytes, nFrameSamples * sampleFrameBytes);
+            streamMetrics->add(metrics->outputBytes, nFrameSamples * sampleFrameBytes);
+            // The session totals once a second at 10 ms frames
+            for (unsigned c = 0; c < channels && i % 100 == 0; ++c)
+            {
+                SessionStats sessionStats;
+                ncSessions[c]->getSessionStats(&sessionStats);
+                addNcSessionStats(*streamMetrics, *metrics, sessionStats, sessionTotals[c]);
+            }
+        }
+
+        if (withStats)
+        {
+            for (unsigned c = 0; c < channels; ++c)
+            {
+                statsSink.recordFrame(static_cast<uint32_t>(i), c,
+                                      frameStats[c].energy.noiseEnergy, frameStats[c].energy.voiceEnergy);
+            }
+            if (i % 100 == 0)
+            {
+                // Get NC session stats in the middle of the processing
+                for (unsigned c = 0; c < channels; ++c)
+                {
+                    recordNcStats(statsSink, i, c, ncSessions[c], false);
+                }
+            }
+        }
+        ++i;
+    }
+    if (!writer.flush())
+    {
+        return std::make_pair(false, writer.getErrorMsg());
+    }
+
+    //
+    // End of the Stream's frame by frame processing
+    //
+
+    for (unsigned c = 0; streamMetrics && c < channels; ++c)
+    {
+        SessionStats sessionStats;
+        ncSessions[c]->getSessionStats(&sessionStats);
+        addNcSessionStats(*streamMetrics, *metrics, sessionStats, sessionTotals[c]);
+    }
+    if (withStats)
+    {
+        for (unsigned c = 0; c < channels; ++c)
+        {
+            recordNcStats(statsSink, i, c, ncSessions[c], true);
+        }
+        if (!statsSink.close())
+        {
+            return std::make_pair(false, statsSink.getErrorMsg());
+        }
+    }
+    if (streamStats)
+    {
+        streamStats->audioSeconds = static_cast<double>(nInputFrames) / format.samplingRate;
+        streamStats->format = format;
+    }
+    return std::make_pair(true, std::string());
+}
+
+std::pair<bool, std::string> ncStream(
+    const NcStreamConfig &streamConfig,
+    const NcConfig &config,
+    NcStreamStats *streamStats)
+{
+#ifndef _WIN32
+    // A closed downstream pipe is reported as a write error instead of
+    // terminating the process
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    PcmStreamReader reader;
+    reader.open(STDIN_FILENO);
+    PcmStreamFormat format = streamConfig.format;
+    bool wavInput = reader.readWavHeader(format);
+    if (!wavInput && !reader.getErrorMsg().empty())
+    {
+        return std::make_pair(false, reader.getErrorMsg());
+    }
+    if (streamStats)
+    {
+        streamStats->wavInput = wavInput;
+    }
+    if (!wavInput && format.samplingRate == 0)
+    {
+        return std::make_pair(false, std::string("The sampling rate of raw input must be given with -r"));
+    }
+
+    if (format.format == SoundFileFormat::PCM16)
+    {
+        return ncStreamTmpl<int16_t>(reader, format, streamConfig, config, streamStats);
+    }
+    if (format.format == SoundFileFormat::FLOAT)
+    {
+        return ncStreamTmpl<float>(reader, format, streamConfig, config, streamStats);
+    }
+    return std::make_pair(false, std::string("The stream format should be PCM16 or FLOAT."));
+}
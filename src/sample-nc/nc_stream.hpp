@@ -0,0 +1,35 @@
+#ifndef NC_STREAM_HPP
+#define NC_STREAM_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "nc_wav_file.hpp"
+#include "pcm_stream.hpp"
+
+struct NcStreamConfig
+{
+    // Format of raw input, ignored when the input starts with a WAV header
+    PcmStreamFormat format;
+    bool wavHeader; // write a WAV header before the processed samples
+};
+
+struct NcStreamStats
+{
+    double audioSeconds;
+    PcmStreamFormat format; // the format of the processed stream
+    bool wavInput;          // the format was taken from a WAV header
+};
+
+// Applies NC to little-endian PCM16 or FLOAT samples read from stdin and
+// writes the processed samples to stdout. Every frame is written as soon
+// as it is processed, so the stream is delayed by one frame plus the delay
+// of the SDK. The caller is responsible for the Krisp SDK
+// globalInit/globalDestroy calls.
+std::pair<bool, std::string> ncStream(
+    const NcStreamConfig &streamConfig,
+    const NcConfig &config,
+    NcStreamStats *streamStats = nullptr);
+
+#endif
@@ -0,0 +1,847 @@
+#include "nc_wav_file.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <krisp-audio-sdk.hpp>
+#include <krisp-audio-sdk-nc.hpp>
+
+#include "frame_arena.hpp"
+#include "frame_duration.hpp"
+#include "frame_level.hpp"
+#include "interleave.hpp"
+#include "model_cache.hpp"
+#include "nc_metrics.hpp"
+#include "nc_session_stats.hpp"
+#include "resampler.hpp"
+#include "sampling_rate.hpp"
+#include "sound_file.hpp"
+#include "stats_sink.hpp"
+#include "thread_control.hpp"
+#include "wav_mmap_reader.hpp"
+#include "worker_group.hpp"
+
+using namespace Krisp::AudioSdk;
+
+// Number of NC frames read, processed and written at once
+constexpr size_t kFramesPerBlock = 100;
+// The fastest of the repeats is kept to filter out scheduling noise
+constexpr unsigned kTuneRepeats = 3;
+// Number of blocks in flight between the stages of the pipelined mode
+constexpr size_t kPipelineDepth = 4;
+// Silent frames after audio that are still processed, so the tail of the
+// audio leaves the session before NC is bypassed
+constexpr unsigned kSilenceSettleMs = 200;
+
+static int64_t readFrames(const SoundFile &sndFile,
+                          int16_t *frames, int64_t nFrames)
+{
+    return sndFile.readFramesPCM16(frames, nFrames);
+}
+
+static int64_t readFrames(const SoundFile &sndFile,
+                          float *frames, int64_t nFrames)
+{
+    return sndFile.readFramesFloat(frames, nFrames);
+}
+
+static void writeFrames(SoundFileWriter &sndFileWriter,
+                        const int16_t *frames, int64_t nFrames)
+{
+    sndFileWriter.writeFramesPCM16(frames, nFrames);
+}
+
+static void writeFrames(SoundFileWriter &sndFileWriter,
+                        const float *frames, int64_t nFrames)
+{
+    sndFileWriter.writeFramesFloat(frames, nFrames);
+}
+
+static const int16_t *getMappedSamples(const WavMmapReader &mapped, int16_t *)
+{
+    return mapped.getSamplesPCM16();
+}
+
+static const float *getMappedSamples(const WavMmapReader &mapped, float *)
+{
+    return mapped.getSamplesFloat();
+}
+
+// Mapped samples that can not be used in place, only 8, 24 and 32 bit PCM
+// read by a float session
+static void readMappedFrames(const WavMmapReader &mapped, int64_t offsetFrames,
+                             int64_t nFrames, float *frames)
+{
+    mapped.readFloat(offsetFrames, nFrames, frames);
+}
+
+static void readMappedFrames(const WavMmapReader &mapped, int64_t offsetFrames,
+                             int64_t nFrames, int16_t *frames)
+{
+    const int16_t *samples = mapped.getSamplesPCM16() + offsetFrames * mapped.getHeader().getNumberOfChannels();
+    std::copy(samples, samples + nFrames * mapped.getHeader().getNumberOfChannels(), frames);
+}
+
+static float getSampleDifference(int16_t a, int16_t b)
+{
+    return static_cast<float>(std::abs(static_cast<int>(a) - static_cast<int>(b))) / 32768.0f;
+}
+
+static float getSampleDifference(float a, float b)
+{
+    return std::fabs(a - b);
+}
+
+// 8 bit output would add audible quantization noise, it is written as PCM16
+static SoundFileFormat getOutputFormat(SoundFileFormat inputFormat)
+{
+    return inputFormat == SoundFileFormat::PCMU8 ? SoundFileFormat::PCM16 : inputFormat;
+}
+
+// Every channel runs its own NC session. The planar buffers are only used
+// for multichannel input, a mono stream is processed from the block itself.
+// The buffers are blocks of the frame arena.
+template <typename SamplingFormat>
+struct NcChannel
+{
+    std::shared_ptr<Nc<SamplingFormat>> session;
+    SamplingFormat *in;
+    SamplingFormat *out;    // in itself when NC runs in place
+    SamplingFormat *padded; // the incomplete last frame of the file
+    std::vector<PerFrameStats> frameStats;
+    // Set when the file rate is not supported by the SDK
+    std::unique_ptr<FrameResampler<SamplingFormat>> resampler;
+    size_t nFrames; // NC frames of the current block
+    size_t nOut;    // output samples of the current block
+    // Silence fast path
+    unsigned skipRun; // consecutive frames the fast path may skip
+    std::shared_ptr<Nc<SamplingFormat>> reference; // full processing for the verification
+    SamplingFormat *referenceOut;
+    NcSilenceStats silence;
+    std::shared_ptr<MetricsShard> metrics; // written by the thread running the channel
+    NcSessionTotals sessionTotals;
+};
+
+// The input is either read through libsndfile into the block buffers or,
+// when inMapped is set, used in place from the memory mapped file. Mapped
+// samples of another format than the session are converted into the blocks.
+// The blocks hold interleaved frames of all channels and come from the
+// arena, which the caller has reset.
+template <typename SamplingFormat>
+static std::pair<bool, std::string> ncWavFileTmpl(
+    const SoundFileHeader &inHeader,
+    const SoundFile *inSndFile,
+    const WavMmapReader *inMapped,
+    const std::string &output,
+    const NcConfig &config,
+    FrameArena &arena,
+    NcFileStats *fileStats)
+{
+    uint32_t samplingRate = inHeader.getSamplingRate();
+    const unsigned channels = inHeader.getNumberOfChannels();
+    if (channels == 0)
+    {
+        return std::make_pair(false, std::string("The sound file has no channels"));
+    }
+    if (samplingRate == 0)
+    {
+        return std::make_pair(false, std::string("Unsupported sample rate"));
+    }
+
+    // Rates the SDK does not support are resampled to the nearest supported
+    // one, and optionally back to the file rate after NC
+    const uint32_t ncSamplingRate = getNearestKrispSamplingRate(samplingRate);
+    const bool resampling = ncSamplingRate != samplingRate;
+    const uint32_t outSamplingRate = resampling && !config.resampleBack ? ncSamplingRate : samplingRate;
+    auto samplingRateResult = getKrispSamplingRate(ncSamplingRate);
+
+    SamplingRate inRate = samplingRateResult.first;
+    const SamplingRate outRate = inRate;
+    const FrameDuration frameDurationMillis = static_cast<FrameDuration>(config.frameDurationMs);
+    size_t inputFrameSize = (ncSamplingRate * static_cast<size_t>(frameDurationMillis)) / 1000;
+    size_t outputFrameSize = inputFrameSize;
+    // Samples of one channel read per block at the file rate
+    const size_t fileFrameSize = (samplingRate * static_cast<size_t>(frameDurationMillis) + 999) / 1000;
+    const size_t blockChannelSamples = kFramesPerBlock * (resampling ? fileFrameSize : inputFrameSize);
+    const bool withStats = config.withStats;
+    NcMetrics *metrics = config.metrics;
+    // The reader and the writer of the pipelined mode write different counters
+    std::shared_ptr<MetricsShard> fileMetrics = metrics ? metrics->registry.acquireShard() : nullptr;
+
+    SoundFileWriter outSndFile;
+    // The pipelined mode writes on a thread of its own already
+    outSndFile.setBackground(!config.pipelined);
+    outSndFile.setFsync(config.fsync);
+    outSndFile.open(output, outSamplingRate, getOutputFormat(inHeader.getFormat()), channels);
+    if (outSndFile.getHasError())
+    {
+        return std::make_pair(false, outSndFile.getErrorMsg());
+    }
+
+    ModelInfo ncModelInfo = getModelInfo(config.modelCache, config.weight);
+
+    NcSessionConfig ncCfg =
+        {
+            inRate,
+            frameDurationMillis,
+            outRate,
+            &ncModelInfo,
+            // The metrics export the session stats totals
+            withStats || metrics,
+            nullptr // Ringtone model cfg for inbound
+        };
+
+    std::vector<NcChannel<SamplingFormat>> ncChannels(channels);
+    size_t maxChannelOut = blockChannelSamples * outputFrameSize / inputFrameSize;
+    // The per-frame stats are written by a background thread, the NC
+    // thread only stores them in preallocated buffers
+    StatsSink statsSink;
+    if (withStats && !statsSink.open(config.statsPath, static_cast<unsigned>(frameDurationMillis), channels))
+    {
+        return std::make_pair(false, statsSink.getErrorMsg());
+    }
+
+    // Mapped samples of the session format are processed from the mapping
+    const SamplingFormat *mappedData = inMapped ? getMappedSamples(*inMapped, static_cast<SamplingFormat *>(nullptr)) : nullptr;
+    // The output overwrites the input unless the rate conversion changes the
+    // length, or the pipeline holds the input and output blocks in flight.
+    // NC itself writes over its input with config.inPlace only, otherwise it
+    // writes into a second buffer of the same size.
+    const bool sameBlock = !resampling && !config.pipelined;
+    const bool ncInPlace = sameBlock && config.inPlace;
+    // Every frame is measured before it goes to NC. Zero frames and frames
+    // below the near-silence level are skipped or muted as configured.
+    const bool silenceFastPath = config.skipSilence || config.nearSilence != NearSilencePolicy::Off;
+    const float nearSilenceMeanSquare =
+        config.nearSilence != NearSilencePolicy::Off ? dbfsToMeanSquare(config.nearSilenceDb) : 0.0f;
+    const unsigned settleFrames = (kSilenceSettleMs + config.frameDurationMs - 1) / config.frameDurationMs;
+
+    for (auto &ncChannel : ncChannels)
+    {
+        ncChannel.session = Nc<SamplingFormat>::create(ncCfg);
+        if (metrics)
+        {
+            ncChannel.metrics = metrics->registry.acquireShard();
+            ncChannel.metrics->add(metrics->sessions);
+            ncChannel.metrics->setGauge(metrics->activeSessions, 1);
+        }
+        size_t maxFrames = kFramesPerBlock;
+        if (resampling)
+        {
+            ncChannel.resampler.reset(new FrameResampler<SamplingFormat>());
+            if (!ncChannel.resampler->init(samplingRate, ncSamplingRate, outSamplingRate,
+                                           inputFrameSize, blockChannelSamples))
+            {
+                return std::make_pair(false, ncChannel.resampler->getErrorMsg());
+            }
+            maxFrames = ncChannel.resampler->getMaxFrames();
+            maxChannelOut = ncChannel.resampler->getMaxOutput();
+        }
+        if (channels > 1)
+        {
+            ncChannel.in = arena.allocate<SamplingFormat>(blockChannelSamples);
+            ncChannel.out = ncInPlace ? ncChannel.in : arena.allocate<SamplingFormat>(maxChannelOut);
+        }
+        ncChannel.padded = arena.allocate<SamplingFormat>(inputFrameSize);
+        ncChannel.frameStats.resize(maxFrames);
+        if (silenceFastPath && config.verifySilence)
+        {
+            ncChannel.reference = Nc<SamplingFormat>::create(ncCfg);
+            ncChannel.referenceOut = arena.allocate<SamplingFormat>(outputFrameSize);
+            if (metrics)
+            {
+                ncChannel.metrics->add(metrics->sessions);
+                ncChannel.metrics->setGauge(metrics->activeSessions, 2);
+            }
+        }
+    }
+
+    // One thread per channel, the first channel runs on the NC thread itself,
+    // which the caller has placed as index 0
+    std::unique_ptr<WorkerGroup> channelWorkers;
+    if (channels > 1 && config.channelThreads)
+    {
+        channelWorkers.reset(new WorkerGroup(channels));
+        if (config.placement)
+        {
+            std::atomic<bool> placed{true};
+            channelWorkers->run([&](unsigned c)
+            {
+                if (c != 0 && !config.placement->apply(c, "nc-channel"))
+                {
+                    placed = false;
+                }
+            });
+            if (!placed)
+            {
+                std::cerr << "Failed to apply the CPU placement of the channel threads" << std::endl;
+            }
+        }
+    }
+
+    //
+    // End of the SDK initialization
+    // Start of the Stream's frame by frame processing
+    //
+
+    const size_t mappedSamples = static_cast<size_t>(inHeader.getNumberOfFrames()) * channels;
+    size_t readPos = 0;
+    size_t processPos = 0;
+    size_t i = 0;
+    size_t nInputFrames = 0;
+
+    auto countRead = [&](size_t nSamples) -> size_t
+    {
+        if (fileMetrics)
+        {
+            fileMetrics->add(metrics->inputBytes, nSamples * sizeof(SamplingFormat));
+        }
+        return nSamples;
+    };
+
+    auto readBlock = [&](SamplingFormat *block, size_t capacity) -> size_t
+    {
+        if (mappedData)
+        {
+            // Nothing to copy, only ask the kernel to read the data ahead
+            size_t nSamples = std::min(capacity, mappedSamples - readPos);
+            inMapped->prefetch(static_cast<int64_t>(readPos / channels),
+                               static_cast<int64_t>(2 * nSamples / channels + 1));
+            readPos += nSamples;
+            return countRead(nSamples);
+        }
+        if (inMapped)
+        {
+            size_t nSamples = std::min(capacity, mappedSamples - readPos);
+            inMapped->prefetch(static_cast<int64_t>(readPos / channels),
+                               static_cast<int64_t>(2 * nSamples / channels + 1));
+            readMappedFrames(*inMapped, static_cast<int64_t>(readPos / channels),
+                             static_cast<int64_t>(nSamples / channels), block);
+            readPos += nSamples;
+            return countRead(nSamples);
+        }
+        int64_t nRead = readFrames(*inSndFile, block, static_cast<int64_t>(capacity / channels));
+        return countRead(nRead > 0 ? static_cast<size_t>(nRead) * channels : 0);
+    };
+
+    std::vector<const SamplingFormat *> channelIn(channels);
+    std::vector<SamplingFormat *> channelOut(channels);
+    std::vector<SamplingFormat *> planarIn(channels);
+    std::vector<const SamplingFormat *> planarOut(channels);
+    for (unsigned c = 0; c < channels && channels > 1; ++c)
+    {
+        planarIn[c] = ncChannels[c].in;
+        channelIn[c] = ncChannels[c].in;
+        channelOut[c] = ncChannels[c].out;
+        planarOut[c] = ncChannels[c].out;
+    }
+    size_t nChannelSamples = 0;
+    // Filled input and output blocks, set while the pipeline runs
+    std::function<std::pair<size_t, size_t>()> queueDepths;
+
+    // The clock is read through the vDSO, the metrics cost no system call
+    auto runSession = [&](NcChannel<SamplingFormat> &ncChannel, const SamplingFormat *frameIn,
+                          SamplingFormat *frameOut, PerFrameStats *perFrameStats)
+    {
+        if (!ncChannel.metrics)
+        {
+            ncChannel.session->process(frameIn, inputFrameSize, frameOut, outputFrameSize,
+                                       config.noiseSuppressionLevel, perFrameStats);
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        ncChannel.session->process(frameIn, inputFrameSize, frameOut, outputFrameSize,
+                                   config.noiseSuppressionLevel, perFrameStats);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        ncChannel.metrics->add(metrics->frames);
+        ncChannel.metrics->observeNs(metrics->processLatency, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    };
+
+    auto processFrame = [&](NcChannel<SamplingFormat> &ncChannel, const SamplingFormat *frameIn,
+                            SamplingFormat *frameOut, PerFrameStats *perFrameStats)
+    {
+        if (!silenceFastPath)
+        {
+            runSession(ncChannel, frameIn, frameOut, perFrameStats);
+            return;
+        }
+        NcSilenceStats &silence = ncChannel.silence;
+        std::chrono::steady_clock::time_point start;
+        if (ncChannel.reference)
+        {
+            // Runs first, NC in place overwrites the input
+            start = std::chrono::steady_clock::now();
+            ncChannel.reference->process(frameIn, inputFrameSize, ncChannel.referenceOut, outputFrameSize,
+                                         config.noiseSuppressionLevel, nullptr);
+            auto end = std::chrono::steady_clock::now();
+            silence.fullSeconds += std::chrono::duration<double>(end - start).count();
+            start = end;
+        }
+
+        const FrameLevel level = measureFrame(frameIn, inputFrameSize);
+        const bool silent = level.peak == 0.0f;
+        const bool nearSilent = level.meanSquare < nearSilenceMeanSquare;
+        const bool skippable = (silent && config.skipSilence) ||
+                               (nearSilent && config.nearSilence == NearSilencePolicy::Skip);
+        ncChannel.skipRun = skippable ? ncChannel.skipRun + 1 : 0;
+        ++silence.frames;
+        if (silent)
+        {
+            ++silence.silentFrames;
+        }
+        else if (nearSilent)
+        {
+            ++silence.nearSilentFrames;
+        }
+        const bool skipped = ncChannel.skipRun > settleFrames;
+        if (skipped)
+        {
+            std::fill(frameOut, frameOut + outputFrameSize, SamplingFormat(0));
+            if (perFrameStats)
+            {
+                *perFrameStats = PerFrameStats{};
+            }
+            ++silence.skippedFrames;
+            if (ncChannel.metrics)
+            {
+                ncChannel.metrics->add(metrics->skippedFrames);
+            }
+        }
+        else
+        {
+            runSession(ncChannel, frameIn, frameOut, perFrameStats);
+            if (nearSilent && config.nearSilence == NearSilencePolicy::Mute)
+            {
+                std::fill(frameOut, frameOut + outputFrameSize, SamplingFormat(0));
+                ++silence.mutedFrames;
+            }
+        }
+
+        if (ncChannel.reference)
+        {
+            silence.fastPathSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            float maxDifference = 0.0f;
+            for (size_t n = 0; n < outputFrameSize; ++n)
+            {
+                maxDifference = std::max(maxDifference, getSampleDifference(frameOut[n], ncChannel.referenceOut[n]));
+            }
+            if (!std::equal(frameOut, frameOut + outputFrameSize, ncChannel.referenceOut))
+            {
+                ++silence.mismatchedFrames;
+                if (skipped)
+                {
+                    ++silence.mismatchedSkippedFrames;
+                }
+            }
+            silence.maxDifference = std::max(silence.maxDifference, maxDifference);
+        }
+    };
+
+    auto processChannel = [&](unsigned c)
+    {
+        NcChannel<SamplingFormat> &ncChannel = ncChannels[c];
+        if (ncChannel.resampler)
+        {
+            ncChannel.nFrames = 0;
+            auto processResampledFrame = [&](const SamplingFormat *frameIn, SamplingFormat *frameOut)
+            {
+                processFrame(ncChannel, frameIn, frameOut,
+                             withStats ? &ncChannel.frameStats[ncChannel.nFrames] : nullptr);
+                ++ncChannel.nFrames;
+            };
+            // No input left, drain the resampler at the end of the file
+            ncChannel.nOut = nChannelSamples != 0
+                                 ? ncChannel.resampler->process(channelIn[c], nChannelSamples, channelOut[c], processResampledFrame)
+                                 : ncChannel.resampler->flush(channelOut[c], processResampledFrame);
+            return;
+        }
+        size_t nFrames = (nChannelSamples + inputFrameSize - 1) / inputFrameSize;
+        ncChannel.nFrames = nFrames;
+        ncChannel.nOut = nChannelSamples * outputFrameSize / inputFrameSize;
+        for (size_t f = 0; f < nFrames; ++f)
+        {
+            const SamplingFormat *frameIn = channelIn[c] + f * inputFrameSize;
+            size_t nFrameSamples = std::min(inputFrameSize, nChannelSamples - f * inputFrameSize);
+            if (nFrameSamples < inputFrameSize)
+            {
+                // The last frame of the file is incomplete, pad it with silence
+                std::copy(frameIn, frameIn + nFrameSamples, ncChannel.padded);
+                std::fill(ncChannel.padded + nFrameSamples, ncChannel.padded + inputFrameSize, SamplingFormat(0));
+                frameIn = ncChannel.padded;
+            }
+
+            processFrame(ncChannel, frameIn, channelOut[c] + f * outputFrameSize,
+                         withStats ? &ncChannel.frameStats[f] : nullptr);
+        }
+    };
+
+    // Returns the number of interleaved output samples. Called with no
+    // input at the end of the file to drain the resamplers.
+    auto processBlock = [&](SamplingFormat *blockIn, SamplingFormat *blockOut, size_t nSamples) -> size_t
+    {
+        if (nSamples == 0 && !resampling)
+        {
+            return 0;
+        }
+        const SamplingFormat *in = mappedData ? mappedData + processPos : blockIn;
+        nChannelSamples = nSamples / channels;
+        nInputFrames += nChannelSamples;
+        if (channels == 1)
+        {
+            channelIn[0] = in;
+            channelOut[0] = blockOut;
+            processChannel(0);
+        }
+        else
+        {
+            deinterleave(in, nChannelSamples, channels, planarIn.data());
+            if (channelWorkers)
+            {
+                channelWorkers->run(processChannel);
+            }
+            else
+            {
+                for (unsigned c = 0; c < channels; ++c)
+                {
+                    processChannel(c);
+                }
+            }
+            // Every channel runs the same rate conversion, so the output
+            // lengths are equal
+            interleave(planarOut.data(), ncChannels[0].nOut, channels, blockOut);
+        }
+
+        if (metrics)
+        {
+            for (auto &ncChannel : ncChannels)
+            {
+                SessionStats sessionStats;
+                ncChannel.session->getSessionStats(&sessionStats);
+                addNcSessionStats(*ncChannel.metrics, *metrics, sessionStats, ncChannel.sessionTotals);
+            }
+            if (queueDepths)
+            {
+                const auto depths = queueDepths();
+                fileMetrics->setGauge(metrics->inputQueueDepth, static_cast<int64_t>(depths.first));
+                fileMetrics->setGauge(metrics->outputQueueDepth, static_cast<int64_t>(depths.second));
+            }
+        }
+
+        size_t nFrames = ncChannels[0].nFrames;
+        for (size_t f = 0; withStats && f < nFrames; ++f, ++i)
+        {
+            for (unsigned c = 0; c < channels; ++c)
+            {
+                const PerFrameStats &perFrameStats = ncChannels[c].frameStats[f];
+                statsSink.recordFrame(static_cast<uint32_t>(i), c,
+                                      perFrameStats.energy.noiseEnergy, perFrameStats.energy.voiceEnergy);
+            }
+
+            if (i % 100 == 0)
+            {
+                // Get NC session stats in the middle of the processing
+                for (unsigned c = 0; c < channels; ++c)
+                {
+                    recordNcStats(statsSink, i, c, ncChannels[c].session, false);
+                }
+            }
+        }
+        if (inMapped && nSamples != 0)
+        {
+            inMapped->release(static_cast<int64_t>(processPos / channels),
+                              static_cast<int64_t>(nChannelSamples));
+            processPos += nSamples;
+        }
+        return ncChannels[0].nOut * channels;
+    };
+
+    auto writeBlock = [&](const SamplingFormat *blockOut, size_t nSamples) -> bool
+    {
+        if (fileMetrics)
+        {
+            fileMetrics->add(metrics->outputBytes, nSamples * sizeof(SamplingFormat));
+        }
+        writeFrames(outSndFile, blockOut, static_cast<int64_t>(nSamples / channels));
+        return !outSndFile.getHasError();
+    };
+
+    // The input is streamed through fixed size blocks of kFramesPerBlock
+    // frames, so the memory footprint does not depend on the file length
+    const size_t blockSize = blockChannelSamples * channels;
+    const size_t outBlockSize = maxChannelOut * channels;
+    if (config.pipelined)
+    {
+        BlockPipeline<SamplingFormat> pipeline(blockSize, kPipelineDepth, outBlockSize,
+                                               [&](size_t n) { return arena.allocate<SamplingFormat>(n); });
+        queueDepths = [&]() { return pipeline.getQueueDepths(); };
+        pipeline.run(readBlock, processBlock, writeBlock);
+        queueDepths = nullptr;
+        if (fileStats)
+        {
+            fileStats->pipeline = pipeline.getStats();
+        }
+    }
+    else
+    {
+        // Mapped input of the session format is not copied into a block.
+        // Mono output goes over the input block only when NC runs in place,
+        // multichannel output always does since the channels are planar by
+        // then.
+        SamplingFormat *blockIn = mappedData ? nullptr : arena.allocate<SamplingFormat>(blockSize);
+        SamplingFormat *blockOut = blockIn && sameBlock && (channels > 1 || ncInPlace)
+                                       ? blockIn
+                                       : arena.allocate<SamplingFormat>(outBlockSize);
+        size_t nSamples;
+        bool written = true;
+        while (written && (nSamples = readBlock(blockIn, blockSize)) > 0)
+        {
+            size_t nOut = processBlock(blockIn, blockOut, nSamples);
+            written = nOut == 0 || writeBlock(blockOut, nOut);
+        }
+        size_t nOut = written ? processBlock(blockIn, blockOut, 0) : 0;
+        if (nOut != 0)
+        {
+            writeBlock(blockOut, nOut);
+        }
+    }
+    if (outSndFile.getHasError())
+    {
+        return std::make_pair(false, outSndFile.getErrorMsg());
+    }
+
+    //
+    // End of the Stream's frame by frame processing
+    //
+
+    if (withStats)
+    {
+        for (unsigned c = 0; c < channels; ++c)
+        {
+            recordNcStats(statsSink, i, c, ncChannels[c].session, true);
+        }
+        if (!statsSink.close())
+        {
+            return std::make_pair(false, statsSink.getErrorMsg());
+        }
+    }
+
+    if (inSndFile && inSndFile->getHasError())
+    {
+        return std::make_pair(false, inSndFile->getErrorMsg());
+    }
+    outSndFile.close();
+    if (outSndFile.getHasError())
+    {
+        return std::make_pair(false, outSndFile.getErrorMsg());
+    }
+    if (fileStats)
+    {
+        fileStats->audioSeconds = static_cast<double>(nInputFrames) / samplingRate;
+        fileStats->mapped = inMapped != nullptr;
+        fileStats->inSamplingRate = samplingRate;
+        fileStats->ncSamplingRate = ncSamplingRate;
+        fileStats->resamplerDelaySeconds = resampling ? ncChannels[0].resampler->getDelaySeconds() : 0.0;
+        fileStats->bufferBytes = arena.getInUse();
+        fileStats->silence = NcSilenceStats{};
+        for (const auto &ncChannel : ncChannels)
+        {
+            addSilenceStats(fileStats->silence, ncChannel.silence);
+        }
+    }
+    return std::make_pair(true, std::string());
+}
+
+template <typename SamplingFormat>
+static std::pair<bool, std::string> ncTuneFrameDurationTmpl(
+    const SoundFile &inSndFile,
+    const NcConfig &config,
+    double sampleSeconds,
+    NcTuneResult *result)
+{
+    const SoundFileHeader &inHeader = inSndFile.getHeader();
+    const unsigned channels = inHeader.getNumberOfChannels();
+    if (channels == 0 || inHeader.getSamplingRate() == 0)
+    {
+        return std::make_pair(false, std::string("Unsupported sound file"));
+    }
+    // The cost does not depend on the content, samples of an unsupported
+    // rate are processed as they are at the nearest supported rate
+    const uint32_t ncSamplingRate = getNearestKrispSamplingRate(inHeader.getSamplingRate());
+    const SamplingRate rate = getKrispSamplingRate(ncSamplingRate).first;
+
+    const size_t nSampleFrames = static_cast<size_t>(sampleSeconds * inHeader.getSamplingRate());
+    std::vector<SamplingFormat> interleaved(nSampleFrames * channels);
+    int64_t nRead = readFrames(inSndFile, interleaved.data(), static_cast<int64_t>(nSampleFrames));
+    std::vector<SamplingFormat> sample(nRead > 0 ? static_cast<size_t>(nRead) : 0);
+    for (size_t n = 0; n < sample.size(); ++n)
+    {
+        sample[n] = interleaved[n * channels];
+    }
+    if (inSndFile.getHasError())
+    {
+        return std::make_pair(false, inSndFile.getErrorMsg());
+    }
+
+    ModelInfo ncModelInfo = getModelInfo(config.modelCache, config.weight);
+
+    result->cases.clear();
+    result->frameDurationMs = 0;
+    result->sampleSeconds = static_cast<double>(sample.size()) / ncSamplingRate;
+    double bestRealTimeFactor = 0.0;
+    for (FrameDuration frameDuration : kFrameDurations)
+    {
+        const size_t frameSize = ncSamplingRate * static_cast<size_t>(frameDuration) / 1000;
+        const size_t nFrames = sample.size() / frameSize;
+        if (nFrames == 0)
+        {
+            continue;
+        }
+        NcSessionConfig ncCfg =
+            {
+                rate,
+                frameDuration,
+                rate,
+                &ncModelInfo,
+                false,
+                nullptr
+            };
+        std::shared_ptr<Nc<SamplingFormat>> ncSession = Nc<SamplingFormat>::create(ncCfg);
+        std::vector<SamplingFormat> frameOut(frameSize);
+        double bestSeconds = 0.0;
+        for (unsigned r = 0; r < kTuneRepeats; ++r)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t f = 0; f < nFrames; ++f)
+            {
+                ncSession->process(&sample[f * frameSize], frameSize, frameOut.data(), frameSize,
+                                   config.noiseSuppressionLevel, nullptr);
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            bestSeconds = r == 0 ? elapsed.count() : std::min(bestSeconds, elapsed.count());
+        }
+        NcTuneCase tuneCase;
+        tuneCase.frameDurationMs = static_cast<unsigned>(frameDuration);
+        tuneCase.realTimeFactor = bestSeconds * ncSamplingRate / static_cast<double>(nFrames * frameSize);
+        tuneCase.frameMs = bestSeconds * 1000.0 / static_cast<double>(nFrames);
+        result->cases.push_back(tuneCase);
+        if (result->frameDurationMs == 0 || tuneCase.realTimeFactor < bestRealTimeFactor)
+        {
+            result->frameDurationMs = tuneCase.frameDurationMs;
+            bestRealTimeFactor = tuneCase.realTimeFactor;
+        }
+    }
+    if (result->frameDurationMs == 0)
+    {
+        return std::make_pair(false, std::string("The input is too short to tune the frame duration"));
+    }
+    return std::make_pair(true, std::string());
+}
+
+void addSilenceStats(NcSilenceStats &sum, const NcSilenceStats &stats)
+{
+    sum.frames += stats.frames;
+    sum.silentFrames += stats.silentFrames;
+    sum.nearSilentFrames += stats.nearSilentFrames;
+    sum.skippedFrames += stats.skippedFrames;
+    sum.mutedFrames += stats.mutedFrames;
+    sum.mismatchedFrames += stats.mismatchedFrames;
+    sum.mismatchedSkippedFrames += stats.mismatchedSkippedFrames;
+    sum.maxDifference = std::max(sum.maxDifference, stats.maxDifference);
+    sum.fastPathSeconds += stats.fastPathSeconds;
+    sum.fullSeconds += stats.fullSeconds;
+}
+
+std::pair<bool, std::string> ncTuneFrameDuration(
+    const std::string &input,
+    const NcConfig &config,
+    NcTuneResult *result,
+    double sampleSeconds)
+{
+    SoundFile inSndFile;
+    inSndFile.loadHeader(input);
+    if (inSndFile.getHasError())
+    {
+        return std::make_pair(false, inSndFile.getErrorMsg());
+    }
+    if (inSndFile.getHeader().getFormat() == SoundFileFormat::PCM16)
+    {
+        return ncTuneFrameDurationTmpl<int16_t>(inSndFile, config, sampleSeconds, result);
+    }
+    return ncTuneFrameDurationTmpl<float>(inSndFile, config, sampleSeconds, result);
+}
+
+std::pair<bool, std::string> ncWavFile(
+    const std::string &input,
+    const std::string &output,
+    const NcConfig &inConfig,
+    NcFileStats *fileStats,
+    FrameArena *arena)
+{
+    NcConfig config = inConfig;
+    // A single file gets an arena of its own
+    std::unique_ptr<FrameArena> fileArena;
+    if (!arena)
+    {
+        fileArena.reset(new FrameArena(config.hugePages));
+        arena = fileArena.get();
+    }
+    arena->reset();
+    if (config.frameDurationMs == 0)
+    {
+        NcTuneResult tuneResult{};
+        auto tuned = ncTuneFrameDuration(input, config, &tuneResult);
+        if (!tuned.first)
+        {
+            return tuned;
+        }
+        config.frameDurationMs = tuneResult.frameDurationMs;
+        if (fileStats)
+        {
+            fileStats->tune = tuneResult;
+        }
+    }
+    if (config.useMmap)
+    {
+        // WAV PCM16 and FLOAT are used in place, other PCM widths are converted
+        // to float from the mapping, anything else falls back to libsndfile
+        WavMmapReader inMapped;
+        if (inMapped.open(input))
+        {
+            const SoundFileHeader &mappedHeader = inMapped.getHeader();
+            if (mappedHeader.getFormat() == SoundFileFormat::PCM16)
+            {
+                return ncWavFileTmpl<int16_t>(mappedHeader, nullptr, &inMapped, output, config, *arena, fileStats);
+            }
+            return ncWavFileTmpl<float>(mappedHeader, nullptr, &inMapped, output, config, *arena, fileStats);
+        }
+    }
+
+    // Decoding runs ahead on a thread of its own, the pipelined mode reads
+    // on its reader thread already
+    SoundFile inSndFile;
+    inSndFile.setBackground(!config.pipelined);
+    inSndFile.loadHeader(input);
+    if (inSndFile.getHasError())
+    {
+        return std::make_pair(false, inSndFile.getErrorMsg());
+    }
+    const SoundFileHeader &sndFileHeader = inSndFile.getHeader();
+    if (sndFileHeader.getFormat() == SoundFileFormat::PCM16)
+    {
+        return ncWavFileTmpl<int16_t>(sndFileHeader, &inSndFile, nullptr, output, config, *arena, fileStats);
+    }
+    // Integer PCM of other widths goes straight into a float session
+    if (sndFileHeader.getFormat() == SoundFileFormat::FLOAT || isIntegerPcm(sndFileHeader.getFormat()))
+    {
+        return ncWavFileTmpl<float>(sndFileHeader, &inSndFile, nullptr, output, config, *arena, fileStats);
+    }
+    return std::make_pair(false, std::string("The sound file format should be PCM or FLOAT in WAV or FLAC, Ogg Vorbis or Ogg Opus."));
+}
@@ -0,0 +1,133 @@
+#ifndef NC_WAV_FILE_HPP
+#define NC_WAV_FILE_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "block_pipeline.hpp"
+
+class FrameArena;
+class ModelCache;
+class ThreadPlacement;
+struct NcMetrics;
+
+// What happens to frames below the near-silence level
+enum class NearSilencePolicy
+{
+    Off,  // no near-silence level, the frames are processed as any other
+    Mute, // processed to keep the session state, the output is zero
+    Skip  // handled like digital silence
+};
+
+struct NcConfig
+{
+    std::string weight;
+    float noiseSuppressionLevel;
+    bool withStats;
+    // Per-frame stats file, binary unless the name ends in .csv,
+    // the stats are printed to stdout when empty
+    std::string statsPath;
+    bool pipelined; // read, process and write on separate threads
+    bool useMmap;   // use WAV PCM16/FLOAT input in place from a memory mapping
+    bool resampleBack; // write resampled input back at the rate of the input file
+    bool fsync;        // flush every output file to the disk before closing it
+    bool inPlace;      // let the SDK write the NC output over its input
+    bool hugePages;    // back the frame buffers with transparent huge pages
+    // One of the SDK frame durations, 0 to pick the fastest one for the
+    // input with ncTuneFrameDuration
+    unsigned frameDurationMs;
+    // Digital silence bypasses NC with zero output once a run of silent
+    // frames is longer than the session needs to settle
+    bool skipSilence;
+    NearSilencePolicy nearSilence;
+    float nearSilenceDb; // RMS level of near-silence frames in dBFS
+    // Runs a second session on every frame and compares its output with
+    // the output of the silence fast path
+    bool verifySilence;
+    NcMetrics *metrics; // null unless the metrics are exported
+    // Shares one mapping of the model file between the sessions, null to
+    // let every session load the model from the path
+    ModelCache *modelCache;
+    // Multichannel input runs one thread per channel, otherwise the
+    // channels are processed one after the other on the NC thread
+    bool channelThreads;
+    // Channel thread c is placed as index c, null to leave them unplaced
+    const ThreadPlacement *placement;
+};
+
+struct NcTuneCase
+{
+    unsigned frameDurationMs;
+    double realTimeFactor; // processing time divided by audio time
+    double frameMs;        // mean processing time of a frame
+};
+
+struct NcTuneResult
+{
+    unsigned frameDurationMs; // the fastest duration, 0 if not tuned
+    double sampleSeconds;     // audio processed per duration
+    std::vector<NcTuneCase> cases;
+};
+
+// Frame counts are summed over the channels
+struct NcSilenceStats
+{
+    uint64_t frames;
+    uint64_t silentFrames;     // exactly zero
+    uint64_t nearSilentFrames;
+    uint64_t skippedFrames;    // NC was not called, the output is zero
+    uint64_t mutedFrames;      // processed, the output is zero
+    // Filled by the verification only
+    uint64_t mismatchedFrames; // output differs from full processing
+    // Skipped frames that differ, the rest comes from the state the session
+    // did not see during the skipped frames
+    uint64_t mismatchedSkippedFrames;
+    float maxDifference;       // largest sample difference, 1 is full scale
+    double fastPathSeconds;    // analysis and NC with the fast path
+    double fullSeconds;        // NC on every frame
+};
+
+struct NcFileStats
+{
+    double audioSeconds;
+    bool mapped; // the input was memory mapped
+    uint32_t inSamplingRate;
+    uint32_t ncSamplingRate; // differs from the input rate if it was resampled
+    double resamplerDelaySeconds; // latency added by the resampling
+    size_t bufferBytes; // frame buffers taken from the arena
+    BlockPipelineStats pipeline; // filled in the pipelined mode only
+    NcTuneResult tune; // filled when the frame duration was tuned
+    NcSilenceStats silence; // filled when the silence fast path is on
+};
+
+void addSilenceStats(NcSilenceStats &sum, const NcSilenceStats &stats);
+
+// Times NC on the first sampleSeconds of the first input channel at every
+// frame duration the SDK supports and picks the lowest real-time factor.
+// Longer frames mean fewer calls for the same audio, which pays off for
+// offline work; live streams should keep the lowest latency setting.
+std::pair<bool, std::string> ncTuneFrameDuration(
+    const std::string &input,
+    const NcConfig &config,
+    NcTuneResult *result,
+    double sampleSeconds = 5.0);
+
+// Applies NC to the input WAV file and writes the result to the output file.
+// The frame duration is tuned on the file first if config.frameDurationMs is 0.
+// The caller is responsible for the Krisp SDK globalInit/globalDestroy calls,
+// the SDK exceptions are propagated to the caller.
+// On success fileStats receives the duration of the processed audio and the
+// pipeline counters.
+// The frame buffers come from the arena, which is reset first, so a worker
+// that passes the same arena for every file reuses the buffers. Without an
+// arena the buffers are allocated for this file only.
+std::pair<bool, std::string> ncWavFile(
+    const std::string &input,
+    const std::string &output,
+    const NcConfig &config,
+    NcFileStats *fileStats = nullptr,
+    FrameArena *arena = nullptr);
+
+#endif
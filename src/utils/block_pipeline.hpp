@@ -0,0 +1,269 @@
+#ifndef BLOCK_PIPELINE_HPP
+#define BLOCK_PIPELINE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "spsc_ring.hpp"
+
+
+struct BlockPipelineStats {
+	uint64_t blocks;
+	// Number of times a stage had to wait for its neighbour
+	uint64_t readerStalls;        // no free input block, processing is behind
+	uint64_t processInputStalls;  // no filled input block, reading is behind
+	uint64_t processOutputStalls; // no free output block, writing is behind
+	uint64_t writerStalls;        // no filled output block, processing is behind
+	// Filled blocks waiting in the queues, sampled on every pop
+	size_t maxInputDepth;
+	size_t maxOutputDepth;
+	double avgInputDepth;
+	double avgOutputDepth;
+};
+
+
+// Runs read, process and write on three threads connected by bounded SPSC
+// rings of preallocated blocks. The read and write stages run on their own
+// threads, the process stage runs on the calling thread.
+//
+// read(T * block, size_t capacity) returns the number of samples read,
+// 0 at the end of the stream.
+// process(T * in, T * out, size_t n) processes n input samples and returns
+// the number of output samples. It is called once more with n == 0 at the
+// end of the stream to return the samples it still holds.
+// write(const T * out, size_t n) returns false to stop the pipeline.
+template <typename T>
+class BlockPipeline {
+private:
+	struct Block {
+		T * samples;
+		size_t capacity;
+		size_t size;
+		bool last;
+	};
+
+	std::vector<T> m_storage; // unless the caller allocates the blocks
+	std::vector<Block> m_inBlocks;
+	std::vector<Block> m_outBlocks;
+	SpscRing<Block *> m_freeIn;
+	SpscRing<Block *> m_filledIn;
+	SpscRing<Block *> m_freeOut;
+	SpscRing<Block *> m_filledOut;
+	std::atomic<bool> m_abort;
+	BlockPipelineStats m_stats;
+
+	// Blocks until the ring yields a value, returns false if aborted
+	bool pop(SpscRing<Block *> & ring, Block *& block, uint64_t & stalls) {
+		if (ring.tryPop(block)) {
+			return true;
+		}
+		++stalls;
+		for (unsigned spin = 0; !m_abort.load(std::memory_order_relaxed); ++spin) {
+			if (ring.tryPop(block)) {
+				return true;
+			}
+			backoff(spin);
+		}
+		return false;
+	}
+
+	// The rings never overflow, every block is owned by exactly one of them
+	// or by one of the stages
+	void push(SpscRing<Block *> & ring, Block * block) {
+		for (unsigned spin = 0; !ring.tryPush(block); ++spin) {
+			backoff(spin);
+		}
+	}
+
+	static void backoff(unsigned spin) {
+		if (spin < 64) {
+			std::this_thread::yield();
+		} else {
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+
+	static void sampleDepth(const SpscRing<Block *> & ring, size_t & maxDepth,
+			double & depthSum) {
+		size_t depth = ring.size();
+		if (depth > maxDepth) {
+			maxDepth = depth;
+		}
+		depthSum += static_cast<double>(depth);
+	}
+
+	template <class Read>
+	void readLoop(Read & read, std::exception_ptr & ex) {
+		try {
+			Block * block = nullptr;
+			while (pop(m_freeIn, block, m_stats.readerStalls)) {
+				block->size = read(block->samples, block->capacity);
+				block->last = block->size == 0;
+				push(m_filledIn, block);
+				if (block->last) {
+					return;
+				}
+			}
+		} catch (...) {
+			ex = std::current_exception();
+			m_abort = true;
+		}
+	}
+
+	template <class Write>
+	void writeLoop(Write & write, std::exception_ptr & ex) {
+		try {
+			Block * block = nullptr;
+			while (pop(m_filledOut, block, m_stats.writerStalls)) {
+				if (block->last) {
+					return;
+				}
+				bool written = block->size == 0 ||
+					write(static_cast<const T *>(block->samples), block->size);
+				push(m_freeOut, block);
+				if (!written) {
+					m_abort = true;
+					return;
+				}
+			}
+		} catch (...) {
+			ex = std::current_exception();
+			m_abort = true;
+		}
+	}
+
+public:
+	using Allocate = std::function<T *(size_t n)>;
+
+	// The output blocks hold outBlockSize samples, by default as many as
+	// the input blocks. allocate provides the memory of every block, the
+	// pipeline owns it when allocate is not set.
+	BlockPipeline(size_t blockSize, size_t depth, size_t outBlockSize = 0,
+			const Allocate & allocate = nullptr) :
+		m_inBlocks(depth),
+		m_outBlocks(depth),
+		m_freeIn(depth),
+		m_filledIn(depth),
+		m_freeOut(depth),
+		m_filledOut(depth),
+		m_abort{false},
+		m_stats{} {
+		outBlockSize = outBlockSize ? outBlockSize : blockSize;
+		if (!allocate) {
+			m_storage.resize(depth * (blockSize + outBlockSize));
+		}
+		T * storage = m_storage.data();
+		auto place = [&](Block & block, size_t size) {
+			if (allocate) {
+				block.samples = allocate(size);
+			} else {
+				block.samples = storage;
+				storage += size;
+			}
+			block.capacity = size;
+		};
+		for (auto & block : m_inBlocks) {
+			place(block, blockSize);
+		}
+		for (auto & block : m_outBlocks) {
+			place(block, outBlockSize);
+		}
+	}
+	BlockPipeline(const BlockPipeline &) = delete;
+	BlockPipeline & operator=(const BlockPipeline &) = delete;
+
+	const BlockPipelineStats & getStats() const {
+		return m_stats;
+	}
+
+	// Filled input and output blocks, approximate while the pipeline runs
+	std::pair<size_t, size_t> getQueueDepths() const {
+		return std::make_pair(m_filledIn.size(), m_filledOut.size());
+	}
+
+	// Returns false if the pipeline was stopped by the write stage.
+	// Exceptions of any stage are rethrown after all threads are joined.
+	template <class Read, class Process, class Write>
+	bool run(Read read, Process process, Write write) {
+		m_abort = false;
+		m_stats = BlockPipelineStats{};
+		for (auto & block : m_inBlocks) {
+			push(m_freeIn, &block);
+		}
+		for (auto & block : m_outBlocks) {
+			push(m_freeOut, &block);
+		}
+
+		std::exception_ptr readEx;
+		std::exception_ptr processEx;
+		std::exception_ptr writeEx;
+		std::thread reader([&]() { readLoop(read, readEx); });
+		std::thread writer([&]() { writeLoop(write, writeEx); });
+
+		double inputDepthSum = 0;
+		double outputDepthSum = 0;
+		try {
+			Block * in = nullptr;
+			Block * out = nullptr;
+			while (pop(m_filledIn, in, m_stats.processInputStalls)) {
+				sampleDepth(m_filledIn, m_stats.maxInputDepth, inputDepthSum);
+				if (!pop(m_freeOut, out, m_stats.processOutputStalls)) {
+					break;
+				}
+				const bool last = in->last;
+				out->size = process(in->samples, out->samples, in->size);
+				out->last = false;
+				if (!last) {
+					++m_stats.blocks;
+				}
+				push(m_freeIn, in);
+				sampleDepth(m_filledOut, m_stats.maxOutputDepth, outputDepthSum);
+				if (last) {
+					// The samples flushed at the end go out ahead of the end marker
+					if (out->size != 0) {
+						push(m_filledOut, out);
+						if (!pop(m_freeOut, out, m_stats.processOutputStalls)) {
+							break;
+						}
+						out->size = 0;
+					}
+					out->last = true;
+					push(m_filledOut, out);
+					break;
+				}
+				push(m_filledOut, out);
+			}
+		} catch (...) {
+			processEx = std::current_exception();
+			m_abort = true;
+		}
+		reader.join();
+		writer.join();
+
+		// Return the blocks to a clean state for the next run
+		Block * block = nullptr;
+		for (auto ring : {&m_freeIn, &m_filledIn, &m_freeOut, &m_filledOut}) {
+			while (ring->tryPop(block)) {
+			}
+		}
+
+		if (m_stats.blocks) {
+			m_stats.avgInputDepth = inputDepthSum / static_cast<double>(m_stats.blocks);
+			m_stats.avgOutputDepth = outputDepthSum / static_cast<double>(m_stats.blocks);
+		}
+		for (auto ex : {processEx, readEx, writeEx}) {
+			if (ex) {
+				std::rethrow_exception(ex);
+			}
+		}
+		return !m_abort;
+	}
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+
+// The first chunk holds the blocks of a mono file at 48 kHz
+static const size_t kMinChunkBytes = 256 * 1024;
+static const size_t kHugePageBytes = 2 * 1024 * 1024;
+
+static size_t roundUp(size_t size, size_t alignment) {
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+FrameArena::FrameArena(bool hugePages) :
+	m_used{0},
+	m_inUse{0},
+	m_highWater{0},
+	m_nChunks{0},
+	m_hugePages{hugePages} {
+}
+
+FrameArena::~FrameArena() {
+	for (const auto & chunk : m_chunks) {
+		freeChunk(chunk);
+	}
+}
+
+FrameArena::Chunk FrameArena::allocateChunk(size_t size) {
+	++m_nChunks;
+#ifdef __linux__
+	if (m_hugePages) {
+		// Huge pages need a 2 MiB aligned range, the slack around it is unmapped
+		size = roundUp(size, kHugePageBytes);
+		void * map = mmap(nullptr, size + kHugePageBytes, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (map != MAP_FAILED) {
+			uint8_t * base = static_cast<uint8_t *>(map);
+			uint8_t * data = reinterpret_cast<uint8_t *>(
+				roundUp(reinterpret_cast<uintptr_t>(base), kHugePageBytes));
+			if (data != base) {
+				munmap(base, static_cast<size_t>(data - base));
+			}
+			munmap(data + size, kHugePageBytes - static_cast<size_t>(data - base));
+			madvise(data, size, MADV_HUGEPAGE);
+			return Chunk{data, size, true};
+		}
+	}
+#endif
+	uint8_t * data = static_cast<uint8_t *>(::operator new(size, std::align_val_t(kAlignment)));
+	return Chunk{data, size, false};
+}
+
+void FrameArena::freeChunk(const Chunk & chunk) {
+#ifdef __linux__
+	if (chunk.mapped) {
+		munmap(chunk.data, chunk.size);
+		return;
+	}
+#endif
+	::operator delete(chunk.data, std::align_val_t(kAlignment));
+}
+
+void * FrameArena::allocateBytes(size_t bytes) {
+	bytes = roundUp(std::max<size_t>(bytes, 1), kAlignment);
+	if (m_chunks.empty() || m_chunks.back().size - m_used < bytes) {
+		const size_t capacity = getCapacity();
+		m_chunks.push_back(allocateChunk(std::max({bytes, capacity, kMinChunkBytes})));
+		m_used = 0;
+	}
+	void * block = m_chunks.back().data + m_used;
+	m_used += bytes;
+	m_inUse += bytes;
+	m_highWater = std::max(m_highWater, m_inUse);
+	return block;
+}
+
+void FrameArena::reset() {
+	if (m_chunks.size() > 1) {
+		const size_t capacity = getCapacity();
+		for (const auto & chunk : m_chunks) {
+			freeChunk(chunk);
+		}
+		m_chunks.clear();
+		m_chunks.push_back(allocateChunk(capacity));
+	}
+	m_used = 0;
+	m_inUse = 0;
+}
+
+size_t FrameArena::getCapacity() const {
+	size_t capacity = 0;
+	for (const auto & chunk : m_chunks) {
+		capacity += chunk.size;
+	}
+	return capacity;
+}
+
+size_t FrameArena::getInUse() const {
+	return m_inUse;
+}
+
+size_t FrameArena::getHighWater() const {
+	return m_highWater;
+}
+
+uint64_t FrameArena::getChunkAllocations() const {
+	return m_nChunks;
+}
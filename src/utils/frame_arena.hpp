@@ -0,0 +1,61 @@
+#ifndef FRAME_ARENA_HPP
+#define FRAME_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Bump allocator of 64-byte aligned sample blocks for one worker. The
+// blocks of a file are released together by reset() and the memory is kept
+// for the next file, so after the first file of a batch the arena holds one
+// chunk as large as the largest file needs and allocates nothing more.
+// The blocks are not cleared, they hold whatever the previous file left.
+// Not thread-safe, every worker owns its arena.
+class FrameArena {
+public:
+	static constexpr size_t kAlignment = 64;
+
+private:
+	struct Chunk {
+		uint8_t * data;
+		size_t size;
+		bool mapped; // mmap'ed for transparent huge pages
+	};
+
+	std::vector<Chunk> m_chunks;
+	size_t m_used;      // bytes in use in the last chunk
+	size_t m_inUse;     // bytes in use in all chunks
+	size_t m_highWater;
+	uint64_t m_nChunks; // chunks allocated over the lifetime of the arena
+	bool m_hugePages;
+
+	Chunk allocateChunk(size_t size);
+	void freeChunk(const Chunk & chunk);
+
+public:
+	// With hugePages the chunks are 2 MiB aligned anonymous mappings
+	// advised for transparent huge pages, on Linux only
+	explicit FrameArena(bool hugePages = false);
+	~FrameArena();
+	FrameArena(const FrameArena &) = delete;
+	FrameArena & operator=(const FrameArena &) = delete;
+
+	void * allocateBytes(size_t bytes);
+
+	template <typename T>
+	T * allocate(size_t n) {
+		return static_cast<T *>(allocateBytes(n * sizeof(T)));
+	}
+
+	// Releases every block. Chunks added since the last reset are merged
+	// into one, so the next file bumps through a single chunk.
+	void reset();
+
+	size_t getCapacity() const;
+	size_t getInUse() const;
+	size_t getHighWater() const;
+	uint64_t getChunkAllocations() const;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef FRAME_DURATION_HPP
+#define FRAME_DURATION_HPP
+
+#include <string>
+
+#include <krisp-audio-sdk.hpp>
+
+
+// Every frame duration the SDK supports, the first one has the lowest
+// latency and is the default of the samples
+static const Krisp::AudioSdk::FrameDuration kFrameDurations[] = {
+	Krisp::AudioSdk::FrameDuration::Fd10ms,
+	Krisp::AudioSdk::FrameDuration::Fd15ms,
+	Krisp::AudioSdk::FrameDuration::Fd20ms,
+	Krisp::AudioSdk::FrameDuration::Fd30ms,
+	Krisp::AudioSdk::FrameDuration::Fd32ms
+};
+
+// Accepts the duration in milliseconds, "10" ... "32"
+inline bool parseFrameDuration(const std::string & value, unsigned & frameDurationMs) {
+	for (auto frameDuration : kFrameDurations) {
+		if (value == std::to_string(static_cast<unsigned>(frameDuration))) {
+			frameDurationMs = static_cast<unsigned>(frameDuration);
+			return true;
+		}
+	}
+	return false;
+}
+
+inline std::string getFrameDurationNames() {
+	std::string names;
+	for (auto frameDuration : kFrameDurations) {
+		names += (names.empty() ? "" : "|") + std::to_string(static_cast<unsigned>(frameDuration));
+	}
+	return names;
+}
+
+#endif
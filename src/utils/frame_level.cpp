@@ -0,0 +1,110 @@
+#include "frame_level.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRAME_LEVEL_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FRAME_LEVEL_NEON 1
+#endif
+
+
+static constexpr float kScale16 = 1.0f / 32768.0f;
+
+FrameLevel measureFrame(const int16_t * samples, size_t n) {
+	size_t i = 0;
+	// The sum of squares is exact, the peak saturates at 32767 in every path
+	int peak = 0;
+	uint64_t sumSquares = 0;
+#if defined(FRAME_LEVEL_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i peaks = zero;
+	__m128i sums = zero;
+	for (; i + 8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i));
+		peaks = _mm_max_epi16(peaks, _mm_max_epi16(x, _mm_subs_epi16(zero, x)));
+		// The pair sums reach 2^31 for two -32768 samples, they are widened
+		// as unsigned
+		__m128i squares = _mm_madd_epi16(x, x);
+		sums = _mm_add_epi64(sums, _mm_unpacklo_epi32(squares, zero));
+		sums = _mm_add_epi64(sums, _mm_unpackhi_epi32(squares, zero));
+	}
+	alignas(16) int16_t peakLanes[8];
+	alignas(16) uint64_t sumLanes[2];
+	_mm_store_si128(reinterpret_cast<__m128i *>(peakLanes), peaks);
+	_mm_store_si128(reinterpret_cast<__m128i *>(sumLanes), sums);
+	for (int16_t lane : peakLanes) {
+		peak = std::max<int>(peak, lane);
+	}
+	sumSquares = sumLanes[0] + sumLanes[1];
+#elif defined(FRAME_LEVEL_NEON)
+	int16x8_t peaks = vdupq_n_s16(0);
+	int64x2_t sums = vdupq_n_s64(0);
+	for (; i + 8 <= n; i += 8) {
+		int16x8_t x = vld1q_s16(samples + i);
+		peaks = vmaxq_s16(peaks, vqabsq_s16(x));
+		sums = vpadalq_s32(sums, vmull_s16(vget_low_s16(x), vget_low_s16(x)));
+		sums = vpadalq_s32(sums, vmull_s16(vget_high_s16(x), vget_high_s16(x)));
+	}
+	peak = vmaxvq_s16(peaks);
+	sumSquares = static_cast<uint64_t>(vgetq_lane_s64(sums, 0) + vgetq_lane_s64(sums, 1));
+#endif
+	for (; i < n; ++i) {
+		const int x = samples[i];
+		peak = std::max(peak, std::min(std::abs(x), 32767));
+		sumSquares += static_cast<uint64_t>(x * x);
+	}
+	FrameLevel level;
+	level.peak = static_cast<float>(peak) * kScale16;
+	level.meanSquare = n != 0 ? static_cast<float>(static_cast<double>(sumSquares) /
+		(static_cast<double>(n) * 32768.0 * 32768.0)) : 0.0f;
+	return level;
+}
+
+FrameLevel measureFrame(const float * samples, size_t n) {
+	size_t i = 0;
+	float peak = 0.0f;
+	float sumSquares = 0.0f;
+#if defined(FRAME_LEVEL_SSE2)
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 peaks = _mm_setzero_ps();
+	__m128 sums = _mm_setzero_ps();
+	for (; i + 4 <= n; i += 4) {
+		__m128 x = _mm_loadu_ps(samples + i);
+		peaks = _mm_max_ps(peaks, _mm_andnot_ps(signMask, x));
+		sums = _mm_add_ps(sums, _mm_mul_ps(x, x));
+	}
+	alignas(16) float peakLanes[4];
+	alignas(16) float sumLanes[4];
+	_mm_store_ps(peakLanes, peaks);
+	_mm_store_ps(sumLanes, sums);
+	peak = std::max(std::max(peakLanes[0], peakLanes[1]), std::max(peakLanes[2], peakLanes[3]));
+	sumSquares = (sumLanes[0] + sumLanes[1]) + (sumLanes[2] + sumLanes[3]);
+#elif defined(FRAME_LEVEL_NEON)
+	float32x4_t peaks = vdupq_n_f32(0.0f);
+	float32x4_t sums = vdupq_n_f32(0.0f);
+	for (; i + 4 <= n; i += 4) {
+		float32x4_t x = vld1q_f32(samples + i);
+		peaks = vmaxq_f32(peaks, vabsq_f32(x));
+		sums = vmlaq_f32(sums, x, x);
+	}
+	peak = vmaxvq_f32(peaks);
+	sumSquares = vaddvq_f32(sums);
+#endif
+	for (; i < n; ++i) {
+		peak = std::max(peak, std::fabs(samples[i]));
+		sumSquares += samples[i] * samples[i];
+	}
+	FrameLevel level;
+	level.peak = peak;
+	level.meanSquare = n != 0 ? sumSquares / static_cast<float>(n) : 0.0f;
+	return level;
+}
+
+float dbfsToMeanSquare(float dbfs) {
+	return std::pow(10.0f, dbfs / 10.0f);
+}
@@ -0,0 +1,23 @@
+#ifndef FRAME_LEVEL_HPP
+#define FRAME_LEVEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Peak and mean square of a frame relative to full scale, a full scale
+// sample of either format is 1. The loops run SSE2 or NEON kernels and
+// finish the tail with the scalar loop. The float mean square is summed in
+// four lanes, so it may differ from a sequential sum in the last bits.
+struct FrameLevel {
+	float peak;
+	float meanSquare;
+};
+
+FrameLevel measureFrame(const int16_t * samples, size_t n);
+FrameLevel measureFrame(const float * samples, size_t n);
+
+// Mean square of a level given in dB relative to full scale
+float dbfsToMeanSquare(float dbfs);
+
+#endif
@@ -0,0 +1,179 @@
+#include "interleave.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define INTERLEAVE_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define INTERLEAVE_NEON 1
+#endif
+
+
+template <typename T>
+static void deinterleaveScalar(const T * in, size_t begin, size_t nFrames,
+		unsigned channels, T * const * out) {
+	for (size_t i = begin; i < nFrames; ++i) {
+		for (unsigned c = 0; c < channels; ++c) {
+			out[c][i] = in[i * channels + c];
+		}
+	}
+}
+
+template <typename T>
+static void interleaveScalar(const T * const * in, size_t begin, size_t nFrames,
+		unsigned channels, T * out) {
+	for (size_t i = begin; i < nFrames; ++i) {
+		for (unsigned c = 0; c < channels; ++c) {
+			out[i * channels + c] = in[c][i];
+		}
+	}
+}
+
+// Returns the number of frames done by the vector kernel
+static size_t deinterleaveStereo(const int16_t * in, size_t nFrames,
+		int16_t * left, int16_t * right) {
+	size_t i = 0;
+#if defined(INTERLEAVE_SSE2)
+	for (; i + 8 <= nFrames; i += 8) {
+		// Every 32 bit lane holds one L/R pair, split and sign extend the
+		// halves then pack the two registers back to 16 bit
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 2 * i));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 2 * i + 8));
+		__m128i la = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+		__m128i lb = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+		__m128i ra = _mm_srai_epi32(a, 16);
+		__m128i rb = _mm_srai_epi32(b, 16);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(left + i), _mm_packs_epi32(la, lb));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(right + i), _mm_packs_epi32(ra, rb));
+	}
+#elif defined(INTERLEAVE_NEON)
+	for (; i + 8 <= nFrames; i += 8) {
+		int16x8x2_t lr = vld2q_s16(in + 2 * i);
+		vst1q_s16(left + i, lr.val[0]);
+		vst1q_s16(right + i, lr.val[1]);
+	}
+#else
+	(void)in;
+	(void)left;
+	(void)right;
+	(void)nFrames;
+#endif
+	return i;
+}
+
+static size_t deinterleaveStereo(const float * in, size_t nFrames,
+		float * left, float * right) {
+	size_t i = 0;
+#if defined(INTERLEAVE_SSE2)
+	for (; i + 4 <= nFrames; i += 4) {
+		__m128 a = _mm_loadu_ps(in + 2 * i);
+		__m128 b = _mm_loadu_ps(in + 2 * i + 4);
+		_mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+#elif defined(INTERLEAVE_NEON)
+	for (; i + 4 <= nFrames; i += 4) {
+		float32x4x2_t lr = vld2q_f32(in + 2 * i);
+		vst1q_f32(left + i, lr.val[0]);
+		vst1q_f32(right + i, lr.val[1]);
+	}
+#else
+	(void)in;
+	(void)left;
+	(void)right;
+	(void)nFrames;
+#endif
+	return i;
+}
+
+static size_t interleaveStereo(const int16_t * left, const int16_t * right,
+		size_t nFrames, int16_t * out) {
+	size_t i = 0;
+#if defined(INTERLEAVE_SSE2)
+	for (; i + 8 <= nFrames; i += 8) {
+		__m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(left + i));
+		__m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(right + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i), _mm_unpacklo_epi16(l, r));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * i + 8), _mm_unpackhi_epi16(l, r));
+	}
+#elif defined(INTERLEAVE_NEON)
+	for (; i + 8 <= nFrames; i += 8) {
+		int16x8x2_t lr;
+		lr.val[0] = vld1q_s16(left + i);
+		lr.val[1] = vld1q_s16(right + i);
+		vst2q_s16(out + 2 * i, lr);
+	}
+#else
+	(void)left;
+	(void)right;
+	(void)out;
+	(void)nFrames;
+#endif
+	return i;
+}
+
+static size_t interleaveStereo(const float * left, const float * right,
+		size_t nFrames, float * out) {
+	size_t i = 0;
+#if defined(INTERLEAVE_SSE2)
+	for (; i + 4 <= nFrames; i += 4) {
+		__m128 l = _mm_loadu_ps(left + i);
+		__m128 r = _mm_loadu_ps(right + i);
+		_mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(l, r));
+		_mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(l, r));
+	}
+#elif defined(INTERLEAVE_NEON)
+	for (; i + 4 <= nFrames; i += 4) {
+		float32x4x2_t lr;
+		lr.val[0] = vld1q_f32(left + i);
+		lr.val[1] = vld1q_f32(right + i);
+		vst2q_f32(out + 2 * i, lr);
+	}
+#else
+	(void)left;
+	(void)right;
+	(void)out;
+	(void)nFrames;
+#endif
+	return i;
+}
+
+template <typename T>
+static void deinterleaveTmpl(const T * in, size_t nFrames, unsigned channels,
+		T * const * out) {
+	size_t done = 0;
+	if (channels == 2) {
+		done = deinterleaveStereo(in, nFrames, out[0], out[1]);
+	}
+	deinterleaveScalar(in, done, nFrames, channels, out);
+}
+
+template <typename T>
+static void interleaveTmpl(const T * const * in, size_t nFrames,
+		unsigned channels, T * out) {
+	size_t done = 0;
+	if (channels == 2) {
+		done = interleaveStereo(in[0], in[1], nFrames, out);
+	}
+	interleaveScalar(in, done, nFrames, channels, out);
+}
+
+void deinterleave(const int16_t * in, size_t nFrames, unsigned channels,
+		int16_t * const * out) {
+	deinterleaveTmpl(in, nFrames, channels, out);
+}
+
+void deinterleave(const float * in, size_t nFrames, unsigned channels,
+		float * const * out) {
+	deinterleaveTmpl(in, nFrames, channels, out);
+}
+
+void interleave(const int16_t * const * in, size_t nFrames, unsigned channels,
+		int16_t * out) {
+	interleaveTmpl(in, nFrames, channels, out);
+}
+
+void interleave(const float * const * in, size_t nFrames, unsigned channels,
+		float * out) {
+	interleaveTmpl(in, nFrames, channels, out);
+}
@@ -0,0 +1,22 @@
+#ifndef INTERLEAVE_HPP
+#define INTERLEAVE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Conversion between interleaved multichannel frames and one planar buffer
+// per channel. Stereo runs a SSE2/NEON kernel where available, other channel
+// counts use the scalar loop.
+
+void deinterleave(const int16_t * in, size_t nFrames, unsigned channels,
+	int16_t * const * out);
+void deinterleave(const float * in, size_t nFrames, unsigned channels,
+	float * const * out);
+
+void interleave(const int16_t * const * in, size_t nFrames, unsigned channels,
+	int16_t * out);
+void interleave(const float * const * in, size_t nFrames, unsigned channels,
+	float * out);
+
+#endif
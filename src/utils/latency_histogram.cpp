@@ -0,0 +1,127 @@
+#include "latency_histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+LatencyHistogram::LatencyHistogram() :
+	m_buckets((kOctaves + 1) * kSubBuckets, 0),
+	m_count{0},
+	m_sumNs{0},
+	m_minNs{std::numeric_limits<uint64_t>::max()},
+	m_maxNs{0} {
+}
+
+// Values below kSubBuckets map 1:1 to the first buckets, every following
+// octave [2^k, 2^(k+1)) is split into kSubBuckets equal buckets
+size_t LatencyHistogram::bucketIndex(uint64_t ns) {
+	if (ns < kSubBuckets) {
+		return static_cast<size_t>(ns);
+	}
+	unsigned msb = 63;
+	while (!(ns >> msb)) {
+		--msb;
+	}
+	unsigned octave = msb - kSubBucketBits + 1;
+	size_t sub = static_cast<size_t>((ns >> (msb - kSubBucketBits)) & (kSubBuckets - 1));
+	return octave * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucketLow(size_t index) {
+	size_t octave = index / kSubBuckets;
+	uint64_t sub = index % kSubBuckets;
+	if (octave == 0) {
+		return sub;
+	}
+	unsigned shift = static_cast<unsigned>(octave - 1);
+	return (uint64_t{kSubBuckets} + sub) << shift;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+	++m_buckets[bucketIndex(ns)];
+	++m_count;
+	m_sumNs += ns;
+	m_minNs = std::min(m_minNs, ns);
+	m_maxNs = std::max(m_maxNs, ns);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram & other) {
+	for (size_t i = 0; i < m_buckets.size(); ++i) {
+		m_buckets[i] += other.m_buckets[i];
+	}
+	m_count += other.m_count;
+	m_sumNs += other.m_sumNs;
+	m_minNs = std::min(m_minNs, other.m_minNs);
+	m_maxNs = std::max(m_maxNs, other.m_maxNs);
+}
+
+void LatencyHistogram::reset() {
+	std::fill(m_buckets.begin(), m_buckets.end(), 0);
+	m_count = 0;
+	m_sumNs = 0;
+	m_minNs = std::numeric_limits<uint64_t>::max();
+	m_maxNs = 0;
+}
+
+uint64_t LatencyHistogram::getCount() const {
+	return m_count;
+}
+
+uint64_t LatencyHistogram::getMinNs() const {
+	return m_count ? m_minNs : 0;
+}
+
+uint64_t LatencyHistogram::getMaxNs() const {
+	return m_maxNs;
+}
+
+double LatencyHistogram::getMeanNs() const {
+	return m_count ? static_cast<double>(m_sumNs) / static_cast<double>(m_count) : 0.0;
+}
+
+uint64_t LatencyHistogram::getPercentileNs(double p) const {
+	if (m_count == 0) {
+		return 0;
+	}
+	uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * static_cast<double>(m_count)));
+	rank = std::max<uint64_t>(1, std::min(rank, m_count));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < m_buckets.size(); ++i) {
+		seen += m_buckets[i];
+		if (seen >= rank) {
+			uint64_t high = i + 1 < m_buckets.size() ? bucketLow(i + 1) - 1 : m_maxNs;
+			return std::min(high, m_maxNs);
+		}
+	}
+	return m_maxNs;
+}
+
+std::vector<LatencyHistogram::Range> LatencyHistogram::getOctaves() const {
+	// Range 0 is [0, 1), range k > 0 is [2^(k-1), 2^k)
+	std::vector<Range> octaves(65);
+	for (size_t k = 0; k < octaves.size(); ++k) {
+		octaves[k].lowNs = k ? uint64_t{1} << (k - 1) : 0;
+		octaves[k].highNs = k ? (k < 64 ? uint64_t{1} << k : std::numeric_limits<uint64_t>::max()) : 1;
+		octaves[k].count = 0;
+	}
+	for (size_t i = 0; i < m_buckets.size(); ++i) {
+		if (m_buckets[i] == 0) {
+			continue;
+		}
+		uint64_t low = bucketLow(i);
+		size_t k = 0;
+		while (low >> k) {
+			++k;
+		}
+		octaves[k].count += m_buckets[i];
+	}
+	auto first = std::find_if(octaves.begin(), octaves.end(),
+		[](const Range & r) { return r.count != 0; });
+	auto last = std::find_if(octaves.rbegin(), octaves.rend(),
+		[](const Range & r) { return r.count != 0; }).base();
+	if (first >= last) {
+		return std::vector<Range>();
+	}
+	return std::vector<Range>(first, last);
+}
@@ -0,0 +1,51 @@
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Log-linear histogram of nanosecond latencies. Every power of two range is
+// split into kSubBuckets linear buckets, so percentiles are reported with
+// a relative error below 1 / kSubBuckets.
+class LatencyHistogram {
+public:
+	static constexpr unsigned kSubBucketBits = 4;
+	static constexpr unsigned kSubBuckets = 1u << kSubBucketBits;
+	static constexpr unsigned kOctaves = 64 - kSubBucketBits;
+
+	struct Range {
+		uint64_t lowNs;
+		uint64_t highNs;
+		uint64_t count;
+	};
+
+private:
+	std::vector<uint64_t> m_buckets;
+	uint64_t m_count;
+	uint64_t m_sumNs;
+	uint64_t m_minNs;
+	uint64_t m_maxNs;
+
+	static size_t bucketIndex(uint64_t ns);
+	static uint64_t bucketLow(size_t index);
+
+public:
+	LatencyHistogram();
+
+	void record(uint64_t ns);
+	void merge(const LatencyHistogram & other);
+	void reset();
+
+	uint64_t getCount() const;
+	uint64_t getMinNs() const;
+	uint64_t getMaxNs() const;
+	double getMeanNs() const;
+	// p in [0, 100], the upper bound of the bucket holding the percentile
+	uint64_t getPercentileNs(double p) const;
+	// Counts merged per power of two, empty ranges at both ends are skipped
+	std::vector<Range> getOctaves() const;
+};
+
+#endif
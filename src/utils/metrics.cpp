@@ -0,0 +1,306 @@
+#include "metrics.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+
+// How often the HTTP thread checks for stop() while it waits for clients
+static const int kPollMs = 200;
+static const size_t kMaxRequestBytes = 8192;
+
+#ifdef MSG_NOSIGNAL
+static const int kSendFlags = MSG_NOSIGNAL;
+#else
+// macOS has SO_NOSIGPIPE on the socket instead
+static const int kSendFlags = 0;
+#endif
+
+MetricsShard::MetricsShard(size_t nCounters, size_t nGauges, size_t nHistograms) :
+	m_counters(new std::atomic<uint64_t>[nCounters]()),
+	m_gauges(new std::atomic<int64_t>[nGauges]()),
+	m_histograms(new std::atomic<uint64_t>[nHistograms * (kBuckets + 2)]()),
+	m_nGauges{nGauges} {
+}
+
+unsigned MetricsRegistry::addCounter(const std::string & name, const std::string & help) {
+	m_counters.push_back(Metric{name, help});
+	return static_cast<unsigned>(m_counters.size() - 1);
+}
+
+unsigned MetricsRegistry::addGauge(const std::string & name, const std::string & help) {
+	m_gauges.push_back(Metric{name, help});
+	return static_cast<unsigned>(m_gauges.size() - 1);
+}
+
+unsigned MetricsRegistry::addHistogram(const std::string & name, const std::string & help) {
+	m_histograms.push_back(Metric{name, help});
+	return static_cast<unsigned>(m_histograms.size() - 1);
+}
+
+std::shared_ptr<MetricsShard> MetricsRegistry::acquireShard() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	MetricsShard * shard;
+	if (!m_free.empty()) {
+		shard = m_free.back();
+		m_free.pop_back();
+	} else {
+		m_shards.emplace_back(new MetricsShard(m_counters.size(), m_gauges.size(), m_histograms.size()));
+		shard = m_shards.back().get();
+	}
+	return std::shared_ptr<MetricsShard>(shard, [this](MetricsShard * released) { release(released); });
+}
+
+void MetricsRegistry::release(MetricsShard * shard) {
+	for (size_t g = 0; g < shard->m_nGauges; ++g) {
+		shard->m_gauges[g].store(0, std::memory_order_relaxed);
+	}
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_free.push_back(shard);
+}
+
+static void writeHeader(std::ostringstream & out, const std::string & name,
+		const std::string & help, const char * type) {
+	out << "# HELP " << name << " " << help << "\n";
+	out << "# TYPE " << name << " " << type << "\n";
+}
+
+std::string MetricsRegistry::render() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::ostringstream out;
+	// The bucket bounds are powers of two in ns, printed exactly
+	out.precision(12);
+	for (size_t c = 0; c < m_counters.size(); ++c) {
+		uint64_t sum = 0;
+		for (const auto & shard : m_shards) {
+			sum += shard->m_counters[c].load(std::memory_order_relaxed);
+		}
+		writeHeader(out, m_counters[c].name, m_counters[c].help, "counter");
+		out << m_counters[c].name << " " << sum << "\n";
+	}
+	for (size_t g = 0; g < m_gauges.size(); ++g) {
+		int64_t sum = 0;
+		for (const auto & shard : m_shards) {
+			sum += shard->m_gauges[g].load(std::memory_order_relaxed);
+		}
+		writeHeader(out, m_gauges[g].name, m_gauges[g].help, "gauge");
+		out << m_gauges[g].name << " " << sum << "\n";
+	}
+	for (size_t h = 0; h < m_histograms.size(); ++h) {
+		uint64_t buckets[MetricsShard::kBuckets + 2] = {};
+		for (const auto & shard : m_shards) {
+			const std::atomic<uint64_t> * values = &shard->m_histograms[h * (MetricsShard::kBuckets + 2)];
+			for (unsigned b = 0; b < MetricsShard::kBuckets + 2; ++b) {
+				buckets[b] += values[b].load(std::memory_order_relaxed);
+			}
+		}
+		const std::string & name = m_histograms[h].name;
+		writeHeader(out, name, m_histograms[h].help, "histogram");
+		// The buckets are exported cumulative
+		uint64_t count = 0;
+		for (unsigned b = 0; b < MetricsShard::kBuckets; ++b) {
+			count += buckets[b];
+			const double le = static_cast<double>(uint64_t{1} << (b + MetricsShard::kMinBucketBits)) * 1e-9;
+			out << name << "_bucket{le=\"" << le << "\"} " << count << "\n";
+		}
+		count += buckets[MetricsShard::kBuckets];
+		out << name << "_bucket{le=\"+Inf\"} " << count << "\n";
+		out << name << "_sum " << static_cast<double>(buckets[MetricsShard::kBuckets + 1]) * 1e-9 << "\n";
+		out << name << "_count " << count << "\n";
+	}
+	return out.str();
+}
+
+MetricsExporter::MetricsExporter(const MetricsRegistry & registry) :
+	m_registry(registry),
+	m_stop{false},
+	m_listenFd{-1},
+	m_port{0},
+	m_intervalMs{0} {
+}
+
+MetricsExporter::~MetricsExporter() {
+	stop();
+}
+
+bool MetricsExporter::startHttp(unsigned port) {
+#ifndef _WIN32
+	m_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	if (m_listenFd < 0) {
+		m_errorMsg = std::string("socket: ") + std::strerror(errno);
+		return false;
+	}
+	int reuse = 1;
+	setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(static_cast<uint16_t>(port));
+	socklen_t length = sizeof(address);
+	if (port > 65535 ||
+			bind(m_listenFd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+			listen(m_listenFd, 16) != 0 ||
+			getsockname(m_listenFd, reinterpret_cast<sockaddr *>(&address), &length) != 0) {
+		m_errorMsg = "Metrics port " + std::to_string(port) + ": " + std::strerror(errno);
+		::close(m_listenFd);
+		m_listenFd = -1;
+		return false;
+	}
+	m_port = ntohs(address.sin_port);
+	m_stop = false;
+	m_httpThread = std::thread(&MetricsExporter::httpLoop, this);
+	return true;
+#else
+	(void)port;
+	m_errorMsg = "The metrics HTTP endpoint is not supported on Windows";
+	return false;
+#endif
+}
+
+bool MetricsExporter::startFile(const std::string & path, unsigned intervalMs) {
+	m_path = path;
+	m_intervalMs = intervalMs;
+	if (!writeFile()) {
+		return false;
+	}
+	m_stop = false;
+	m_fileThread = std::thread(&MetricsExporter::fileLoop, this);
+	return true;
+}
+
+void MetricsExporter::stop() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_stopCv.notify_all();
+	if (m_httpThread.joinable()) {
+		m_httpThread.join();
+	}
+	if (m_fileThread.joinable()) {
+		m_fileThread.join();
+		writeFile();
+	}
+#ifndef _WIN32
+	if (m_listenFd >= 0) {
+		::close(m_listenFd);
+		m_listenFd = -1;
+	}
+#endif
+}
+
+#ifndef _WIN32
+// Sends all of the data, gives up if the client stops reading
+static void sendAll(int fd, const std::string & data) {
+	size_t sent = 0;
+	while (sent < data.size()) {
+		ssize_t n = send(fd, data.data() + sent, data.size() - sent, kSendFlags);
+		if (n <= 0) {
+			return;
+		}
+		sent += static_cast<size_t>(n);
+	}
+}
+#endif
+
+// One client at a time, a scrape is a short request and a few KiB of reply
+void MetricsExporter::httpLoop() {
+#ifndef _WIN32
+	for (;;) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_stop) {
+				return;
+			}
+		}
+		pollfd listenPoll{m_listenFd, POLLIN, 0};
+		if (poll(&listenPoll, 1, kPollMs) <= 0) {
+			continue;
+		}
+		int fd = accept(m_listenFd, nullptr, nullptr);
+		if (fd < 0) {
+			continue;
+		}
+#ifdef SO_NOSIGPIPE
+		int noSigPipe = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+#endif
+		// A client that does not send its request does not block the loop
+		timeval timeout{1, 0};
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+		std::string request;
+		char buffer[1024];
+		while (request.find("\r\n\r\n") == std::string::npos && request.size() < kMaxRequestBytes) {
+			ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+			if (n <= 0) {
+				break;
+			}
+			request.append(buffer, static_cast<size_t>(n));
+		}
+		const std::string requestLine = request.substr(0, request.find("\r\n"));
+		std::string status = "404 Not Found";
+		std::string body = "Not found\n";
+		if (requestLine.compare(0, 13, "GET /metrics ") == 0 || requestLine.compare(0, 14, "HEAD /metrics ") == 0) {
+			status = "200 OK";
+			body = m_registry.render();
+		}
+		std::ostringstream response;
+		response << "HTTP/1.1 " << status << "\r\n"
+			<< "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+			<< "Content-Length: " << body.size() << "\r\n"
+			<< "Connection: close\r\n\r\n";
+		if (requestLine.compare(0, 5, "HEAD ") != 0) {
+			response << body;
+		}
+		sendAll(fd, response.str());
+		::close(fd);
+	}
+#endif
+}
+
+void MetricsExporter::fileLoop() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_stopCv.wait_for(lock, std::chrono::milliseconds(m_intervalMs), [&]() { return m_stop; })) {
+		lock.unlock();
+		writeFile();
+		lock.lock();
+	}
+}
+
+bool MetricsExporter::writeFile() {
+	const std::string tmpPath = m_path + ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		file << m_registry.render();
+		if (!file.flush()) {
+			m_errorMsg = "Failed to write the metrics file: " + tmpPath;
+			return false;
+		}
+	}
+	if (std::rename(tmpPath.c_str(), m_path.c_str()) != 0) {
+		m_errorMsg = "Failed to replace the metrics file: " + m_path;
+		return false;
+	}
+	return true;
+}
+
+unsigned MetricsExporter::getPort() const {
+	return m_port;
+}
+
+const std::string & MetricsExporter::getErrorMsg() const {
+	return m_errorMsg;
+}
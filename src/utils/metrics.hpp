@@ -0,0 +1,142 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Counters, gauges and latency histograms kept in per-thread shards. A
+// shard is written by one thread at a time with relaxed atomic loads and
+// stores, so recording a value takes no lock, no read-modify-write and no
+// system call. The exporter sums the shards when it renders them, the
+// totals are consistent per value, not across values.
+class MetricsShard {
+public:
+	// Powers of two from 1.024 us to 8.6 s, and one bucket above
+	static constexpr unsigned kMinBucketBits = 10;
+	static constexpr unsigned kBuckets = 24;
+
+private:
+	friend class MetricsRegistry;
+
+	std::unique_ptr<std::atomic<uint64_t>[]> m_counters;
+	std::unique_ptr<std::atomic<int64_t>[]> m_gauges;
+	// kBuckets + 1 buckets and the sum in ns per histogram
+	std::unique_ptr<std::atomic<uint64_t>[]> m_histograms;
+	size_t m_nGauges;
+
+	MetricsShard(size_t nCounters, size_t nGauges, size_t nHistograms);
+
+	static void add(std::atomic<uint64_t> & value, uint64_t n) {
+		value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+public:
+	void add(unsigned counter, uint64_t n = 1) {
+		add(m_counters[counter], n);
+	}
+
+	// The exported gauge is the sum over the shards
+	void setGauge(unsigned gauge, int64_t value) {
+		m_gauges[gauge].store(value, std::memory_order_relaxed);
+	}
+
+	void observeNs(unsigned histogram, uint64_t ns) {
+		// The bucket of a value is the smallest bound not below it, le is
+		// inclusive: 2048 ns is counted in le 2.048e-06
+		const uint64_t above = ns > 0 ? ns - 1 : 0;
+		unsigned bits = 0;
+		while (bits < 64 && (above >> bits) != 0) {
+			++bits;
+		}
+		unsigned bucket = bits > kMinBucketBits ? bits - kMinBucketBits : 0;
+		bucket = bucket < kBuckets ? bucket : kBuckets;
+		std::atomic<uint64_t> * values = &m_histograms[histogram * (kBuckets + 2)];
+		add(values[bucket], 1);
+		add(values[kBuckets + 1], ns);
+	}
+};
+
+// The metrics are declared first, the shards are handed out after that.
+// A shard goes back to the registry with its values when it is released,
+// its gauges are cleared, so a batch reuses the shards of finished files.
+class MetricsRegistry {
+private:
+	struct Metric {
+		std::string name;
+		std::string help;
+	};
+
+	std::vector<Metric> m_counters;
+	std::vector<Metric> m_gauges;
+	std::vector<Metric> m_histograms;
+	mutable std::mutex m_mutex;
+	std::vector<std::unique_ptr<MetricsShard>> m_shards;
+	std::vector<MetricsShard *> m_free;
+
+	void release(MetricsShard * shard);
+
+public:
+	MetricsRegistry() = default;
+	MetricsRegistry(const MetricsRegistry &) = delete;
+	MetricsRegistry & operator=(const MetricsRegistry &) = delete;
+
+	// Prometheus metric names, counters end in _total. Return the index
+	// passed to the shard.
+	unsigned addCounter(const std::string & name, const std::string & help);
+	unsigned addGauge(const std::string & name, const std::string & help);
+	// Exported in seconds
+	unsigned addHistogram(const std::string & name, const std::string & help);
+
+	// Takes a lock, call it once per thread or file, not per frame
+	std::shared_ptr<MetricsShard> acquireShard();
+
+	// Prometheus text exposition format 0.0.4
+	std::string render() const;
+};
+
+// Serves the metrics on a loopback HTTP port and/or writes them to a file
+// periodically, each on a thread of its own
+class MetricsExporter {
+private:
+	const MetricsRegistry & m_registry;
+	std::thread m_httpThread;
+	std::thread m_fileThread;
+	std::mutex m_mutex;
+	std::condition_variable m_stopCv;
+	bool m_stop;
+	int m_listenFd;
+	unsigned m_port;
+	std::string m_path;
+	unsigned m_intervalMs;
+	std::string m_errorMsg;
+
+	void httpLoop();
+	void fileLoop();
+	bool writeFile();
+
+public:
+	explicit MetricsExporter(const MetricsRegistry & registry);
+	~MetricsExporter();
+	MetricsExporter(const MetricsExporter &) = delete;
+	MetricsExporter & operator=(const MetricsExporter &) = delete;
+
+	// Listens on 127.0.0.1, port 0 picks a free port. GET /metrics returns
+	// the metrics, other paths 404.
+	bool startHttp(unsigned port);
+	// The file is replaced atomically through a temporary file next to it
+	bool startFile(const std::string & path, unsigned intervalMs);
+	// Writes the file a last time
+	void stop();
+
+	unsigned getPort() const;
+	const std::string & getErrorMsg() const;
+};
+
+#endif
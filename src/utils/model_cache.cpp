@@ -0,0 +1,118 @@
+#include "model_cache.hpp"
+
+#include <codecvt>
+#include <fstream>
+#include <locale>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+ModelCache::ModelCache() :
+	m_stats{} {
+}
+
+#ifdef _WIN32
+
+bool ModelCache::map(const std::string & path, Entry & entry, std::string & errorMsg) {
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	const std::streamoff size = file ? static_cast<std::streamoff>(file.tellg()) : 0;
+	if (size <= 0) {
+		errorMsg = "Failed to open the model: " + path;
+		return false;
+	}
+	entry.size = static_cast<size_t>(size);
+	entry.data = new uint8_t[entry.size];
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char *>(entry.data), size)) {
+		delete[] entry.data;
+		errorMsg = "Failed to read the model: " + path;
+		return false;
+	}
+	return true;
+}
+
+ModelCache::~ModelCache() {
+	for (auto & entry : m_entries) {
+		delete[] entry.second.data;
+	}
+}
+
+#else
+
+bool ModelCache::map(const std::string & path, Entry & entry, std::string & errorMsg) {
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		errorMsg = "Failed to open the model: " + path;
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		::close(fd);
+		errorMsg = "Failed to get the model size: " + path;
+		return false;
+	}
+	entry.size = static_cast<size_t>(st.st_size);
+	// The mapping stays valid after the descriptor is closed
+	void * map = mmap(nullptr, entry.size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (map == MAP_FAILED) {
+		errorMsg = "Failed to map the model: " + path;
+		return false;
+	}
+	// The SDK reads the whole model while it creates the first session
+	madvise(map, entry.size, MADV_WILLNEED);
+	entry.data = static_cast<uint8_t *>(map);
+	return true;
+}
+
+ModelCache::~ModelCache() {
+	for (auto & entry : m_entries) {
+		munmap(entry.second.data, entry.second.size);
+	}
+}
+
+#endif
+
+bool ModelCache::acquire(const std::string & path, const uint8_t *& data, size_t & size,
+		std::string & errorMsg) {
+	// Sessions are created at startup or once per file, mapping under the
+	// lock keeps two threads from mapping the same model
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto found = m_entries.find(path);
+	if (found != m_entries.end()) {
+		++m_stats.hits;
+	} else {
+		++m_stats.misses;
+		Entry entry{};
+		if (!map(path, entry, errorMsg)) {
+			return false;
+		}
+		found = m_entries.emplace(path, entry).first;
+		++m_stats.models;
+		m_stats.bytes += entry.size;
+	}
+	data = found->second.data;
+	size = found->second.size;
+	return true;
+}
+
+ModelCache::Stats ModelCache::getStats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+Krisp::AudioSdk::ModelInfo getModelInfo(ModelCache * cache, const std::string & path) {
+	std::wstring_convert<std::codecvt_utf8<wchar_t>> wstringConverter;
+	Krisp::AudioSdk::ModelInfo modelInfo;
+	modelInfo.path = wstringConverter.from_bytes(path);
+	std::string errorMsg;
+	if (cache && !cache->acquire(path, modelInfo.blob.data, modelInfo.blob.size, errorMsg)) {
+		modelInfo.blob = Krisp::AudioSdk::ModelBlob();
+	}
+	return modelInfo;
+}
@@ -0,0 +1,57 @@
+#ifndef MODEL_CACHE_HPP
+#define MODEL_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <krisp-audio-sdk.hpp>
+
+
+// Model files mapped read-only once per path and kept until the cache is
+// destroyed. Every session created from a path gets the same in-memory
+// copy through ModelInfo::blob, so the file is opened and read once and
+// its pages are shared by the sessions instead of loaded by each one. The
+// cache must outlive the sessions. Windows reads the file into memory
+// instead of mapping it. Safe to use from several threads.
+class ModelCache {
+public:
+	struct Stats {
+		uint64_t hits;
+		uint64_t misses; // files mapped, and files that failed to map
+		size_t models;
+		size_t bytes;
+	};
+
+private:
+	struct Entry {
+		uint8_t * data;
+		size_t size;
+	};
+
+	mutable std::mutex m_mutex;
+	std::map<std::string, Entry> m_entries;
+	Stats m_stats;
+
+	static bool map(const std::string & path, Entry & entry, std::string & errorMsg);
+
+public:
+	ModelCache();
+	~ModelCache();
+	ModelCache(const ModelCache &) = delete;
+	ModelCache & operator=(const ModelCache &) = delete;
+
+	// Maps the file on the first call for the path. A failed file is tried
+	// again on the next call. Returns false with errorMsg set on failure.
+	bool acquire(const std::string & path, const uint8_t *& data, size_t & size,
+		std::string & errorMsg);
+	Stats getStats() const;
+};
+
+// The model info of a session. Without a cache, or when the file can not be
+// mapped, the SDK loads the model from the path and reports the error.
+Krisp::AudioSdk::ModelInfo getModelInfo(ModelCache * cache, const std::string & path);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef NC_SESSION_STATS_HPP
+#define NC_SESSION_STATS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <krisp-audio-sdk.hpp>
+#include <krisp-audio-sdk-nc.hpp>
+
+#include "stats_sink.hpp"
+
+
+// Records the stats of the session after the frame. Session stats are
+// calculated from the start of the session processing.
+template <typename SamplingFormat>
+void recordNcStats(StatsSink & statsSink, size_t frame, unsigned channel,
+		const std::shared_ptr<Krisp::AudioSdk::Nc<SamplingFormat>> & ncSession, bool final) {
+	Krisp::AudioSdk::SessionStats ncSessionStats;
+
+	ncSession->getSessionStats(&ncSessionStats);
+
+	SessionStatsRecord record = {
+		ncSessionStats.noiseStats.noNoiseMs,
+		ncSessionStats.noiseStats.lowNoiseMs,
+		ncSessionStats.noiseStats.mediumNoiseMs,
+		ncSessionStats.noiseStats.highNoiseMs,
+		ncSessionStats.voiceStats.talkTimeMs
+	};
+	statsSink.recordSession(static_cast<uint32_t>(frame), channel, record, final);
+}
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef NC_SOCKET_PROTOCOL_HPP
+#define NC_SOCKET_PROTOCOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+// A stream of the NC daemon starts with a request from the client and a
+// reply from the daemon. The client then sends mono samples in the
+// negotiated format and receives the processed samples of every complete
+// frame, the last incomplete frame is returned when the client shuts down
+// its side of the socket. Both headers are little-endian and packed at the
+// offsets below, the samples are in the byte order of the host.
+constexpr uint32_t kNcStreamRequestMagic = 0x53434E4B; // "KNCS"
+constexpr uint32_t kNcStreamReplyMagic = 0x52434E4B;   // "KNCR"
+constexpr uint16_t kNcStreamVersion = 1;
+
+constexpr size_t kNcStreamRequestSize = 20;
+constexpr size_t kNcStreamReplySize = 12;
+
+enum class NcStreamFormat : uint16_t {
+	PCM16 = 0,
+	FLOAT = 1
+};
+
+enum class NcStreamStatus : uint32_t {
+	OK = 0,
+	BAD_REQUEST = 1,    // wrong magic or version
+	UNSUPPORTED = 2,    // sampling rate, format or frame duration
+	SESSION_FAILED = 3, // the NC session could not be created
+	BUSY = 4            // the daemon serves its maximum number of streams
+};
+
+struct NcStreamRequest {
+	uint16_t version;
+	NcStreamFormat format;
+	uint32_t samplingRate;
+	uint32_t frameDurationMs;
+	float noiseSuppressionLevel;
+};
+
+struct NcStreamReply {
+	NcStreamStatus status;
+	uint32_t frameSize; // samples per frame, 0 unless the status is OK
+};
+
+inline void putLe16(uint8_t * p, uint16_t v) {
+	p[0] = static_cast<uint8_t>(v);
+	p[1] = static_cast<uint8_t>(v >> 8);
+}
+
+inline void putLe32(uint8_t * p, uint32_t v) {
+	for (unsigned i = 0; i < 4; ++i) {
+		p[i] = static_cast<uint8_t>(v >> (8 * i));
+	}
+}
+
+inline uint16_t getLe16(const uint8_t * p) {
+	return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline uint32_t getLe32(const uint8_t * p) {
+	uint32_t v = 0;
+	for (unsigned i = 0; i < 4; ++i) {
+		v |= static_cast<uint32_t>(p[i]) << (8 * i);
+	}
+	return v;
+}
+
+inline void encodeNcStreamRequest(const NcStreamRequest & request, uint8_t * p) {
+	uint32_t level;
+	std::memcpy(&level, &request.noiseSuppressionLevel, sizeof(level));
+	putLe32(p, kNcStreamRequestMagic);
+	putLe16(p + 4, request.version);
+	putLe16(p + 6, static_cast<uint16_t>(request.format));
+	putLe32(p + 8, request.samplingRate);
+	putLe32(p + 12, request.frameDurationMs);
+	putLe32(p + 16, level);
+}
+
+inline bool decodeNcStreamRequest(const uint8_t * p, NcStreamRequest & request) {
+	if (getLe32(p) != kNcStreamRequestMagic) {
+		return false;
+	}
+	uint32_t level = getLe32(p + 16);
+	request.version = getLe16(p + 4);
+	request.format = static_cast<NcStreamFormat>(getLe16(p + 6));
+	request.samplingRate = getLe32(p + 8);
+	request.frameDurationMs = getLe32(p + 12);
+	std::memcpy(&request.noiseSuppressionLevel, &level, sizeof(level));
+	return true;
+}
+
+inline void encodeNcStreamReply(const NcStreamReply & reply, uint8_t * p) {
+	putLe32(p, kNcStreamReplyMagic);
+	putLe32(p + 4, static_cast<uint32_t>(reply.status));
+	putLe32(p + 8, reply.frameSize);
+}
+
+inline bool decodeNcStreamReply(const uint8_t * p, NcStreamReply & reply) {
+	if (getLe32(p) != kNcStreamReplyMagic) {
+		return false;
+	}
+	reply.status = static_cast<NcStreamStatus>(getLe32(p + 4));
+	reply.frameSize = getLe32(p + 8);
+	return true;
+}
+
+inline size_t getNcStreamSampleBytes(NcStreamFormat format) {
+	return format == NcStreamFormat::PCM16 ? sizeof(int16_t) : sizeof(float);
+}
+
+inline const char * getNcStreamStatusName(NcStreamStatus status) {
+	switch (status) {
+	case NcStreamStatus::OK:
+		return "ok";
+	case NcStreamStatus::BAD_REQUEST:
+		return "bad request";
+	case NcStreamStatus::UNSUPPORTED:
+		return "unsupported rate, format or frame duration";
+	case NcStreamStatus::SESSION_FAILED:
+		return "the NC session could not be created";
+	case NcStreamStatus::BUSY:
+		return "the daemon is busy";
+	}
+	return "unknown status";
+}
+
+#endif
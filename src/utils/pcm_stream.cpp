@@ -0,0 +1,368 @@
+#include "pcm_stream.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+
+static const uint16_t kWaveFormatPcm = 0x0001;
+static const uint16_t kWaveFormatFloat = 0x0003;
+static const uint16_t kWaveFormatExtensible = 0xFFFE;
+// Larger fmt chunks are not expected from any encoder
+static const uint32_t kMaxFormatChunkSize = 1024;
+
+static uint16_t readLe16(const uint8_t * p) {
+	return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t readLe32(const uint8_t * p) {
+	return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+		(static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static void writeLe16(uint8_t * p, uint16_t value) {
+	p[0] = static_cast<uint8_t>(value);
+	p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+static void writeLe32(uint8_t * p, uint32_t value) {
+	for (unsigned b = 0; b < 4; ++b) {
+		p[b] = static_cast<uint8_t>(value >> (8 * b));
+	}
+}
+
+size_t getBytesPerSample(SoundFileFormat format) {
+	switch (format) {
+	case SoundFileFormat::PCM16:
+		return sizeof(int16_t);
+	case SoundFileFormat::FLOAT:
+		return sizeof(float);
+	default:
+		return 0;
+	}
+}
+
+#ifdef _WIN32
+
+// The console handles do not support overlapped I/O or polling, the
+// Windows build reads and writes in blocking mode
+static void setBinaryMode(int fd) {
+	_setmode(fd, _O_BINARY);
+}
+
+static long readFd(int fd, uint8_t * data, size_t size) {
+	return _read(fd, data, static_cast<unsigned>(std::min<size_t>(size, 1 << 30)));
+}
+
+static long writeFd(int fd, const uint8_t * data, size_t size) {
+	return _write(fd, data, static_cast<unsigned>(std::min<size_t>(size, 1 << 30)));
+}
+
+static bool waitWritable(int, bool, bool & ready) {
+	ready = true;
+	return true;
+}
+
+#else
+
+static void setBinaryMode(int) {
+}
+
+static long readFd(int fd, uint8_t * data, size_t size) {
+	return static_cast<long>(::read(fd, data, size));
+}
+
+static long writeFd(int fd, const uint8_t * data, size_t size) {
+	return static_cast<long>(::write(fd, data, size));
+}
+
+// Polls the descriptor for writing, ready is false when wait is false and
+// the descriptor does not take any byte now
+static bool waitWritable(int fd, bool wait, bool & ready) {
+	struct pollfd pfd = {fd, POLLOUT, 0};
+	int n;
+	while ((n = poll(&pfd, 1, wait ? -1 : 0)) < 0) {
+		if (errno != EINTR) {
+			return false;
+		}
+	}
+	ready = n > 0;
+	return true;
+}
+
+#endif
+
+// A pipe that polls writable has room for at least PIPE_BUF bytes, a
+// blocking write of that size returns without waiting for the reader
+static const size_t kWriteChunk = 4096;
+
+PcmStreamReader::PcmStreamReader(size_t bufferSize) :
+	m_fd{-1},
+	m_buffer(bufferSize),
+	m_begin{0},
+	m_end{0},
+	m_eof{false},
+	m_errorMsg() {
+}
+
+PcmStreamReader::~PcmStreamReader() {
+	close();
+}
+
+bool PcmStreamReader::open(int fd) {
+	close();
+	m_fd = fd;
+	setBinaryMode(fd);
+	m_begin = 0;
+	m_end = 0;
+	m_eof = false;
+	m_errorMsg.clear();
+	return true;
+}
+
+void PcmStreamReader::close() {
+	m_fd = -1;
+}
+
+bool PcmStreamReader::readSome() {
+	if (m_begin != 0) {
+		std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+		m_end -= m_begin;
+		m_begin = 0;
+	}
+	for (;;) {
+		long n = readFd(m_fd, m_buffer.data() + m_end, m_buffer.size() - m_end);
+		if (n > 0) {
+			m_end += static_cast<size_t>(n);
+			return true;
+		}
+		if (n == 0) {
+			m_eof = true;
+			return true;
+		}
+		if (errno == EINTR) {
+			continue;
+		}
+		m_errorMsg = std::string("Failed to read the input stream: ") + std::strerror(errno);
+		return false;
+	}
+}
+
+bool PcmStreamReader::fill(size_t minBytes) {
+	if (minBytes > m_buffer.size()) {
+		m_buffer.resize(minBytes);
+	}
+	while (getSize() < minBytes && !m_eof) {
+		if (!readSome()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+const uint8_t * PcmStreamReader::getData() const {
+	return m_buffer.data() + m_begin;
+}
+
+size_t PcmStreamReader::getSize() const {
+	return m_end - m_begin;
+}
+
+void PcmStreamReader::consume(size_t nBytes) {
+	m_begin += std::min(nBytes, getSize());
+	if (m_begin == m_end) {
+		m_begin = 0;
+		m_end = 0;
+	}
+}
+
+bool PcmStreamReader::getEof() const {
+	return m_eof;
+}
+
+std::string PcmStreamReader::getErrorMsg() const {
+	return m_errorMsg;
+}
+
+bool PcmStreamReader::readWavHeader(PcmStreamFormat & format) {
+	m_errorMsg.clear();
+	if (!fill(12)) {
+		return false;
+	}
+	if (getSize() < 4 || std::memcmp(getData(), "RIFF", 4) != 0) {
+		return false;
+	}
+	if (getSize() < 12 || std::memcmp(getData() + 8, "WAVE", 4) != 0) {
+		m_errorMsg = "The input stream is not a RIFF/WAVE stream.";
+		return false;
+	}
+	consume(12);
+
+	uint16_t formatTag = 0;
+	uint16_t bitsPerSample = 0;
+	bool hasFormat = false;
+	for (;;) {
+		if (!fill(8)) {
+			return false;
+		}
+		if (getSize() < 8) {
+			m_errorMsg = "The input stream has no data chunk.";
+			return false;
+		}
+		char id[4];
+		std::memcpy(id, getData(), 4);
+		uint32_t chunkSize = readLe32(getData() + 4);
+		consume(8);
+		if (std::memcmp(id, "data", 4) == 0) {
+			break;
+		}
+		// Chunks are padded to an even size
+		size_t skip = chunkSize + (chunkSize & 1u);
+		if (std::memcmp(id, "fmt ", 4) == 0) {
+			if (chunkSize < 16 || chunkSize > kMaxFormatChunkSize || !fill(chunkSize) ||
+					getSize() < chunkSize) {
+				m_errorMsg = "The fmt chunk of the input stream is truncated.";
+				return false;
+			}
+			const uint8_t * body = getData();
+			formatTag = readLe16(body);
+			format.channels = readLe16(body + 2);
+			format.samplingRate = readLe32(body + 4);
+			bitsPerSample = readLe16(body + 14);
+			if (formatTag == kWaveFormatExtensible && chunkSize >= 40) {
+				// The sub format GUID starts with the format tag
+				formatTag = readLe16(body + 24);
+			}
+			hasFormat = true;
+		}
+		while (skip != 0) {
+			if (!fill(std::min(skip, m_buffer.size())) || getSize() == 0) {
+				m_errorMsg = "The input stream ends in the WAV header.";
+				return false;
+			}
+			size_t n = std::min(skip, getSize());
+			consume(n);
+			skip -= n;
+		}
+	}
+	if (!hasFormat) {
+		m_errorMsg = "The data chunk of the input stream precedes the fmt chunk.";
+		return false;
+	}
+	if (formatTag == kWaveFormatPcm && bitsPerSample == 16) {
+		format.format = SoundFileFormat::PCM16;
+	} else if (formatTag == kWaveFormatFloat && bitsPerSample == 32) {
+		format.format = SoundFileFormat::FLOAT;
+	} else {
+		m_errorMsg = "The input stream should be WAV PCM16 or FLOAT.";
+		return false;
+	}
+	return true;
+}
+
+PcmStreamWriter::PcmStreamWriter(size_t maxPending) :
+	m_fd{-1},
+	m_pending(),
+	m_pendingBegin{0},
+	m_maxPending{maxPending},
+	m_errorMsg() {
+}
+
+PcmStreamWriter::~PcmStreamWriter() {
+	close();
+}
+
+bool PcmStreamWriter::open(int fd) {
+	close();
+	m_fd = fd;
+	setBinaryMode(fd);
+	m_pending.clear();
+	m_pendingBegin = 0;
+	m_errorMsg.clear();
+	return true;
+}
+
+void PcmStreamWriter::close() {
+	m_fd = -1;
+}
+
+std::string PcmStreamWriter::getErrorMsg() const {
+	return m_errorMsg;
+}
+
+// Writes as much of the pending bytes as the descriptor takes, waits for
+// the rest only if asked to
+bool PcmStreamWriter::writePending(bool wait) {
+	while (m_pendingBegin < m_pending.size()) {
+		bool ready = false;
+		if (!waitWritable(m_fd, wait, ready)) {
+			m_errorMsg = std::string("Failed to poll the output stream: ") + std::strerror(errno);
+			return false;
+		}
+		if (!ready) {
+			return true;
+		}
+		const size_t size = std::min(m_pending.size() - m_pendingBegin, kWriteChunk);
+		long n = writeFd(m_fd, m_pending.data() + m_pendingBegin, size);
+		if (n > 0) {
+			m_pendingBegin += static_cast<size_t>(n);
+			continue;
+		}
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		m_errorMsg = std::string("Failed to write the output stream: ") + std::strerror(errno);
+		return false;
+	}
+	m_pending.clear();
+	m_pendingBegin = 0;
+	return true;
+}
+
+bool PcmStreamWriter::write(const void * data, size_t nBytes) {
+	const uint8_t * bytes = static_cast<const uint8_t *>(data);
+	m_pending.insert(m_pending.end(), bytes, bytes + nBytes);
+	if (!writePending(false)) {
+		return false;
+	}
+	// The consumer does not keep up, wait until the backlog is small again
+	if (m_pending.size() - m_pendingBegin > m_maxPending) {
+		return writePending(true);
+	}
+	if (m_pendingBegin != 0) {
+		m_pending.erase(m_pending.begin(), m_pending.begin() + static_cast<std::ptrdiff_t>(m_pendingBegin));
+		m_pendingBegin = 0;
+	}
+	return true;
+}
+
+bool PcmStreamWriter::flush() {
+	return writePending(true);
+}
+
+bool PcmStreamWriter::writeWavHeader(const PcmStreamFormat & format) {
+	const uint16_t bytesPerSample = static_cast<uint16_t>(getBytesPerSample(format.format));
+	const uint16_t blockAlign = static_cast<uint16_t>(bytesPerSample * format.channels);
+	uint8_t header[44];
+	std::memcpy(header, "RIFF", 4);
+	writeLe32(header + 4, 0xFFFFFFFFu);
+	std::memcpy(header + 8, "WAVEfmt ", 8);
+	writeLe32(header + 16, 16);
+	writeLe16(header + 20, format.format == SoundFileFormat::FLOAT ? kWaveFormatFloat : kWaveFormatPcm);
+	writeLe16(header + 22, static_cast<uint16_t>(format.channels));
+	writeLe32(header + 24, format.samplingRate);
+	writeLe32(header + 28, format.samplingRate * blockAlign);
+	writeLe16(header + 32, blockAlign);
+	writeLe16(header + 34, static_cast<uint16_t>(8 * bytesPerSample));
+	std::memcpy(header + 36, "data", 4);
+	writeLe32(header + 40, 0xFFFFFFFFu);
+	return write(header, sizeof(header));
+}
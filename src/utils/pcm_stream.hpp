@@ -0,0 +1,97 @@
+#ifndef PCM_STREAM_HPP
+#define PCM_STREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sound_file.hpp"
+
+
+struct PcmStreamFormat {
+	uint32_t samplingRate;
+	unsigned channels;
+	SoundFileFormat format; // PCM16 or FLOAT
+};
+
+size_t getBytesPerSample(SoundFileFormat format);
+
+// Reads a pipe or any other non-seekable descriptor into an internal
+// buffer. Every read takes the bytes already available up to the free space
+// of the buffer and blocks only when there is nothing to read. The
+// descriptor stays in blocking mode, its flags are shared with the shell
+// and the other processes of the pipeline.
+class PcmStreamReader {
+private:
+	int m_fd;
+	std::vector<uint8_t> m_buffer;
+	size_t m_begin;
+	size_t m_end;
+	bool m_eof;
+	std::string m_errorMsg;
+
+	bool readSome();
+
+public:
+	explicit PcmStreamReader(size_t bufferSize = 1 << 16);
+	~PcmStreamReader();
+	PcmStreamReader(const PcmStreamReader &) = delete;
+	PcmStreamReader & operator=(const PcmStreamReader &) = delete;
+
+	bool open(int fd);
+	// Detaches the descriptor, it is not closed
+	void close();
+
+	// Reads until at least minBytes are buffered or the stream ends,
+	// returns false on a read error
+	bool fill(size_t minBytes);
+	const uint8_t * getData() const;
+	size_t getSize() const;
+	void consume(size_t nBytes);
+	bool getEof() const;
+	std::string getErrorMsg() const;
+
+	// Parses a RIFF/WAVE header up to the start of the data chunk. The
+	// chunk sizes are ignored, pipes usually carry a placeholder, and the
+	// data is read until the end of the stream. Returns false with an empty
+	// error message if the stream does not start with a RIFF header.
+	bool readWavHeader(PcmStreamFormat & format);
+};
+
+// Writes to a pipe without blocking the caller. The bytes are written in
+// chunks of PIPE_BUF while poll() reports the descriptor writable, what it
+// does not take at once is kept in a pending buffer and written by the next
+// calls. The caller blocks only when the pending bytes exceed the limit.
+// The descriptor stays in blocking mode.
+class PcmStreamWriter {
+private:
+	int m_fd;
+	std::vector<uint8_t> m_pending;
+	size_t m_pendingBegin;
+	size_t m_maxPending;
+	std::string m_errorMsg;
+
+	bool writePending(bool wait);
+
+public:
+	explicit PcmStreamWriter(size_t maxPending = 1 << 16);
+	~PcmStreamWriter();
+	PcmStreamWriter(const PcmStreamWriter &) = delete;
+	PcmStreamWriter & operator=(const PcmStreamWriter &) = delete;
+
+	bool open(int fd);
+	// Detaches the descriptor, the pending bytes are dropped
+	void close();
+
+	bool write(const void * data, size_t nBytes);
+	// Blocks until every pending byte is written
+	bool flush();
+	std::string getErrorMsg() const;
+
+	// A WAV header for a stream of unknown length, the RIFF and data sizes
+	// are set to the maximum as other streaming tools do
+	bool writeWavHeader(const PcmStreamFormat & format);
+};
+
+#endif
@@ -0,0 +1,294 @@
+#include "resampler.hpp"
+
+#include <cmath>
+
+#include "sample_convert.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define RESAMPLER_AVX2 1
+#define RESAMPLER_SSE 1
+#elif defined(_M_X64)
+#include <immintrin.h>
+#define RESAMPLER_SSE 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RESAMPLER_NEON 1
+#endif
+
+
+// Lowpass cutoff relative to the lower of the two Nyquist frequencies
+static constexpr double kCutoff = 0.9;
+static constexpr double kKaiserBeta = 7.0;
+
+static_assert(Resampler::kTaps % 8 == 0, "The vector kernels work on 8 taps at a time");
+
+typedef float (*DotFunction)(const float * x, const float * h);
+
+static float dotScalar(const float * x, const float * h) {
+	float sum = 0.0f;
+	for (unsigned k = 0; k < Resampler::kTaps; ++k) {
+		sum += x[k] * h[k];
+	}
+	return sum;
+}
+
+#if defined(RESAMPLER_SSE)
+static float dotSse(const float * x, const float * h) {
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	for (unsigned k = 0; k < Resampler::kTaps; k += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(x + k), _mm_loadu_ps(h + k)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(x + k + 4), _mm_loadu_ps(h + k + 4)));
+	}
+	__m128 sum = _mm_add_ps(sum0, sum1);
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+#endif
+
+#if defined(RESAMPLER_AVX2)
+__attribute__((target("avx2,fma")))
+static float dotAvx2(const float * x, const float * h) {
+	__m256 sum = _mm256_setzero_ps();
+	for (unsigned k = 0; k < Resampler::kTaps; k += 8) {
+		sum = _mm256_fmadd_ps(_mm256_loadu_ps(x + k), _mm256_loadu_ps(h + k), sum);
+	}
+	__m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+	half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+	half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+	return _mm_cvtss_f32(half);
+}
+#endif
+
+#if defined(RESAMPLER_NEON)
+static float dotNeon(const float * x, const float * h) {
+	float32x4_t sum0 = vdupq_n_f32(0.0f);
+	float32x4_t sum1 = vdupq_n_f32(0.0f);
+	for (unsigned k = 0; k < Resampler::kTaps; k += 8) {
+		sum0 = vmlaq_f32(sum0, vld1q_f32(x + k), vld1q_f32(h + k));
+		sum1 = vmlaq_f32(sum1, vld1q_f32(x + k + 4), vld1q_f32(h + k + 4));
+	}
+	float32x4_t sum = vaddq_f32(sum0, sum1);
+	float32x2_t pair = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+	return vget_lane_f32(vpadd_f32(pair, pair), 0);
+}
+#endif
+
+struct DotKernel {
+	DotFunction function;
+	const char * name;
+};
+
+// Available kernels, the fastest last
+static std::vector<DotKernel> getDotKernels() {
+	std::vector<DotKernel> kernels{DotKernel{dotScalar, "scalar"}};
+#if defined(RESAMPLER_SSE)
+	kernels.push_back(DotKernel{dotSse, "sse"});
+#endif
+#if defined(RESAMPLER_AVX2)
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		kernels.push_back(DotKernel{dotAvx2, "avx2"});
+	}
+#endif
+#if defined(RESAMPLER_NEON)
+	kernels.push_back(DotKernel{dotNeon, "neon"});
+#endif
+	return kernels;
+}
+
+static DotKernel & getDotKernel() {
+	static DotKernel kernel = getDotKernels().back();
+	return kernel;
+}
+
+static uint32_t greatestCommonDivisor(uint32_t a, uint32_t b) {
+	while (b != 0) {
+		uint32_t r = a % b;
+		a = b;
+		b = r;
+	}
+	return a;
+}
+
+// Zeroth order modified Bessel function of the first kind
+static double besselI0(double x) {
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 50; ++k) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1e-12) {
+			break;
+		}
+	}
+	return sum;
+}
+
+Resampler::Resampler() :
+	m_inRate(0),
+	m_outRate(0),
+	m_up(1),
+	m_down(1),
+	m_nPhases(0),
+	m_pos(0),
+	m_phase(0) {
+}
+
+bool Resampler::init(uint32_t inRate, uint32_t outRate) {
+	if (inRate == 0 || outRate == 0) {
+		m_errorMsg = "The sampling rates must be positive";
+		return false;
+	}
+	m_inRate = inRate;
+	m_outRate = outRate;
+	uint32_t divisor = greatestCommonDivisor(inRate, outRate);
+	m_up = outRate / divisor;
+	m_down = inRate / divisor;
+	m_nPhases = std::min(m_up, static_cast<uint32_t>(kMaxPhases));
+	m_filters.clear();
+	if (!isPassThrough()) {
+		// The prototype lowpass runs at nPhases times the input rate, phase p
+		// tap k of the polyphase table is prototype sample k * nPhases + p
+		const double pi = std::acos(-1.0);
+		const size_t length = static_cast<size_t>(kTaps) * m_nPhases;
+		const double center = static_cast<double>(length - 1) / 2.0;
+		const double cutoff = kCutoff * std::min(inRate, outRate) /
+			(2.0 * static_cast<double>(inRate) * m_nPhases);
+		const double windowNorm = besselI0(kKaiserBeta);
+		m_filters.resize(length);
+		for (unsigned p = 0; p < m_nPhases; ++p) {
+			float * row = &m_filters[static_cast<size_t>(p) * kTaps];
+			double sum = 0.0;
+			for (unsigned k = 0; k < kTaps; ++k) {
+				double t = static_cast<double>(k) * m_nPhases + p - center;
+				double r = t / (center + 1.0);
+				double window = besselI0(kKaiserBeta * std::sqrt(std::max(0.0, 1.0 - r * r))) / windowNorm;
+				double x = 2.0 * pi * cutoff * t;
+				double sinc = std::fabs(x) < 1e-12 ? 1.0 : std::sin(x) / x;
+				double value = sinc * window;
+				// Reversed so the oldest sample of the window meets the last tap
+				row[kTaps - 1 - k] = static_cast<float>(value);
+				sum += value;
+			}
+			// Unity DC gain for every phase
+			for (unsigned k = 0; k < kTaps; ++k) {
+				row[k] = static_cast<float>(row[k] / sum);
+			}
+		}
+	}
+	reset();
+	return true;
+}
+
+void Resampler::reset() {
+	m_history.assign(kTaps - 1, 0.0f);
+	m_pos = 0;
+	m_phase = 0;
+}
+
+const std::string & Resampler::getErrorMsg() const {
+	return m_errorMsg;
+}
+
+uint32_t Resampler::getInRate() const {
+	return m_inRate;
+}
+
+uint32_t Resampler::getOutRate() const {
+	return m_outRate;
+}
+
+bool Resampler::isPassThrough() const {
+	return m_up == m_down;
+}
+
+size_t Resampler::getMaxOutput(size_t nIn) const {
+	if (isPassThrough()) {
+		return nIn;
+	}
+	return static_cast<size_t>((static_cast<uint64_t>(nIn) * m_up + m_down - 1) / m_down) + 1;
+}
+
+double Resampler::getDelaySeconds() const {
+	if (isPassThrough() || m_inRate == 0) {
+		return 0.0;
+	}
+	return (static_cast<double>(kTaps) - 1.0 / m_nPhases) / 2.0 / m_inRate;
+}
+
+size_t Resampler::processFloat(const float * in, size_t nIn, float * out) {
+	if (isPassThrough()) {
+		std::copy(in, in + nIn, out);
+		return nIn;
+	}
+	const DotFunction dot = getDotKernel().function;
+	m_history.insert(m_history.end(), in, in + nIn);
+	size_t nOut = 0;
+	while (m_pos + kTaps <= m_history.size()) {
+		unsigned row = m_nPhases == m_up ? m_phase :
+			static_cast<unsigned>(static_cast<uint64_t>(m_phase) * m_nPhases / m_up);
+		out[nOut++] = dot(&m_history[m_pos], &m_filters[static_cast<size_t>(row) * kTaps]);
+		m_phase += m_down;
+		m_pos += m_phase / m_up;
+		m_phase %= m_up;
+	}
+	// Keep the history of the next output, m_pos may run past the input
+	// when downsampling
+	size_t consumed = std::min(m_pos, m_history.size());
+	m_history.erase(m_history.begin(), m_history.begin() + static_cast<std::ptrdiff_t>(consumed));
+	m_pos -= consumed;
+	return nOut;
+}
+
+size_t Resampler::process(const float * in, size_t nIn, float * out) {
+	return processFloat(in, nIn, out);
+}
+
+size_t Resampler::process(const int16_t * in, size_t nIn, int16_t * out) {
+	m_scratchIn.resize(nIn);
+	m_scratchOut.resize(getMaxOutput(nIn));
+	pcm16ToFloat(in, nIn, m_scratchIn.data());
+	size_t nOut = processFloat(m_scratchIn.data(), nIn, m_scratchOut.data());
+	floatToPcm16(m_scratchOut.data(), nOut, out);
+	return nOut;
+}
+
+size_t Resampler::flush(float * out) {
+	if (isPassThrough()) {
+		return 0;
+	}
+	const float silence[kTaps] = {};
+	return processFloat(silence, kTaps, out);
+}
+
+size_t Resampler::flush(int16_t * out) {
+	if (isPassThrough()) {
+		return 0;
+	}
+	const int16_t silence[kTaps] = {};
+	return process(silence, kTaps, out);
+}
+
+const char * Resampler::getKernelName() {
+	return getDotKernel().name;
+}
+
+std::vector<std::string> Resampler::getKernelNames() {
+	std::vector<std::string> names;
+	for (const auto & kernel : getDotKernels()) {
+		names.push_back(kernel.name);
+	}
+	return names;
+}
+
+bool Resampler::selectKernel(const std::string & name) {
+	for (const auto & kernel : getDotKernels()) {
+		if (name == kernel.name) {
+			getDotKernel() = kernel;
+			return true;
+		}
+	}
+	return false;
+}
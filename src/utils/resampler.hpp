@@ -0,0 +1,194 @@
+#ifndef RESAMPLER_HPP
+#define RESAMPLER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Streaming polyphase windowed-sinc resampler for a single channel.
+//
+// The rate ratio is reduced to up/down and every output sample is the dot
+// product of kTaps input samples with one of the up filter phases. Ratios
+// with more than kMaxPhases phases use the nearest phase. The dot product
+// runs on AVX2/FMA or SSE (picked at run time) or NEON, with a scalar
+// fallback. Equal rates are passed through.
+class Resampler {
+public:
+	static constexpr unsigned kTaps = 32;
+	static constexpr unsigned kMaxPhases = 4096;
+
+private:
+	uint32_t m_inRate;
+	uint32_t m_outRate;
+	uint32_t m_up;
+	uint32_t m_down;
+	unsigned m_nPhases;
+	// m_nPhases rows of kTaps coefficients, reversed for the dot product
+	std::vector<float> m_filters;
+	// kTaps - 1 samples of history followed by the unconsumed input
+	std::vector<float> m_history;
+	size_t m_pos;
+	uint32_t m_phase;
+	std::vector<float> m_scratchIn;
+	std::vector<float> m_scratchOut;
+	std::string m_errorMsg;
+
+	bool isPassThrough() const;
+	size_t processFloat(const float * in, size_t nIn, float * out);
+
+public:
+	Resampler();
+
+	bool init(uint32_t inRate, uint32_t outRate);
+	void reset();
+	const std::string & getErrorMsg() const;
+
+	uint32_t getInRate() const;
+	uint32_t getOutRate() const;
+	// Upper bound of the samples returned by process() for nIn input samples
+	size_t getMaxOutput(size_t nIn) const;
+	// Group delay of the filter
+	double getDelaySeconds() const;
+
+	// Returns the number of output samples, out must hold getMaxOutput(nIn)
+	size_t process(const float * in, size_t nIn, float * out);
+	size_t process(const int16_t * in, size_t nIn, int16_t * out);
+	// Pushes kTaps samples of silence to drain the filter,
+	// out must hold getMaxOutput(kTaps)
+	size_t flush(float * out);
+	size_t flush(int16_t * out);
+
+	// Name of the dot product kernel in use, the fastest one of the CPU
+	// unless another one was selected
+	static const char * getKernelName();
+	// Kernels supported by the CPU, from the slowest to the fastest
+	static std::vector<std::string> getKernelNames();
+	// Not thread safe, meant for benchmarks before any processing starts
+	static bool selectKernel(const std::string & name);
+};
+
+
+// Runs a frame processor at a supported rate on a stream at any rate. The
+// input is resampled to the processing rate and cut into frames, the
+// processed frames are resampled to the output rate. Samples that do not
+// fill a frame are kept for the next call, flush() pads and processes them.
+//
+// processFrame(const T * in, T * out) processes one frame of frameSize
+// samples at the processing rate.
+template <typename T>
+class FrameResampler {
+private:
+	Resampler m_in;
+	Resampler m_out;
+	size_t m_frameSize;
+	size_t m_maxInput;
+	std::vector<T> m_pending;
+	size_t m_nPending;
+	std::vector<T> m_processed;
+	uint64_t m_nIn;
+	uint64_t m_nOut;
+	std::string m_errorMsg;
+
+	size_t getMaxPending() const {
+		// An incomplete frame, the new input and the padding of the last frame
+		return 2 * m_frameSize + m_in.getMaxOutput(std::max<size_t>(m_maxInput, Resampler::kTaps));
+	}
+
+	template <class ProcessFrame>
+	size_t processPending(T * out, ProcessFrame & processFrame) {
+		size_t nFrames = m_nPending / m_frameSize;
+		for (size_t f = 0; f < nFrames; ++f) {
+			processFrame(static_cast<const T *>(&m_pending[f * m_frameSize]),
+				&m_processed[f * m_frameSize]);
+		}
+		size_t nDone = nFrames * m_frameSize;
+		std::copy(m_pending.begin() + static_cast<std::ptrdiff_t>(nDone),
+			m_pending.begin() + static_cast<std::ptrdiff_t>(m_nPending),
+			m_pending.begin());
+		m_nPending -= nDone;
+		return m_out.process(m_processed.data(), nDone, out);
+	}
+
+public:
+	FrameResampler() : m_frameSize(0), m_maxInput(0), m_nPending(0), m_nIn(0), m_nOut(0) {}
+
+	// maxInput is the largest number of samples passed to one process() call
+	bool init(uint32_t inRate, uint32_t processRate, uint32_t outRate,
+			size_t frameSize, size_t maxInput) {
+		if (frameSize == 0 || maxInput == 0) {
+			m_errorMsg = "The frame size and the input size must be positive";
+			return false;
+		}
+		if (!m_in.init(inRate, processRate)) {
+			m_errorMsg = m_in.getErrorMsg();
+			return false;
+		}
+		if (!m_out.init(processRate, outRate)) {
+			m_errorMsg = m_out.getErrorMsg();
+			return false;
+		}
+		m_frameSize = frameSize;
+		m_maxInput = maxInput;
+		m_pending.assign(getMaxPending(), T(0));
+		m_processed.assign(getMaxPending(), T(0));
+		m_nPending = 0;
+		m_nIn = 0;
+		m_nOut = 0;
+		return true;
+	}
+
+	const std::string & getErrorMsg() const {
+		return m_errorMsg;
+	}
+
+	// Upper bound of the frames processed by one process() or flush() call
+	size_t getMaxFrames() const {
+		return getMaxPending() / m_frameSize + 1;
+	}
+
+	// Upper bound of the samples returned by one process() or flush() call
+	size_t getMaxOutput() const {
+		return m_out.getMaxOutput(getMaxPending()) + m_out.getMaxOutput(Resampler::kTaps);
+	}
+
+	// Added latency of the input and output resampling
+	double getDelaySeconds() const {
+		return m_in.getDelaySeconds() + m_out.getDelaySeconds();
+	}
+
+	// Returns the number of output samples, n must not exceed maxInput
+	template <class ProcessFrame>
+	size_t process(const T * in, size_t n, T * out, ProcessFrame processFrame) {
+		m_nPending += m_in.process(in, n, &m_pending[m_nPending]);
+		m_nIn += n;
+		size_t nOut = processPending(out, processFrame);
+		m_nOut += nOut;
+		return nOut;
+	}
+
+	// Drains the filters and the incomplete last frame. The total output is
+	// trimmed to the input length converted to the output rate.
+	template <class ProcessFrame>
+	size_t flush(T * out, ProcessFrame processFrame) {
+		m_nPending += m_in.flush(&m_pending[m_nPending]);
+		size_t nPadded = (m_nPending + m_frameSize - 1) / m_frameSize * m_frameSize;
+		std::fill(m_pending.begin() + static_cast<std::ptrdiff_t>(m_nPending),
+			m_pending.begin() + static_cast<std::ptrdiff_t>(nPadded), T(0));
+		m_nPending = nPadded;
+		size_t nOut = processPending(out, processFrame);
+		nOut += m_out.flush(out + nOut);
+
+		uint64_t expected = (m_nIn * m_out.getOutRate() + m_in.getInRate() - 1) / m_in.getInRate();
+		uint64_t remaining = expected > m_nOut ? expected - m_nOut : 0;
+		if (nOut > remaining) {
+			nOut = static_cast<size_t>(remaining);
+		}
+		m_nOut += nOut;
+		return nOut;
+	}
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include "sample_convert.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define SAMPLE_CONVERT_SSE2 1
+#define SAMPLE_CONVERT_SSSE3 1
+#elif defined(_M_X64)
+#include <emmintrin.h>
+#define SAMPLE_CONVERT_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SAMPLE_CONVERT_NEON 1
+#endif
+
+
+static constexpr float kScale16 = 1.0f / 32768.0f;
+static constexpr float kScale32 = 1.0f / 2147483648.0f;
+static constexpr float kScaleU8 = 1.0f / 128.0f;
+
+// The 24 bit samples are placed in the upper bytes of an int32, so all the
+// integer formats share the 32 bit scale
+static int32_t loadPcm24(const uint8_t * p) {
+	return static_cast<int32_t>(static_cast<uint32_t>(p[0]) << 8 |
+		static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 24);
+}
+
+#if defined(SAMPLE_CONVERT_SSSE3)
+__attribute__((target("ssse3")))
+static size_t pcm24ToFloatSsse3(const uint8_t * in, size_t n, float * out) {
+	// Lane j takes bytes 3j..3j+2 into its upper three bytes
+	const __m128i shuffle = _mm_setr_epi8(
+		-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+	const __m128 scale = _mm_set1_ps(kScale32);
+	size_t i = 0;
+	// Every load reads 16 bytes for 4 samples, keep it inside the buffer
+	for (; i + 6 <= n; i += 4) {
+		__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 3 * i));
+		__m128i samples = _mm_shuffle_epi8(bytes, shuffle);
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(samples), scale));
+	}
+	return i;
+}
+
+static bool hasSsse3() {
+	static const bool supported = __builtin_cpu_supports("ssse3");
+	return supported;
+}
+#endif
+
+void pcm16ToFloat(const int16_t * in, size_t n, float * out) {
+	size_t i = 0;
+#if defined(SAMPLE_CONVERT_SSE2)
+	const __m128 scale = _mm_set1_ps(kScale16);
+	for (; i + 8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+#elif defined(SAMPLE_CONVERT_NEON)
+	for (; i + 8 <= n; i += 8) {
+		int16x8_t x = vld1q_s16(in + i);
+		vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), kScale16));
+		vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), kScale16));
+	}
+#endif
+	for (; i < n; ++i) {
+		out[i] = static_cast<float>(in[i]) * kScale16;
+	}
+}
+
+void pcm24ToFloat(const uint8_t * in, size_t n, float * out) {
+	size_t i = 0;
+#if defined(SAMPLE_CONVERT_SSSE3)
+	if (hasSsse3()) {
+		i = pcm24ToFloatSsse3(in, n, out);
+	}
+#elif defined(SAMPLE_CONVERT_NEON)
+	for (; i + 16 <= n; i += 16) {
+		// Split the low, middle and high bytes of 16 samples
+		uint8x16x3_t bytes = vld3q_u8(in + 3 * i);
+		uint16x8_t lowMid[2] = {
+			vreinterpretq_u16_u8(vzip1q_u8(vdupq_n_u8(0), bytes.val[0])),
+			vreinterpretq_u16_u8(vzip2q_u8(vdupq_n_u8(0), bytes.val[0]))};
+		uint16x8_t high[2] = {
+			vreinterpretq_u16_u8(vzip1q_u8(bytes.val[1], bytes.val[2])),
+			vreinterpretq_u16_u8(vzip2q_u8(bytes.val[1], bytes.val[2]))};
+		for (unsigned h = 0; h < 2; ++h) {
+			int32x4_t a = vreinterpretq_s32_u16(vzip1q_u16(lowMid[h], high[h]));
+			int32x4_t b = vreinterpretq_s32_u16(vzip2q_u16(lowMid[h], high[h]));
+			vst1q_f32(out + i + 8 * h, vmulq_n_f32(vcvtq_f32_s32(a), kScale32));
+			vst1q_f32(out + i + 8 * h + 4, vmulq_n_f32(vcvtq_f32_s32(b), kScale32));
+		}
+	}
+#endif
+	for (; i < n; ++i) {
+		out[i] = static_cast<float>(loadPcm24(in + 3 * i)) * kScale32;
+	}
+}
+
+void pcm32ToFloat(const int32_t * in, size_t n, float * out) {
+	size_t i = 0;
+#if defined(SAMPLE_CONVERT_SSE2)
+	const __m128 scale = _mm_set1_ps(kScale32);
+	for (; i + 4 <= n; i += 4) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(x), scale));
+	}
+#elif defined(SAMPLE_CONVERT_NEON)
+	for (; i + 4 <= n; i += 4) {
+		vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(in + i)), kScale32));
+	}
+#endif
+	for (; i < n; ++i) {
+		out[i] = static_cast<float>(in[i]) * kScale32;
+	}
+}
+
+void pcmU8ToFloat(const uint8_t * in, size_t n, float * out) {
+	size_t i = 0;
+#if defined(SAMPLE_CONVERT_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i offset = _mm_set1_epi16(128);
+	const __m128 scale = _mm_set1_ps(kScaleU8);
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+		__m128i halves[2] = {
+			_mm_sub_epi16(_mm_unpacklo_epi8(x, zero), offset),
+			_mm_sub_epi16(_mm_unpackhi_epi8(x, zero), offset)};
+		for (unsigned h = 0; h < 2; ++h) {
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(halves[h], halves[h]), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(halves[h], halves[h]), 16);
+			_mm_storeu_ps(out + i + 8 * h, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			_mm_storeu_ps(out + i + 8 * h + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+	}
+#elif defined(SAMPLE_CONVERT_NEON)
+	for (; i + 8 <= n; i += 8) {
+		int16x8_t x = vreinterpretq_s16_u16(vsubq_u16(vmovl_u8(vld1_u8(in + i)), vdupq_n_u16(128)));
+		vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), kScaleU8));
+		vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), kScaleU8));
+	}
+#endif
+	for (; i < n; ++i) {
+		out[i] = static_cast<float>(static_cast<int>(in[i]) - 128) * kScaleU8;
+	}
+}
+
+void floatToPcm16(const float * in, size_t n, int16_t * out) {
+	size_t i = 0;
+#if defined(SAMPLE_CONVERT_SSE2)
+	// Clamped before the conversion, out of range floats would turn into
+	// the integer indefinite value instead of saturating
+	const __m128 scale = _mm_set1_ps(32768.0f);
+	const __m128 low = _mm_set1_ps(-32768.0f);
+	const __m128 high = _mm_set1_ps(32767.0f);
+	for (; i + 8 <= n; i += 8) {
+		__m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), low), high);
+		__m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), low), high);
+		__m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), packed);
+	}
+#elif defined(SAMPLE_CONVERT_NEON)
+	for (; i + 8 <= n; i += 8) {
+		int32x4_t a = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + i), 32768.0f));
+		int32x4_t b = vcvtnq_s32_f32(vmulq_n_f32(vld1q_f32(in + i + 4), 32768.0f));
+		vst1q_s16(out + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+	}
+#endif
+	for (; i < n; ++i) {
+		float v = std::min(32767.0f, std::max(-32768.0f, in[i] * 32768.0f));
+		out[i] = static_cast<int16_t>(std::lrint(v));
+	}
+}
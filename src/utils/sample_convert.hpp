@@ -0,0 +1,23 @@
+#ifndef SAMPLE_CONVERT_HPP
+#define SAMPLE_CONVERT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Conversion between integer PCM samples and float samples in [-1, 1).
+// The loops run SSE2 (SSSE3 for the packed 24 bit input, picked at run
+// time) or NEON kernels and finish the tail with the scalar loop, which
+// gives the same results.
+
+void pcm16ToFloat(const int16_t * in, size_t n, float * out);
+// Packed little-endian 3 byte samples
+void pcm24ToFloat(const uint8_t * in, size_t n, float * out);
+void pcm32ToFloat(const int32_t * in, size_t n, float * out);
+// Unsigned 8 bit samples centered at 128, as stored in WAV files
+void pcmU8ToFloat(const uint8_t * in, size_t n, float * out);
+
+// Rounds to the nearest integer and saturates to the int16 range
+void floatToPcm16(const float * in, size_t n, int16_t * out);
+
+#endif
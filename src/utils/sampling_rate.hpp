@@ -0,0 +1,61 @@
+#ifndef SAMPLING_RATE_HPP
+#define SAMPLING_RATE_HPP
+
+#include <cstdint>
+#include <utility>
+
+#include <krisp-audio-sdk.hpp>
+
+
+// Every rate the SDK supports, in Hz
+static const uint32_t kKrispSamplingRates[] = {8000, 16000, 32000, 44100, 48000, 88200, 96000};
+
+// The SDK sampling rate of a rate in Hz, the second member is false when
+// the SDK does not support the rate
+inline std::pair<Krisp::AudioSdk::SamplingRate, bool> getKrispSamplingRate(uint32_t rate) {
+	using Krisp::AudioSdk::SamplingRate;
+	std::pair<SamplingRate, bool> result;
+	result.second = true;
+	switch (rate) {
+	case 8000:
+		result.first = SamplingRate::Sr8000Hz;
+		break;
+	case 16000:
+		result.first = SamplingRate::Sr16000Hz;
+		break;
+	case 32000:
+		result.first = SamplingRate::Sr32000Hz;
+		break;
+	case 44100:
+		result.first = SamplingRate::Sr44100Hz;
+		break;
+	case 48000:
+		result.first = SamplingRate::Sr48000Hz;
+		break;
+	case 88200:
+		result.first = SamplingRate::Sr88200Hz;
+		break;
+	case 96000:
+		result.first = SamplingRate::Sr96000Hz;
+		break;
+	default:
+		result.second = false;
+		break;
+	}
+	return result;
+}
+
+// Nearest rate supported by the SDK, the higher one on a tie
+inline uint32_t getNearestKrispSamplingRate(uint32_t rate) {
+	uint32_t nearest = kKrispSamplingRates[0];
+	for (uint32_t supportedRate : kKrispSamplingRates) {
+		uint32_t distance = supportedRate > rate ? supportedRate - rate : rate - supportedRate;
+		uint32_t nearestDistance = nearest > rate ? nearest - rate : rate - nearest;
+		if (distance <= nearestDistance) {
+			nearest = supportedRate;
+		}
+	}
+	return nearest;
+}
+
+#endif
@@ -0,0 +1,151 @@
+#include "session_scheduler.hpp"
+
+
+SessionScheduler::SessionScheduler(unsigned nThreads, uint32_t nSessions, const RunFrame & runFrame,
+	const ThreadStart & threadStart) :
+	m_runFrame(runFrame),
+	m_threadStart(threadStart),
+	m_pending(new std::atomic<uint32_t>[nSessions]),
+	m_nQueued{0},
+	m_nOutstanding{0},
+	m_nIdle{0},
+	m_stop{false} {
+	for (uint32_t s = 0; s < nSessions; ++s) {
+		m_pending[s] = 0;
+	}
+	nThreads = nThreads != 0 ? nThreads : 1;
+	for (unsigned i = 0; i < nThreads; ++i) {
+		m_workers.emplace_back(new Worker());
+		m_workers.back()->stats = WorkerStats{};
+	}
+	for (unsigned i = 0; i < nThreads; ++i) {
+		m_threads.emplace_back(&SessionScheduler::workerLoop, this, i);
+	}
+}
+
+SessionScheduler::~SessionScheduler() {
+	{
+		std::lock_guard<std::mutex> lock(m_idleMutex);
+		m_stop = true;
+	}
+	m_idleCv.notify_all();
+	for (auto & thread : m_threads) {
+		thread.join();
+	}
+}
+
+unsigned SessionScheduler::size() const {
+	return static_cast<unsigned>(m_workers.size());
+}
+
+void SessionScheduler::push(unsigned worker, uint32_t session) {
+	{
+		std::lock_guard<std::mutex> lock(m_workers[worker]->mutex);
+		m_workers[worker]->queue.push_back(session);
+		++m_nQueued;
+	}
+	// An idle thread steals the session if this queue is busy
+	if (m_nIdle != 0) {
+		std::lock_guard<std::mutex> lock(m_idleMutex);
+		m_idleCv.notify_one();
+	}
+}
+
+bool SessionScheduler::pop(unsigned worker, uint32_t & session) {
+	Worker & own = *m_workers[worker];
+	{
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.queue.empty()) {
+			session = own.queue.front();
+			own.queue.pop_front();
+			--m_nQueued;
+			return true;
+		}
+	}
+	// The victims are visited in order from the next thread, the end of
+	// their queue holds the sessions they would run last
+	const unsigned n = size();
+	for (unsigned k = 1; k < n; ++k) {
+		Worker & victim = *m_workers[(worker + k) % n];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.queue.empty()) {
+			session = victim.queue.back();
+			victim.queue.pop_back();
+			--m_nQueued;
+			++own.stats.nSteals;
+			return true;
+		}
+	}
+	return false;
+}
+
+void SessionScheduler::workerLoop(unsigned index) {
+	Worker & own = *m_workers[index];
+	if (m_threadStart) {
+		m_threadStart(index);
+	}
+	for (;;) {
+		uint32_t session;
+		if (!pop(index, session)) {
+			std::unique_lock<std::mutex> lock(m_idleMutex);
+			++m_nIdle;
+			m_idleCv.wait(lock, [&]() { return m_stop || m_nQueued != 0; });
+			--m_nIdle;
+			if (m_stop) {
+				return;
+			}
+			continue;
+		}
+
+		uint64_t nDone = 1;
+		try {
+			m_runFrame(index, session);
+			++own.stats.nFrames;
+			if (m_pending[session].fetch_sub(1) > 1) {
+				push(index, session);
+			}
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(m_idleMutex);
+			if (!m_error) {
+				m_error = std::current_exception();
+			}
+			nDone = m_pending[session].exchange(0);
+		}
+		if (m_nOutstanding.fetch_sub(nDone) == nDone) {
+			std::lock_guard<std::mutex> lock(m_idleMutex);
+			m_doneCv.notify_all();
+		}
+	}
+}
+
+void SessionScheduler::submit(uint32_t session) {
+	++m_nOutstanding;
+	if (m_pending[session].fetch_add(1) == 0) {
+		push(session % size(), session);
+	}
+}
+
+void SessionScheduler::wait() {
+	std::unique_lock<std::mutex> lock(m_idleMutex);
+	m_doneCv.wait(lock, [&]() { return m_nOutstanding == 0; });
+	std::exception_ptr error = m_error;
+	m_error = nullptr;
+	lock.unlock();
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+std::vector<SessionScheduler::WorkerStats> SessionScheduler::getStats() const {
+	std::vector<WorkerStats> stats;
+	for (const auto & worker : m_workers) {
+		stats.push_back(worker->stats);
+	}
+	return stats;
+}
+
+void SessionScheduler::resetStats() {
+	for (auto & worker : m_workers) {
+		worker->stats = WorkerStats{};
+	}
+}
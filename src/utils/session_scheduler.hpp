@@ -0,0 +1,81 @@
+#ifndef SESSION_SCHEDULER_HPP
+#define SESSION_SCHEDULER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Runs the frames of many stateful sessions on a fixed set of threads.
+// submit() tells that one more frame of a session is ready, the caller
+// keeps the frames and runFrame(worker, session) processes the oldest one.
+// A session is in at most one queue at a time and runs on one thread at a
+// time, so its frames are processed in order. Every thread owns a queue:
+// it takes the sessions from the front of its own queue, puts a session
+// with more ready frames back at the end after one frame, and steals from
+// the end of another queue when its own is empty.
+class SessionScheduler {
+public:
+	using RunFrame = std::function<void(unsigned worker, uint32_t session)>;
+	// Runs first on every thread, to pin it for instance
+	using ThreadStart = std::function<void(unsigned worker)>;
+
+	struct WorkerStats {
+		uint64_t nFrames;
+		uint64_t nSteals; // sessions taken from the queue of another thread
+	};
+
+private:
+	struct Worker {
+		std::mutex mutex;
+		std::deque<uint32_t> queue;
+		WorkerStats stats;
+	};
+
+	RunFrame m_runFrame;
+	ThreadStart m_threadStart;
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::vector<std::thread> m_threads;
+	// Ready frames per session, the session is queued while it is not 0
+	std::unique_ptr<std::atomic<uint32_t>[]> m_pending;
+	std::atomic<uint64_t> m_nQueued;      // sessions in the queues
+	std::atomic<uint64_t> m_nOutstanding; // frames submitted and not processed yet
+	std::atomic<unsigned> m_nIdle;
+	std::atomic<bool> m_stop;
+	std::mutex m_idleMutex;
+	std::condition_variable m_idleCv;
+	std::condition_variable m_doneCv;
+	std::exception_ptr m_error;
+
+	void push(unsigned worker, uint32_t session);
+	bool pop(unsigned worker, uint32_t & session);
+	void workerLoop(unsigned index);
+
+public:
+	SessionScheduler(unsigned nThreads, uint32_t nSessions, const RunFrame & runFrame,
+		const ThreadStart & threadStart = nullptr);
+	~SessionScheduler();
+	SessionScheduler(const SessionScheduler &) = delete;
+	SessionScheduler & operator=(const SessionScheduler &) = delete;
+
+	unsigned size() const;
+
+	// Safe to call from any thread, the session starts on the thread the
+	// session number maps to when it is not queued yet
+	void submit(uint32_t session);
+	// Waits until every submitted frame is processed. The first exception
+	// thrown by runFrame is rethrown here, the session that threw is dropped.
+	void wait();
+	// Read after wait()
+	std::vector<WorkerStats> getStats() const;
+	void resetStats();
+};
+
+#endif
@@ -1,29 +1,241 @@
 #include "sound_file.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "sample_convert.hpp"
+
 
 SoundFileFormat SoundFileHeader::getFormat() const {
-	switch (m_info.format) {
-	case (SF_FORMAT_WAV | SF_FORMAT_PCM_16):
+	const int container = m_info.format & SF_FORMAT_TYPEMASK;
+	const int subtype = m_info.format & SF_FORMAT_SUBMASK;
+	if (container == SF_FORMAT_OGG) {
+		return subtype == SF_FORMAT_VORBIS || subtype == SF_FORMAT_OPUS ?
+			SoundFileFormat::FLOAT : SoundFileFormat::UNSUPPORTED;
+	}
+	if (container != SF_FORMAT_WAV && container != SF_FORMAT_FLAC) {
+		return SoundFileFormat::UNSUPPORTED;
+	}
+	switch (subtype) {
+	case SF_FORMAT_PCM_16:
 		return SoundFileFormat::PCM16;
-	case (SF_FORMAT_WAV | SF_FORMAT_FLOAT):
+	case SF_FORMAT_FLOAT:
 		return SoundFileFormat::FLOAT;
+	case SF_FORMAT_PCM_24:
+		return SoundFileFormat::PCM24;
+	case SF_FORMAT_PCM_32:
+		return SoundFileFormat::PCM32;
+	case SF_FORMAT_PCM_U8:
+	case SF_FORMAT_PCM_S8:
+		return SoundFileFormat::PCMU8;
 	default:
 		return SoundFileFormat::UNSUPPORTED;
 	}
 }
 
+SoundFileContainer SoundFileHeader::getContainer() const {
+	switch (m_info.format & SF_FORMAT_TYPEMASK) {
+	case SF_FORMAT_FLAC:
+		return SoundFileContainer::FLAC;
+	case SF_FORMAT_OGG:
+		return (m_info.format & SF_FORMAT_SUBMASK) == SF_FORMAT_OPUS ?
+			SoundFileContainer::OPUS : SoundFileContainer::VORBIS;
+	default:
+		return SoundFileContainer::WAV;
+	}
+}
+
+static std::string getExtension(const std::string & filePath) {
+	const size_t dot = filePath.find_last_of('.');
+	const size_t slash = filePath.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+		return std::string();
+	}
+	std::string extension = filePath.substr(dot);
+	std::transform(extension.begin(), extension.end(), extension.begin(),
+		[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return extension;
+}
+
+SoundFileContainer getContainerForPath(const std::string & filePath) {
+	const std::string extension = getExtension(filePath);
+	if (extension == ".flac") {
+		return SoundFileContainer::FLAC;
+	}
+	if (extension == ".ogg" || extension == ".oga") {
+		return SoundFileContainer::VORBIS;
+	}
+	if (extension == ".opus") {
+		return SoundFileContainer::OPUS;
+	}
+	return SoundFileContainer::WAV;
+}
+
+bool hasSoundFileExtension(const std::string & filePath) {
+	return getExtension(filePath) == ".wav" ||
+		getContainerForPath(filePath) != SoundFileContainer::WAV;
+}
+
+const char * getContainerName(SoundFileContainer container) {
+	switch (container) {
+	case SoundFileContainer::FLAC:
+		return "FLAC";
+	case SoundFileContainer::VORBIS:
+		return "Ogg Vorbis";
+	case SoundFileContainer::OPUS:
+		return "Ogg Opus";
+	default:
+		return "WAV";
+	}
+}
+
+bool isIntegerPcm(SoundFileFormat format) {
+	return format == SoundFileFormat::PCM24 || format == SoundFileFormat::PCM32 ||
+		format == SoundFileFormat::PCMU8;
+}
+
+// The decoded chunks travel from the read-ahead thread to the reader and
+// back through the free list
+struct SoundFile::ReadAhead {
+	struct Chunk {
+		std::vector<uint8_t> bytes;
+		size_t nBytes;
+		size_t pos; // bytes already taken by the reader
+	};
+
+	size_t frameBytes;
+	size_t chunkFrames;
+	bool pcm16; // int16 samples, float otherwise
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<Chunk> filled;
+	std::vector<Chunk> free;
+	bool end;
+	bool error;
+	bool stop;
+};
+
 SoundFile::SoundFile() :
 	m_sfHandle{nullptr},
 	m_hasError{false},
-	m_errorMsg() {
+	m_errorMsg(),
+	m_background{false} {
 }
 
 SoundFile::~SoundFile() {
+	stopReadAhead();
 	if (m_sfHandle) {
 		sf_close(m_sfHandle);
 	}
 }
 
+void SoundFile::setBackground(bool background) {
+	m_background = background;
+}
+
+void SoundFile::startReadAhead() {
+	const unsigned channels = m_sfHeader.getNumberOfChannels();
+	m_readAhead.reset(new ReadAhead());
+	ReadAhead & ahead = *m_readAhead;
+	ahead.pcm16 = m_sfHeader.getFormat() == SoundFileFormat::PCM16;
+	ahead.frameBytes = channels * (ahead.pcm16 ? sizeof(int16_t) : sizeof(float));
+	ahead.chunkFrames = std::max<size_t>(1, kChunkBytes / ahead.frameBytes);
+	ahead.end = false;
+	ahead.error = false;
+	ahead.stop = false;
+	ahead.thread = std::thread(&SoundFile::readAheadLoop, this);
+}
+
+void SoundFile::stopReadAhead() {
+	if (!m_readAhead) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_readAhead->mutex);
+		m_readAhead->stop = true;
+	}
+	m_readAhead->cv.notify_all();
+	m_readAhead->thread.join();
+	m_readAhead.reset();
+}
+
+void SoundFile::readAheadLoop() {
+	ReadAhead & ahead = *m_readAhead;
+	const unsigned channels = m_sfHeader.getNumberOfChannels();
+	const sf_count_t chunkFrames = static_cast<sf_count_t>(ahead.chunkFrames);
+	const bool intPcm = !ahead.pcm16 && m_sfHeader.getFormat() != SoundFileFormat::FLOAT;
+	std::vector<int32_t> intFrames(intPcm ? ahead.chunkFrames * channels : 0);
+	std::unique_lock<std::mutex> lock(ahead.mutex);
+	for (;;) {
+		ahead.cv.wait(lock, [&]() { return ahead.filled.size() < kMaxChunks || ahead.stop; });
+		if (ahead.stop) {
+			return;
+		}
+		ReadAhead::Chunk chunk;
+		if (ahead.free.empty()) {
+			chunk.bytes.resize(ahead.chunkFrames * ahead.frameBytes);
+		} else {
+			chunk = std::move(ahead.free.back());
+			ahead.free.pop_back();
+		}
+		lock.unlock();
+
+		sf_count_t nRead;
+		if (ahead.pcm16) {
+			nRead = sf_readf_short(m_sfHandle, reinterpret_cast<short *>(chunk.bytes.data()), chunkFrames);
+		} else if (intPcm) {
+			// libsndfile returns every PCM width left-justified in 32 bits
+			nRead = sf_readf_int(m_sfHandle, intFrames.data(), chunkFrames);
+			pcm32ToFloat(intFrames.data(), static_cast<size_t>(std::max<sf_count_t>(nRead, 0)) * channels,
+				reinterpret_cast<float *>(chunk.bytes.data()));
+		} else {
+			nRead = sf_readf_float(m_sfHandle, reinterpret_cast<float *>(chunk.bytes.data()), chunkFrames);
+		}
+
+		lock.lock();
+		if (nRead <= 0) {
+			ahead.error = nRead < 0;
+			ahead.end = true;
+			ahead.cv.notify_all();
+			return;
+		}
+		chunk.nBytes = static_cast<size_t>(nRead) * ahead.frameBytes;
+		chunk.pos = 0;
+		ahead.filled.push_back(std::move(chunk));
+		ahead.cv.notify_all();
+	}
+}
+
+int64_t SoundFile::takeFrames(uint8_t * frames, int64_t nFrames) const {
+	ReadAhead & ahead = *m_readAhead;
+	size_t nBytes = static_cast<size_t>(nFrames) * ahead.frameBytes;
+	size_t taken = 0;
+	std::unique_lock<std::mutex> lock(ahead.mutex);
+	while (taken < nBytes) {
+		ahead.cv.wait(lock, [&]() { return !ahead.filled.empty() || ahead.end; });
+		if (ahead.filled.empty()) {
+			break;
+		}
+		ReadAhead::Chunk & chunk = ahead.filled.front();
+		const size_t n = std::min(nBytes - taken, chunk.nBytes - chunk.pos);
+		std::memcpy(frames + taken, chunk.bytes.data() + chunk.pos, n);
+		chunk.pos += n;
+		taken += n;
+		if (chunk.pos == chunk.nBytes) {
+			ahead.free.push_back(std::move(chunk));
+			ahead.filled.pop_front();
+			ahead.cv.notify_all();
+		}
+	}
+	if (ahead.error && ahead.filled.empty()) {
+		lock.unlock();
+		setError("Failed to read frames from the sound file.");
+	}
+	return static_cast<int64_t>(taken / ahead.frameBytes);
+}
+
 void SoundFile::setError(const std::string & errorMsg) const {
 	m_hasError = true;
 	m_errorMsg = errorMsg;
@@ -42,6 +254,7 @@ const SoundFileHeader & SoundFile::getHeader() const {
 }
 
 void SoundFile::loadHeader(const std::string & filePath) {
+	stopReadAhead();
 	if (m_sfHandle) {
 		if (sf_close(m_sfHandle) != 0) {
 			setError("Failed to close the sound file handle.");
@@ -55,92 +268,344 @@ void SoundFile::loadHeader(const std::string & filePath) {
 		setError("Failed to open the file: " + filePath);
 	}
 	m_sfHeader = SoundFileHeader(sfInfo);
+	if (m_sfHandle && m_background && m_sfHeader.getFormat() != SoundFileFormat::UNSUPPORTED) {
+		startReadAhead();
+	}
 }
 
-void SoundFile::readAllFramesPCM16(std::vector<int16_t> * frames) const {
+int64_t SoundFile::readFramesPCM16(int16_t * frames, int64_t nFrames) const {
 	if (m_sfHeader.getFormat() != SoundFileFormat::PCM16) {
-		setError("The file header format is not set to WAV PCM16.");
-		return;
+		setError("The file header format is not set to PCM16.");
+		return 0;
 	}
-	this->readAllFramesTmpl(frames);
+	if (m_readAhead) {
+		return takeFrames(reinterpret_cast<uint8_t *>(frames), nFrames);
+	}
+	return this->readFramesTmpl(frames, nFrames);
 }
 
-void SoundFile::readAllFramesFloat(std::vector<float> * frames) const {
-	if (m_sfHeader.getFormat() != SoundFileFormat::FLOAT) {
-		setError("The file header format is not set to WAV FLOAT.");
-		return;
+int64_t SoundFile::readFramesFloat(float * frames, int64_t nFrames) const {
+	SoundFileFormat format = m_sfHeader.getFormat();
+	if (m_readAhead && format == SoundFileFormat::PCM16) {
+		size_t nSamples = static_cast<size_t>(nFrames) * m_sfHeader.getNumberOfChannels();
+		if (m_pcm16Frames.size() < nSamples) {
+			m_pcm16Frames.resize(nSamples);
+		}
+		int64_t nFramesRead = takeFrames(reinterpret_cast<uint8_t *>(m_pcm16Frames.data()), nFrames);
+		pcm16ToFloat(m_pcm16Frames.data(),
+			static_cast<size_t>(nFramesRead) * m_sfHeader.getNumberOfChannels(), frames);
+		return nFramesRead;
+	}
+	if (m_readAhead) {
+		return takeFrames(reinterpret_cast<uint8_t *>(frames), nFrames);
+	}
+	if (format == SoundFileFormat::FLOAT) {
+		return this->readFramesTmpl(frames, nFrames);
+	}
+	if (format == SoundFileFormat::UNSUPPORTED) {
+		setError("The file header format is not set to a PCM or FLOAT format.");
+		return 0;
+	}
+	// libsndfile returns every PCM width left-justified in 32 bits
+	size_t nSamples = static_cast<size_t>(nFrames) * m_sfHeader.getNumberOfChannels();
+	if (m_intFrames.size() < nSamples) {
+		m_intFrames.resize(nSamples);
 	}
-	this->readAllFramesTmpl(frames);
+	int64_t nFramesRead = this->readFramesTmpl(m_intFrames.data(), nFrames);
+	pcm32ToFloat(m_intFrames.data(),
+		static_cast<size_t>(nFramesRead) * m_sfHeader.getNumberOfChannels(), frames);
+	return nFramesRead;
 }
 
 static int64_t sf_read(SNDFILE *sfHandle, short *frames, int64_t nFrames) {
-	return sf_read_short(sfHandle, frames, nFrames);
+	return sf_readf_short(sfHandle, frames, nFrames);
+}
+
+static int64_t sf_read(SNDFILE *sfHandle, int32_t *frames, int64_t nFrames) {
+	return sf_readf_int(sfHandle, frames, nFrames);
 }
 
 static int64_t sf_read(SNDFILE *sfHandle, float *frames, int64_t nFrames) {
-	return sf_read_float(sfHandle, frames, nFrames);
+	return sf_readf_float(sfHandle, frames, nFrames);
 }
 
 template <class T>
-inline void SoundFile::readAllFramesTmpl(std::vector<T> * frames) const {
-	int64_t nFrames = m_sfHeader.getNumberOfFrames();
-	frames->resize(static_cast<size_t>(nFrames));
+inline int64_t SoundFile::readFramesTmpl(T * frames, int64_t nFrames) const {
+	if (m_sfHandle == nullptr) {
+		setError("The sound file is not open.");
+		return 0;
+	}
+	int64_t nFramesRead = sf_read(m_sfHandle, frames, nFrames);
+	if (nFramesRead < 0) {
+		setError("Failed to read frames from the sound file.");
+		return 0;
+	}
+	return nFramesRead;
+}
 
-	int64_t nFramesRead = sf_read(m_sfHandle, frames->data(), nFrames);
+static int64_t sf_write(SNDFILE *sfHandle, const short *frames, int64_t nFrames) {
+	return sf_writef_short(sfHandle, frames, nFrames);
+}
+
+static int64_t sf_write(SNDFILE *sfHandle, const float *frames, int64_t nFrames) {
+	return sf_writef_float(sfHandle, frames, nFrames);
+}
 
-	if (nFrames != nFramesRead) {
-		setError("The number of read frames does not match the header record.");
+// Sample format as stored, the writer passes int16 for PCM16 and float
+// for the others
+static int getSfInfoFormat(SoundFileContainer container, SoundFileFormat format) {
+	if (format == SoundFileFormat::UNSUPPORTED) {
+		return 0;
+	}
+	switch (container) {
+	case SoundFileContainer::FLAC:
+		return SF_FORMAT_FLAC | (format == SoundFileFormat::PCM16 ? SF_FORMAT_PCM_16 : SF_FORMAT_PCM_24);
+	case SoundFileContainer::VORBIS:
+		return SF_FORMAT_OGG | SF_FORMAT_VORBIS;
+	case SoundFileContainer::OPUS:
+		return SF_FORMAT_OGG | SF_FORMAT_OPUS;
+	default:
+		break;
+	}
+	switch (format) {
+	case SoundFileFormat::PCM16:
+		return SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+	case SoundFileFormat::FLOAT:
+		return SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+	case SoundFileFormat::PCM24:
+		return SF_FORMAT_WAV | SF_FORMAT_PCM_24;
+	case SoundFileFormat::PCM32:
+		return SF_FORMAT_WAV | SF_FORMAT_PCM_32;
+	case SoundFileFormat::PCMU8:
+		return SF_FORMAT_WAV | SF_FORMAT_PCM_U8;
+	default:
+		return 0;
 	}
 }
 
-static int64_t sf_write(SNDFILE *sfHandle, short *frames, int64_t nFrames) {
-	return sf_write_short(sfHandle, frames, nFrames);
+SoundFileWriter::SoundFileWriter() :
+	m_sfHandle{nullptr},
+	m_format{SoundFileFormat::UNSUPPORTED},
+	m_hasError{false},
+	m_errorMsg(),
+	m_channels{0},
+	m_background{true},
+	m_fsync{false},
+	m_chunkFill{0},
+	m_chunkBytes{0},
+	m_closing{false},
+	m_threadError{false} {
+}
+
+SoundFileWriter::~SoundFileWriter() {
+	close();
+}
+
+void SoundFileWriter::setError(const std::string & errorMsg) {
+	m_hasError = true;
+	m_errorMsg = errorMsg;
 }
 
-static int64_t sf_write(SNDFILE *sfHandle, float *frames, int64_t nFrames) {
-	return sf_write_float(sfHandle, frames, nFrames);
+bool SoundFileWriter::getHasError() const {
+	return m_hasError;
 }
 
-template <typename SamplingFormat, int sfInfoFormat>
-std::pair<bool, std::string> writeFramesTmpl(
-	const std::string & fileName, 
-	const std::vector<SamplingFormat> & frames,
-	unsigned samplingRate)
-{
-	if (frames.empty()) {
-		return std::pair<bool, std::string>(false, "Frame container is empty.");
+std::string SoundFileWriter::getErrorMsg() const {
+	return m_errorMsg;
+}
+
+void SoundFileWriter::setBackground(bool background) {
+	m_background = background;
+}
+
+void SoundFileWriter::setFsync(bool fsync) {
+	m_fsync = fsync;
+}
+
+void SoundFileWriter::open(const std::string & filePath,
+		unsigned samplingRate, SoundFileFormat format, unsigned channels) {
+	close();
+	const SoundFileContainer container = getContainerForPath(filePath);
+	int sfInfoFormat = getSfInfoFormat(container, format);
+	if (sfInfoFormat == 0) {
+		setError("The output format should be PCM or FLOAT.");
+		return;
+	}
+	if (channels == 0) {
+		setError("The output file needs at least one channel.");
+		return;
 	}
-	SF_INFO sfinfo;
-	sfinfo.frames = static_cast<sf_count_t>(frames.size());
+	SF_INFO sfinfo{};
 	sfinfo.samplerate = static_cast<int>(samplingRate);
-	sfinfo.channels = 1;
+	sfinfo.channels = static_cast<int>(channels);
 	sfinfo.format = sfInfoFormat;
-	SNDFILE *sfHandle = sf_open(fileName.c_str(), SFM_WRITE, &sfinfo);
-	if (sfHandle == nullptr) {
-		return std::pair<bool, std::string>(false,
-			"Error open file for writing: " + fileName); 
-	}
-	sf_write(sfHandle, const_cast<SamplingFormat *>(frames.data()),
-		static_cast<int64_t>(frames.size()));
-	sf_write_sync(sfHandle);
-	sf_close(sfHandle);
-	return std::pair<bool, std::string>(true, "");
-}
-
-std::pair<bool, std::string> writeSoundFilePCM16(
-	const std::string & fileName,
-	const std::vector<int16_t> & frames,
-	unsigned samplingRate)
-{
-	constexpr int format = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
-	return writeFramesTmpl<int16_t, format>(fileName, frames, samplingRate);
-}
-
-std::pair<bool, std::string> writeSoundFileFloat(
-		const std::string & fileName,
-		const std::vector<float> & frames,
-		unsigned samplingRate)
-{
-	constexpr int format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
-	return writeFramesTmpl<float, format>(fileName, frames, samplingRate);
+	if (!sf_format_check(&sfinfo)) {
+		setError(std::string(getContainerName(container)) + " output is not supported at " +
+			std::to_string(samplingRate) + " Hz with " + std::to_string(channels) + " channels" +
+			(container == SoundFileContainer::OPUS ? ", Opus supports 8, 12, 16, 24 and 48 kHz" : ""));
+		return;
+	}
+	m_sfHandle = sf_open(filePath.c_str(), SFM_WRITE, &sfinfo);
+	if (m_sfHandle == nullptr) {
+		setError("Error open file for writing: " + filePath);
+		return;
+	}
+	const int subtype = sfInfoFormat & SF_FORMAT_SUBMASK;
+	const bool floatStorage = subtype == SF_FORMAT_FLOAT || subtype == SF_FORMAT_VORBIS ||
+		subtype == SF_FORMAT_OPUS;
+	if (format != SoundFileFormat::PCM16 && !floatStorage) {
+		// Saturate the float samples instead of wrapping around
+		sf_command(m_sfHandle, SFC_SET_CLIPPING, nullptr, SF_TRUE);
+	}
+	m_format = format;
+	m_channels = channels;
+	if (m_background) {
+		// PCM16 files are written from int16 samples, the others from float
+		const size_t frameBytes = channels * (format == SoundFileFormat::PCM16 ? sizeof(int16_t) : sizeof(float));
+		m_chunkBytes = std::max<size_t>(1, kChunkBytes / frameBytes) * frameBytes;
+		m_chunk.resize(m_chunkBytes);
+		m_chunkFill = 0;
+		m_closing = false;
+		m_threadError = false;
+		m_thread = std::thread(&SoundFileWriter::threadLoop, this);
+	}
+}
+
+void SoundFileWriter::writeFramesPCM16(const int16_t * frames,
+		int64_t nFrames) {
+	if (m_format != SoundFileFormat::PCM16) {
+		setError("The output file is not opened as WAV PCM16.");
+		return;
+	}
+	this->writeFramesTmpl(frames, nFrames);
+}
+
+void SoundFileWriter::writeFramesFloat(const float * frames,
+		int64_t nFrames) {
+	if (m_format == SoundFileFormat::UNSUPPORTED) {
+		setError("The output file is not open.");
+		return;
+	}
+	if (m_format == SoundFileFormat::PCM16) {
+		size_t nSamples = static_cast<size_t>(nFrames) * m_channels;
+		if (m_pcm16Frames.size() < nSamples) {
+			m_pcm16Frames.resize(nSamples);
+		}
+		floatToPcm16(frames, nSamples, m_pcm16Frames.data());
+		this->writeFramesTmpl(static_cast<const int16_t *>(m_pcm16Frames.data()), nFrames);
+		return;
+	}
+	this->writeFramesTmpl(frames, nFrames);
+}
+
+template <class T>
+inline void SoundFileWriter::writeFramesTmpl(const T * frames,
+		int64_t nFrames) {
+	if (m_sfHandle == nullptr) {
+		setError("The output file is not open.");
+		return;
+	}
+	if (m_thread.joinable()) {
+		appendToChunk(reinterpret_cast<const uint8_t *>(frames),
+			static_cast<size_t>(nFrames) * m_channels * sizeof(T));
+		return;
+	}
+	if (sf_write(m_sfHandle, frames, nFrames) != nFrames) {
+		setError("Failed to write frames to the output file.");
+	}
+}
+
+void SoundFileWriter::appendToChunk(const uint8_t * data, size_t nBytes) {
+	while (nBytes > 0) {
+		size_t n = std::min(nBytes, m_chunkBytes - m_chunkFill);
+		std::memcpy(m_chunk.data() + m_chunkFill, data, n);
+		m_chunkFill += n;
+		data += n;
+		nBytes -= n;
+		if (m_chunkFill == m_chunkBytes) {
+			submitChunk();
+		}
+	}
+}
+
+void SoundFileWriter::submitChunk() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cv.wait(lock, [&]() { return m_pending.size() < kMaxChunks || m_threadError; });
+	if (m_threadError) {
+		lock.unlock();
+		setError("Failed to write frames to the output file.");
+		m_chunkFill = 0;
+		return;
+	}
+	m_pending.emplace_back(std::move(m_chunk), m_chunkFill);
+	if (m_freeChunks.empty()) {
+		m_chunk = std::vector<uint8_t>(m_chunkBytes);
+	} else {
+		m_chunk = std::move(m_freeChunks.back());
+		m_freeChunks.pop_back();
+	}
+	m_chunkFill = 0;
+	lock.unlock();
+	m_cv.notify_all();
+}
+
+bool SoundFileWriter::writeChunk(const uint8_t * data, size_t nBytes) {
+	if (m_format == SoundFileFormat::PCM16) {
+		int64_t nFrames = static_cast<int64_t>(nBytes / (sizeof(int16_t) * m_channels));
+		return sf_write(m_sfHandle, reinterpret_cast<const short *>(data), nFrames) == nFrames;
+	}
+	int64_t nFrames = static_cast<int64_t>(nBytes / (sizeof(float) * m_channels));
+	return sf_write(m_sfHandle, reinterpret_cast<const float *>(data), nFrames) == nFrames;
+}
+
+void SoundFileWriter::threadLoop() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		m_cv.wait(lock, [&]() { return !m_pending.empty() || m_closing; });
+		if (m_pending.empty()) {
+			return;
+		}
+		std::pair<std::vector<uint8_t>, size_t> chunk = std::move(m_pending.front());
+		m_pending.pop_front();
+		lock.unlock();
+		// After a failure the chunks are dropped, the caller gets the error
+		bool written = m_threadError || writeChunk(chunk.first.data(), chunk.second);
+		lock.lock();
+		m_threadError = m_threadError || !written;
+		m_freeChunks.push_back(std::move(chunk.first));
+		m_cv.notify_all();
+	}
+}
+
+void SoundFileWriter::close() {
+	if (m_thread.joinable()) {
+		if (m_chunkFill > 0) {
+			submitChunk();
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_closing = true;
+		}
+		m_cv.notify_all();
+		m_thread.join();
+		if (m_threadError) {
+			setError("Failed to write frames to the output file.");
+		}
+		m_pending.clear();
+		m_freeChunks.clear();
+		m_chunk.clear();
+		m_chunk.shrink_to_fit();
+	}
+	if (m_sfHandle) {
+		// Durability is optional, a forced flush per file serializes batch
+		// runs on the disk
+		if (m_fsync) {
+			sf_write_sync(m_sfHandle);
+		}
+		if (sf_close(m_sfHandle) != 0) {
+			setError("Failed to close the output file handle.");
+		}
+		m_sfHandle = nullptr;
+	}
+	m_format = SoundFileFormat::UNSUPPORTED;
 }
@@ -3,7 +3,13 @@
 
 #include <sndfile.h>
 
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -11,9 +17,30 @@
 enum SoundFileFormat {
 	UNSUPPORTED = 0,
 	PCM16 = 1,
-	FLOAT = 2
+	FLOAT = 2,
+	PCM24 = 3,
+	PCM32 = 4,
+	PCMU8 = 5 // 8 bit PCM, unsigned in WAV and signed in FLAC
 };
 
+// The integer PCM formats other than PCM16 are processed as float
+bool isIntegerPcm(SoundFileFormat format);
+
+// Files are read and written through the codecs of libsndfile. Vorbis and
+// Opus are decoded as FLOAT.
+enum class SoundFileContainer {
+	WAV,
+	FLAC,
+	VORBIS, // Ogg Vorbis
+	OPUS    // Ogg Opus
+};
+
+// From the file name extension: .flac, .ogg or .oga, .opus, WAV otherwise
+SoundFileContainer getContainerForPath(const std::string & filePath);
+// .wav or one of the extensions above
+bool hasSoundFileExtension(const std::string & filePath);
+const char * getContainerName(SoundFileContainer container);
+
 
 class SoundFileHeader {
 private:
@@ -33,42 +60,130 @@ public:
 		return static_cast<unsigned>(m_info.samplerate);
 	}
 	SoundFileFormat getFormat() const;
+	SoundFileContainer getContainer() const;
 };
 
 
+// Sequential reader. With setBackground(true) a thread decodes the file
+// ahead of the caller in chunks of about kChunkBytes, at most kMaxChunks
+// chunks ahead, so the codec time of compressed input overlaps the
+// processing. PCM16 files are decoded to int16, the others to float.
 class SoundFile {
+public:
+	static constexpr size_t kChunkBytes = 1 << 20;
+	static constexpr size_t kMaxChunks = 4;
+
 private:
+	struct ReadAhead;
+
 	SNDFILE* m_sfHandle;
 	SoundFileHeader m_sfHeader;
 	mutable bool m_hasError;
 	mutable std::string m_errorMsg;
+	mutable std::vector<int32_t> m_intFrames;
+	mutable std::vector<int16_t> m_pcm16Frames;
+	bool m_background;
+	std::unique_ptr<ReadAhead> m_readAhead;
 
 	void setError(const std::string & errorMsg) const;
 
 	template <class T>
-	void readAllFramesTmpl(std::vector<T> *) const;
+	int64_t readFramesTmpl(T * frames, int64_t nFrames) const;
+	void startReadAhead();
+	void stopReadAhead();
+	void readAheadLoop();
+	int64_t takeFrames(uint8_t * frames, int64_t nFrames) const;
 
 public:
 	SoundFile();
 	~SoundFile();
+	SoundFile(const SoundFile &) = delete;
+	SoundFile & operator=(const SoundFile &) = delete;
 
 	bool getHasError() const;
 	std::string getErrorMsg() const;
 	const SoundFileHeader & getHeader() const;
+	// Set before loadHeader(), off by default
+	void setBackground(bool background);
 	void loadHeader(const std::string & filePath);
-	void readAllFramesPCM16(std::vector<int16_t> * frames) const;
-	void readAllFramesFloat(std::vector<float> * frames) const;
+
+	// Read up to nFrames frames from the current position into the caller
+	// owned buffer of nFrames * channels interleaved samples.
+	// Returns the number of frames read, 0 at the end of file.
+	int64_t readFramesPCM16(int16_t * frames, int64_t nFrames) const;
+	// Any integer PCM format is converted to float in [-1, 1)
+	int64_t readFramesFloat(float * frames, int64_t nFrames) const;
 };
 
 
-std::pair<bool, std::string> writeSoundFilePCM16(
-	const std::string & file,
-	const std::vector<int16_t> & frames,
-	unsigned samplingRate);
+// Incremental writer, the frames are appended to the file as they are
+// produced so the caller never has to keep the whole stream in memory.
+// The container follows the extension of the file name, see
+// getContainerForPath(). FLAC stores 16 or 24 bit PCM: PCM16 stays 16 bit
+// and the other formats are written as 24 bit.
+// By default the frames are copied into large chunks that a background
+// thread appends to the file, so the disk writes overlap the processing,
+// and the caller waits only when kMaxChunks chunks are pending. The RIFF
+// header sizes are patched when the file is closed. Compressed
+// containers are encoded on that thread as well.
+class SoundFileWriter {
+public:
+	static constexpr size_t kChunkBytes = 1 << 20;
+	static constexpr size_t kMaxChunks = 4;
 
-std::pair<bool, std::string> writeSoundFileFloat(
-	const std::string & file,
-	const std::vector<float> & frames,
-	unsigned samplingRate);
+private:
+	SNDFILE* m_sfHandle;
+	SoundFileFormat m_format;
+	bool m_hasError;
+	std::string m_errorMsg;
+	std::vector<int16_t> m_pcm16Frames;
+	unsigned m_channels;
+	bool m_background;
+	bool m_fsync;
+
+	// The chunk being filled by the caller, whole sample frames only
+	std::vector<uint8_t> m_chunk;
+	size_t m_chunkFill;
+	size_t m_chunkBytes;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::deque<std::pair<std::vector<uint8_t>, size_t>> m_pending;
+	std::vector<std::vector<uint8_t>> m_freeChunks;
+	bool m_closing;
+	bool m_threadError;
+
+	void setError(const std::string & errorMsg);
+
+	template <class T>
+	void writeFramesTmpl(const T * frames, int64_t nFrames);
+	void appendToChunk(const uint8_t * data, size_t nBytes);
+	void submitChunk();
+	bool writeChunk(const uint8_t * data, size_t nBytes);
+	void threadLoop();
+
+public:
+	SoundFileWriter();
+	~SoundFileWriter();
+	SoundFileWriter(const SoundFileWriter &) = delete;
+	SoundFileWriter & operator=(const SoundFileWriter &) = delete;
+
+	bool getHasError() const;
+	std::string getErrorMsg() const;
+	// Set before open(). Without the background thread every write goes
+	// to libsndfile on the calling thread, for callers that already write
+	// on a thread of their own.
+	void setBackground(bool background);
+	// Flushes the file to the disk before closing it, off by default
+	void setFsync(bool fsync);
+	void open(const std::string & filePath, unsigned samplingRate,
+		SoundFileFormat format, unsigned channels = 1);
+	// frames holds nFrames * channels interleaved samples. Write errors of
+	// the background thread are reported by a later call or by close().
+	void writeFramesPCM16(const int16_t * frames, int64_t nFrames);
+	// Float frames can be written to any format, integer formats saturate
+	void writeFramesFloat(const float * frames, int64_t nFrames);
+	void close();
+};
 
 #endif
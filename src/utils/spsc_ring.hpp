@@ -0,0 +1,70 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+
+// Bounded lock-free ring for exactly one producer and one consumer thread.
+// The capacity is rounded up to a power of two.
+template <typename T>
+class SpscRing {
+private:
+	static constexpr size_t kCacheLine = 64;
+
+	std::vector<T> m_slots;
+	size_t m_mask;
+	alignas(kCacheLine) std::atomic<size_t> m_head; // next slot to pop
+	alignas(kCacheLine) std::atomic<size_t> m_tail; // next slot to push
+
+	static size_t roundUpPow2(size_t n) {
+		size_t r = 1;
+		while (r < n) {
+			r <<= 1;
+		}
+		return r;
+	}
+
+public:
+	explicit SpscRing(size_t capacity) :
+		m_slots(roundUpPow2(capacity)),
+		m_mask{m_slots.size() - 1},
+		m_head{0},
+		m_tail{0} {
+	}
+	SpscRing(const SpscRing &) = delete;
+	SpscRing & operator=(const SpscRing &) = delete;
+
+	size_t capacity() const {
+		return m_slots.size();
+	}
+
+	// Approximate when called concurrently with push or pop
+	size_t size() const {
+		return m_tail.load(std::memory_order_acquire) -
+			m_head.load(std::memory_order_acquire);
+	}
+
+	bool tryPush(const T & value) {
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == m_slots.size()) {
+			return false;
+		}
+		m_slots[tail & m_mask] = value;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool tryPop(T & value) {
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		value = m_slots[head & m_mask];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+#endif
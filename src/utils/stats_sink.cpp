@@ -0,0 +1,267 @@
+#include "stats_sink.hpp"
+
+#include <chrono>
+#include <cstring>
+
+
+// Frames and session records per chunk and number of chunks in flight
+static const size_t kChunkFrames = 8192;
+static const size_t kChunkSessions = 512;
+static const size_t kChunks = 4;
+
+static void backoff(unsigned spin) {
+	if (spin < 64) {
+		std::this_thread::yield();
+	} else {
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+}
+
+StatsSink::StatsSink() :
+	m_file{nullptr},
+	m_ownsFile{false},
+	m_format{StatsFormat::TEXT},
+	m_frameDurationMs{0},
+	m_channels{0},
+	m_chunks(kChunks),
+	m_free(kChunks),
+	m_filled(kChunks),
+	m_current{nullptr},
+	m_closing{false},
+	m_writeFailed{false},
+	m_finalSeen{false} {
+	for (auto & chunk : m_chunks) {
+		chunk.frame.resize(kChunkFrames);
+		chunk.channel.resize(kChunkFrames);
+		chunk.noiseEnergy.resize(kChunkFrames);
+		chunk.voiceEnergy.resize(kChunkFrames);
+		chunk.nFrames = 0;
+		chunk.sessionFrame.resize(kChunkSessions);
+		chunk.sessionChannel.resize(kChunkSessions);
+		chunk.sessionFinal.resize(kChunkSessions);
+		chunk.sessions.resize(kChunkSessions);
+		chunk.nSessions = 0;
+	}
+}
+
+StatsSink::~StatsSink() {
+	close();
+}
+
+StatsFormat StatsSink::getFormat(const std::string & path) {
+	if (path.empty()) {
+		return StatsFormat::TEXT;
+	}
+	const std::string csv = ".csv";
+	if (path.size() >= csv.size() &&
+			path.compare(path.size() - csv.size(), csv.size(), csv) == 0) {
+		return StatsFormat::CSV;
+	}
+	return StatsFormat::BINARY;
+}
+
+bool StatsSink::open(const std::string & path, unsigned frameDurationMs, unsigned channels) {
+	close();
+	m_errorMsg.clear();
+	m_format = getFormat(path);
+	if (path.empty()) {
+		m_file = stdout;
+		m_ownsFile = false;
+	} else {
+		m_file = std::fopen(path.c_str(), m_format == StatsFormat::BINARY ? "wb" : "w");
+		if (m_file == nullptr) {
+			m_errorMsg = "Failed to open the stats file: " + path;
+			return false;
+		}
+		m_ownsFile = true;
+		// The writer thread issues few large writes
+		std::setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+	}
+	m_frameDurationMs = frameDurationMs;
+	m_channels = channels;
+	m_finalSeen = false;
+	m_closing = false;
+	m_writeFailed = false;
+
+	if (m_format == StatsFormat::BINARY) {
+		const uint32_t header[4] = {kStatsVersion, frameDurationMs, channels, 0};
+		writeBytes(kStatsMagic, sizeof(kStatsMagic));
+		writeBytes(header, sizeof(header));
+	} else if (m_format == StatsFormat::CSV) {
+		std::fprintf(m_file, "# frame_duration_ms: %u, channels: %u\n", frameDurationMs, channels);
+		std::fputs("record,frame,channel,noise_energy,voice_energy,no_noise_ms,"
+			"low_noise_ms,medium_noise_ms,high_noise_ms,talk_time_ms\n", m_file);
+	}
+
+	for (auto & chunk : m_chunks) {
+		chunk.nFrames = 0;
+		chunk.nSessions = 0;
+		m_free.tryPush(&chunk);
+	}
+	m_free.tryPop(m_current);
+	m_writer = std::thread([this]() { writerLoop(); });
+	return true;
+}
+
+bool StatsSink::close() {
+	if (!m_file) {
+		return true;
+	}
+	if (m_current && (m_current->nFrames != 0 || m_current->nSessions != 0)) {
+		submit();
+	}
+	m_closing = true;
+	m_writer.join();
+	Chunk * chunk = nullptr;
+	while (m_free.tryPop(chunk)) {
+	}
+	m_current = nullptr;
+
+	bool ok = !m_writeFailed && std::fflush(m_file) == 0;
+	if (m_ownsFile && std::fclose(m_file) != 0) {
+		ok = false;
+	}
+	m_file = nullptr;
+	if (!ok) {
+		m_errorMsg = "Failed to write the stats file.";
+	}
+	return ok;
+}
+
+std::string StatsSink::getErrorMsg() const {
+	return m_errorMsg;
+}
+
+// Hands the current chunk to the writer and takes a free one
+void StatsSink::submit() {
+	for (unsigned spin = 0; !m_filled.tryPush(m_current); ++spin) {
+		backoff(spin);
+	}
+	for (unsigned spin = 0; !m_free.tryPop(m_current); ++spin) {
+		backoff(spin);
+	}
+}
+
+void StatsSink::writerLoop() {
+	Chunk * chunk = nullptr;
+	for (unsigned spin = 0;; ) {
+		if (m_filled.tryPop(chunk)) {
+			writeChunk(*chunk);
+			chunk->nFrames = 0;
+			chunk->nSessions = 0;
+			m_free.tryPush(chunk);
+			spin = 0;
+		} else if (m_closing) {
+			// close() submits before setting the flag, the ring is drained
+			if (!m_filled.tryPop(chunk)) {
+				return;
+			}
+			writeChunk(*chunk);
+			m_free.tryPush(chunk);
+		} else {
+			backoff(spin++);
+		}
+	}
+}
+
+void StatsSink::writeChunk(const Chunk & chunk) {
+	switch (m_format) {
+	case StatsFormat::BINARY:
+		writeBinary(chunk);
+		break;
+	case StatsFormat::CSV:
+		writeCsv(chunk);
+		break;
+	case StatsFormat::TEXT:
+		writeText(chunk);
+		break;
+	}
+}
+
+void StatsSink::writeBytes(const void * data, size_t size) {
+	if (size != 0 && std::fwrite(data, 1, size, m_file) != size) {
+		m_writeFailed = true;
+	}
+}
+
+template <typename T>
+void StatsSink::writeColumn(const std::vector<T> & column, size_t n) {
+	writeBytes(column.data(), n * sizeof(T));
+}
+
+void StatsSink::writeBinary(const Chunk & chunk) {
+	const uint32_t counts[2] = {
+		static_cast<uint32_t>(chunk.nFrames), static_cast<uint32_t>(chunk.nSessions)};
+	writeBytes(counts, sizeof(counts));
+	writeColumn(chunk.frame, chunk.nFrames);
+	writeColumn(chunk.channel, chunk.nFrames);
+	writeColumn(chunk.noiseEnergy, chunk.nFrames);
+	writeColumn(chunk.voiceEnergy, chunk.nFrames);
+	writeColumn(chunk.sessionFrame, chunk.nSessions);
+	writeColumn(chunk.sessionChannel, chunk.nSessions);
+	writeColumn(chunk.sessionFinal, chunk.nSessions);
+	// The session records are stored field by field as well
+	std::vector<uint32_t> column(chunk.nSessions);
+	for (uint32_t SessionStatsRecord::*field : {&SessionStatsRecord::noNoiseMs,
+			&SessionStatsRecord::lowNoiseMs, &SessionStatsRecord::mediumNoiseMs,
+			&SessionStatsRecord::highNoiseMs, &SessionStatsRecord::talkTimeMs}) {
+		for (size_t s = 0; s < chunk.nSessions; ++s) {
+			column[s] = chunk.sessions[s].*field;
+		}
+		writeColumn(column, chunk.nSessions);
+	}
+}
+
+void StatsSink::writeTextSession(const Chunk & chunk, size_t s) {
+	const SessionStatsRecord & stats = chunk.sessions[s];
+	if (chunk.sessionFinal[s] && !m_finalSeen) {
+		std::fputs("Getting Final NC session stats...\n", m_file);
+		m_finalSeen = true;
+	}
+	if (m_channels > 1) {
+		std::fprintf(m_file, "# Channel %u\n", static_cast<unsigned>(chunk.sessionChannel[s]));
+	}
+	std::fprintf(m_file,
+		"#--- Noise/Voice stats ---\n"
+		"# - No     Noise: %u ms\n"
+		"# - Low    Noise: %u ms\n"
+		"# - Medium Noise: %u ms\n"
+		"# - High   Noise: %u ms\n"
+		"#-------------------------\n"
+		"# - Talk time :   %u ms\n"
+		"#-------------------------\n",
+		stats.noNoiseMs, stats.lowNoiseMs, stats.mediumNoiseMs, stats.highNoiseMs,
+		stats.talkTimeMs);
+}
+
+// Session records are printed after the lines of the frame they were taken at
+void StatsSink::writeText(const Chunk & chunk) {
+	size_t s = 0;
+	for (size_t f = 0; f < chunk.nFrames; ++f) {
+		for (; s < chunk.nSessions && chunk.sessionFrame[s] < chunk.frame[f]; ++s) {
+			writeTextSession(chunk, s);
+		}
+		if (m_channels > 1) {
+			std::fprintf(m_file, "ch %u ", static_cast<unsigned>(chunk.channel[f]));
+		}
+		std::fprintf(m_file, "[%u x %ums] noiseEn: %u, voiceEn: %u\n",
+			chunk.frame[f] + 1, m_frameDurationMs, chunk.noiseEnergy[f], chunk.voiceEnergy[f]);
+	}
+	for (; s < chunk.nSessions; ++s) {
+		writeTextSession(chunk, s);
+	}
+}
+
+void StatsSink::writeCsv(const Chunk & chunk) {
+	for (size_t f = 0; f < chunk.nFrames; ++f) {
+		std::fprintf(m_file, "frame,%u,%u,%u,%u,,,,,\n", chunk.frame[f],
+			static_cast<unsigned>(chunk.channel[f]), chunk.noiseEnergy[f], chunk.voiceEnergy[f]);
+	}
+	for (size_t s = 0; s < chunk.nSessions; ++s) {
+		const SessionStatsRecord & stats = chunk.sessions[s];
+		std::fprintf(m_file, "%s,%u,%u,,,%u,%u,%u,%u,%u\n",
+			chunk.sessionFinal[s] ? "final" : "session", chunk.sessionFrame[s],
+			static_cast<unsigned>(chunk.sessionChannel[s]), stats.noNoiseMs, stats.lowNoiseMs,
+			stats.mediumNoiseMs, stats.highNoiseMs, stats.talkTimeMs);
+	}
+}
@@ -0,0 +1,127 @@
+#ifndef STATS_SINK_HPP
+#define STATS_SINK_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.hpp"
+
+
+enum class StatsFormat {
+	TEXT,   // the per-frame lines of the sample app
+	BINARY, // columnar chunks, see below
+	CSV
+};
+
+struct SessionStatsRecord {
+	uint32_t noNoiseMs;
+	uint32_t lowNoiseMs;
+	uint32_t mediumNoiseMs;
+	uint32_t highNoiseMs;
+	uint32_t talkTimeMs;
+};
+
+// Binary stats file layout, every integer in host byte order (little-endian
+// on the supported platforms):
+//   header: kStatsMagic, uint32 version, frame duration in ms, channels,
+//           a reserved uint32
+//   chunks: uint32 nFrames, uint32 nSessions, then the columns
+//           uint32 frame[nFrames], uint16 channel[nFrames],
+//           uint32 noiseEnergy[nFrames], uint32 voiceEnergy[nFrames],
+//           uint32 frame[nSessions], uint16 channel[nSessions],
+//           uint8 final[nSessions], uint32 noNoiseMs[nSessions],
+//           lowNoiseMs, mediumNoiseMs, highNoiseMs, talkTimeMs[nSessions]
+// Session records refer to the frame after which they were taken.
+static const char kStatsMagic[8] = {'K', 'N', 'C', 'S', 'T', 'A', 'T', 'S'};
+static const uint32_t kStatsVersion = 1;
+
+// Per-frame energies and periodic session stats recorded into preallocated
+// columnar chunks by the processing thread and written to the file by a
+// background thread, so recording a frame costs a few stores. Recording
+// blocks only when every chunk is waiting for the writer.
+class StatsSink {
+private:
+	struct Chunk {
+		std::vector<uint32_t> frame;
+		std::vector<uint16_t> channel;
+		std::vector<uint32_t> noiseEnergy;
+		std::vector<uint32_t> voiceEnergy;
+		size_t nFrames;
+		std::vector<uint32_t> sessionFrame;
+		std::vector<uint16_t> sessionChannel;
+		std::vector<uint8_t> sessionFinal;
+		std::vector<SessionStatsRecord> sessions;
+		size_t nSessions;
+	};
+
+	FILE * m_file;
+	bool m_ownsFile;
+	StatsFormat m_format;
+	unsigned m_frameDurationMs;
+	unsigned m_channels;
+	std::vector<Chunk> m_chunks;
+	SpscRing<Chunk *> m_free;
+	SpscRing<Chunk *> m_filled;
+	Chunk * m_current;
+	std::thread m_writer;
+	std::atomic<bool> m_closing;
+	std::atomic<bool> m_writeFailed;
+	bool m_finalSeen;
+	std::string m_errorMsg;
+
+	void submit();
+	void writerLoop();
+	void writeChunk(const Chunk & chunk);
+	void writeBinary(const Chunk & chunk);
+	void writeText(const Chunk & chunk);
+	void writeTextSession(const Chunk & chunk, size_t s);
+	void writeCsv(const Chunk & chunk);
+	template <typename T>
+	void writeColumn(const std::vector<T> & column, size_t n);
+	void writeBytes(const void * data, size_t size);
+
+public:
+	StatsSink();
+	~StatsSink();
+	StatsSink(const StatsSink &) = delete;
+	StatsSink & operator=(const StatsSink &) = delete;
+
+	// The format follows the path: empty is TEXT on stdout, a .csv
+	// extension is CSV, anything else BINARY
+	static StatsFormat getFormat(const std::string & path);
+
+	bool open(const std::string & path, unsigned frameDurationMs, unsigned channels);
+	// Drains the chunks and closes the file, returns false on a write error
+	bool close();
+	std::string getErrorMsg() const;
+
+	void recordFrame(uint32_t frame, unsigned channel, uint32_t noiseEnergy,
+		uint32_t voiceEnergy) {
+		Chunk & chunk = *m_current;
+		chunk.frame[chunk.nFrames] = frame;
+		chunk.channel[chunk.nFrames] = static_cast<uint16_t>(channel);
+		chunk.noiseEnergy[chunk.nFrames] = noiseEnergy;
+		chunk.voiceEnergy[chunk.nFrames] = voiceEnergy;
+		if (++chunk.nFrames == chunk.frame.size()) {
+			submit();
+		}
+	}
+
+	void recordSession(uint32_t frame, unsigned channel, const SessionStatsRecord & stats,
+		bool final) {
+		Chunk & chunk = *m_current;
+		chunk.sessionFrame[chunk.nSessions] = frame;
+		chunk.sessionChannel[chunk.nSessions] = static_cast<uint16_t>(channel);
+		chunk.sessionFinal[chunk.nSessions] = final ? 1 : 0;
+		chunk.sessions[chunk.nSessions] = stats;
+		if (++chunk.nSessions == chunk.sessions.size()) {
+			submit();
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,284 @@
+#include "thread_control.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <fstream>
+
+// Resolved to null when the library is not linked in
+extern "C" {
+void openblas_set_num_threads(int) __attribute__((weak));
+void omp_set_num_threads(int) __attribute__((weak));
+int fftwf_init_threads(void) __attribute__((weak));
+void fftwf_plan_with_nthreads(int) __attribute__((weak));
+}
+
+// From linux/mempolicy.h, not every libc ships it
+static const int kMpolLocal = 4;
+#endif
+
+
+void limitLibraryThreads(unsigned nThreads) {
+	if (nThreads == 0) {
+		return;
+	}
+#ifdef __linux__
+	const std::string value = std::to_string(nThreads);
+	setenv("OPENBLAS_NUM_THREADS", value.c_str(), 1);
+	setenv("OMP_NUM_THREADS", value.c_str(), 1);
+	// OpenBLAS reads its variable when it is loaded, before main()
+	if (openblas_set_num_threads) {
+		openblas_set_num_threads(static_cast<int>(nThreads));
+	}
+	if (omp_set_num_threads) {
+		omp_set_num_threads(static_cast<int>(nThreads));
+	}
+	// FFTW aborts on fftwf_plan_with_nthreads() before fftwf_init_threads()
+	if (fftwf_init_threads && fftwf_plan_with_nthreads && fftwf_init_threads() != 0) {
+		fftwf_plan_with_nthreads(static_cast<int>(nThreads));
+	}
+#endif
+}
+
+ThreadPlacement::ThreadPlacement() :
+	m_numaLocal{false} {
+}
+
+bool ThreadPlacement::setCpus(const std::string & list) {
+	m_cpus.clear();
+	size_t pos = 0;
+	while (pos < list.size()) {
+		size_t end = list.find(',', pos);
+		if (end == std::string::npos) {
+			end = list.size();
+		}
+		const std::string range = list.substr(pos, end - pos);
+		const size_t dash = range.find('-');
+		unsigned long first, last;
+		try {
+			size_t used = 0;
+			first = std::stoul(range.substr(0, dash), &used);
+			if (used != (dash == std::string::npos ? range.size() : dash)) {
+				throw std::invalid_argument(range);
+			}
+			last = first;
+			if (dash != std::string::npos) {
+				last = std::stoul(range.substr(dash + 1), &used);
+				if (used != range.size() - dash - 1) {
+					throw std::invalid_argument(range);
+				}
+			}
+		} catch (const std::exception &) {
+			m_errorMsg = "Invalid CPU list: " + list;
+			return false;
+		}
+		if (last < first || last >= 4096) {
+			m_errorMsg = "Invalid CPU range: " + range;
+			return false;
+		}
+		for (unsigned long cpu = first; cpu <= last; ++cpu) {
+			m_cpus.push_back(static_cast<unsigned>(cpu));
+		}
+		pos = end + 1;
+	}
+	if (m_cpus.empty()) {
+		m_errorMsg = "Empty CPU list";
+		return false;
+	}
+#ifdef __linux__
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+		m_errorMsg = "Failed to read the CPU affinity of the process";
+		return false;
+	}
+	for (unsigned cpu : m_cpus) {
+		if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed)) {
+			m_errorMsg = "CPU " + std::to_string(cpu) + " is not available to the process";
+			return false;
+		}
+	}
+	return true;
+#else
+	m_errorMsg = "CPU pinning is only supported on Linux";
+	return false;
+#endif
+}
+
+void ThreadPlacement::setNumaLocal(bool numaLocal) {
+	m_numaLocal = numaLocal;
+}
+
+bool ThreadPlacement::isEnabled() const {
+	return !m_cpus.empty() || m_numaLocal;
+}
+
+const std::vector<unsigned> & ThreadPlacement::getCpus() const {
+	return m_cpus;
+}
+
+bool ThreadPlacement::apply(unsigned index, const char * prefix) const {
+#ifdef __linux__
+	if (prefix != nullptr) {
+		// The kernel limits the names to 15 characters
+		const std::string name = (std::string(prefix) + "-" + std::to_string(index)).substr(0, 15);
+		pthread_setname_np(pthread_self(), name.c_str());
+	}
+	if (!m_cpus.empty()) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(m_cpus[index % m_cpus.size()], &set);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+			return false;
+		}
+	}
+	// A kernel without NUMA support has one node, the allocation is local anyway
+	if (m_numaLocal && syscall(SYS_set_mempolicy, kMpolLocal, nullptr, 0UL) != 0 && errno != ENOSYS) {
+		return false;
+	}
+	return true;
+#else
+	(void)index;
+	(void)prefix;
+	return !isEnabled();
+#endif
+}
+
+const std::string & ThreadPlacement::getErrorMsg() const {
+	return m_errorMsg;
+}
+
+#ifdef __linux__
+// Thread id and name of every thread of the process
+static std::map<long, std::string> listThreads() {
+	std::map<long, std::string> threads;
+	DIR * dir = opendir("/proc/self/task");
+	if (dir == nullptr) {
+		return threads;
+	}
+	while (dirent * entry = readdir(dir)) {
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+		std::string name;
+		std::ifstream comm(std::string("/proc/self/task/") + entry->d_name + "/comm");
+		std::getline(comm, name);
+		threads[std::strtol(entry->d_name, nullptr, 10)] = name;
+	}
+	closedir(dir);
+	return threads;
+}
+#endif
+
+// "nc-worker-12" and "nc-worker-3" are one group
+static std::string groupName(const std::string & name) {
+	size_t end = name.size();
+	while (end > 0 && name[end - 1] >= '0' && name[end - 1] <= '9') {
+		--end;
+	}
+	while (end > 0 && (name[end - 1] == '-' || name[end - 1] == '_')) {
+		--end;
+	}
+	return end != 0 ? name.substr(0, end) : name;
+}
+
+unsigned countProcessThreads() {
+#ifdef __linux__
+	return static_cast<unsigned>(listThreads().size());
+#else
+	return 0;
+#endif
+}
+
+ThreadMonitor::ThreadMonitor(unsigned intervalMs) :
+	m_stop{false},
+	m_intervalMs{intervalMs},
+	m_maxAlive{0} {
+}
+
+ThreadMonitor::~ThreadMonitor() {
+	stop();
+}
+
+void ThreadMonitor::sample() {
+#ifdef __linux__
+	const long self = static_cast<long>(syscall(SYS_gettid));
+	std::map<std::string, unsigned> alive;
+	unsigned nAlive = 0;
+	for (const auto & thread : listThreads()) {
+		if (thread.first == self) {
+			continue;
+		}
+		m_seen[thread.first] = thread.second;
+		++alive[groupName(thread.second)];
+		++nAlive;
+	}
+	m_maxAlive = std::max(m_maxAlive, nAlive);
+	for (const auto & group : alive) {
+		unsigned & maxAlive = m_maxAliveByName[group.first];
+		maxAlive = std::max(maxAlive, group.second);
+	}
+#endif
+}
+
+void ThreadMonitor::threadLoop() {
+#ifdef __linux__
+	pthread_setname_np(pthread_self(), "thread-monitor");
+#endif
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		sample();
+		if (m_stopCv.wait_for(lock, std::chrono::milliseconds(m_intervalMs), [&]() { return m_stop; })) {
+			// The last sample sees the state at stop()
+			sample();
+			return;
+		}
+	}
+}
+
+void ThreadMonitor::start() {
+	m_stop = false;
+	m_thread = std::thread(&ThreadMonitor::threadLoop, this);
+}
+
+void ThreadMonitor::stop() {
+	if (!m_thread.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_stopCv.notify_one();
+	m_thread.join();
+}
+
+unsigned ThreadMonitor::getSeen() const {
+	return static_cast<unsigned>(m_seen.size());
+}
+
+unsigned ThreadMonitor::getMaxAlive() const {
+	return m_maxAlive;
+}
+
+std::map<std::string, ThreadMonitor::ThreadGroup> ThreadMonitor::getGroups() const {
+	std::map<std::string, ThreadGroup> groups;
+	for (const auto & thread : m_seen) {
+		++groups[groupName(thread.second)].nSeen;
+	}
+	for (auto & group : groups) {
+		auto it = m_maxAliveByName.find(group.first);
+		group.second.maxAlive = it != m_maxAliveByName.end() ? it->second : 0;
+	}
+	return groups;
+}
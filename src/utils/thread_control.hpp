@@ -0,0 +1,89 @@
+#ifndef THREAD_CONTROL_HPP
+#define THREAD_CONTROL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Caps the threads of the math libraries the SDK links: OpenBLAS, OpenMP and
+// FFTW through their setters when they are linked in, and the usual
+// environment variables for the pools created later. 0 leaves the library
+// defaults. Call it before globalInit(). The pools of onnxruntime and
+// pthreadpool have no global control, they are sized per session by the SDK
+// and inherit the CPU affinity of the thread that creates the session.
+void limitLibraryThreads(unsigned nThreads);
+
+// Where the worker threads of a multi-session run go. Worker i is pinned to
+// cpus[i % cpus.size()]. With numaLocal the worker also asks the kernel for
+// local allocation, so the memory it touches first, its NC session included
+// when the session is created on the worker, comes from the node of its CPU.
+class ThreadPlacement {
+private:
+	std::vector<unsigned> m_cpus;
+	bool m_numaLocal;
+	std::string m_errorMsg;
+
+public:
+	ThreadPlacement();
+
+	// Linux CPU list syntax, "0-3,8,10-11". Fails for CPUs outside the
+	// affinity mask of the process.
+	bool setCpus(const std::string & list);
+	void setNumaLocal(bool numaLocal);
+	bool isEnabled() const;
+	const std::vector<unsigned> & getCpus() const;
+
+	// Pins the calling thread as worker index and names it prefix-index,
+	// a null prefix keeps the name. Safe to call from several threads at once.
+	bool apply(unsigned index, const char * prefix) const;
+
+	const std::string & getErrorMsg() const;
+};
+
+// Polls /proc/self/task while it runs and keeps every thread it sees, so the
+// report covers the threads the libraries start and stop on their own.
+// Threads that live shorter than the interval can be missed.
+class ThreadMonitor {
+public:
+	struct ThreadGroup {
+		unsigned nSeen; // distinct thread ids with this name
+		unsigned maxAlive;
+	};
+
+private:
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_stopCv;
+	bool m_stop;
+	unsigned m_intervalMs;
+	std::map<long, std::string> m_seen;
+	unsigned m_maxAlive;
+	std::map<std::string, unsigned> m_maxAliveByName;
+
+	void sample();
+	void threadLoop();
+
+public:
+	explicit ThreadMonitor(unsigned intervalMs = 20);
+	~ThreadMonitor();
+	ThreadMonitor(const ThreadMonitor &) = delete;
+	ThreadMonitor & operator=(const ThreadMonitor &) = delete;
+
+	void start();
+	void stop();
+
+	// Read after stop(). The monitor thread is not counted.
+	unsigned getSeen() const;
+	unsigned getMaxAlive() const;
+	std::map<std::string, ThreadGroup> getGroups() const;
+};
+
+// Threads of the process right now
+unsigned countProcessThreads();
+
+#endif
@@ -0,0 +1,292 @@
+#include "wav_mmap_reader.hpp"
+
+#include <cstring>
+
+#include "sample_convert.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+static const uint16_t kWaveFormatPcm = 0x0001;
+static const uint16_t kWaveFormatFloat = 0x0003;
+static const uint16_t kWaveFormatExtensible = 0xFFFE;
+
+static uint16_t readLe16(const uint8_t * p) {
+	return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t readLe32(const uint8_t * p) {
+	return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+		(static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static bool isLittleEndianHost() {
+	const uint16_t probe = 1;
+	uint8_t first;
+	std::memcpy(&first, &probe, 1);
+	return first == 1;
+}
+
+WavMmapReader::WavMmapReader() :
+	m_fd{-1},
+	m_map{nullptr},
+	m_mapSize{0},
+	m_data{nullptr},
+	m_bytesPerFrame{0},
+	m_header(),
+	m_errorMsg() {
+}
+
+WavMmapReader::~WavMmapReader() {
+	close();
+}
+
+bool WavMmapReader::fail(const std::string & errorMsg) {
+	close();
+	m_errorMsg = errorMsg;
+	return false;
+}
+
+std::string WavMmapReader::getErrorMsg() const {
+	return m_errorMsg;
+}
+
+const SoundFileHeader & WavMmapReader::getHeader() const {
+	return m_header;
+}
+
+const int16_t * WavMmapReader::getSamplesPCM16() const {
+	if (m_header.getFormat() != SoundFileFormat::PCM16) {
+		return nullptr;
+	}
+	return reinterpret_cast<const int16_t *>(m_data);
+}
+
+const float * WavMmapReader::getSamplesFloat() const {
+	if (m_header.getFormat() != SoundFileFormat::FLOAT) {
+		return nullptr;
+	}
+	return reinterpret_cast<const float *>(m_data);
+}
+
+void WavMmapReader::readFloat(int64_t offsetFrames, int64_t nFrames, float * out) const {
+	if (!m_data || nFrames <= 0 || offsetFrames < 0) {
+		return;
+	}
+	const uint8_t * begin = m_data + static_cast<size_t>(offsetFrames) * m_bytesPerFrame;
+	size_t nSamples = static_cast<size_t>(nFrames) * m_header.getNumberOfChannels();
+	switch (m_header.getFormat()) {
+	case SoundFileFormat::PCM16:
+		pcm16ToFloat(reinterpret_cast<const int16_t *>(begin), nSamples, out);
+		break;
+	case SoundFileFormat::PCM24:
+		pcm24ToFloat(begin, nSamples, out);
+		break;
+	case SoundFileFormat::PCM32:
+		pcm32ToFloat(reinterpret_cast<const int32_t *>(begin), nSamples, out);
+		break;
+	case SoundFileFormat::PCMU8:
+		pcmU8ToFloat(begin, nSamples, out);
+		break;
+	case SoundFileFormat::FLOAT:
+		std::memcpy(out, begin, nSamples * sizeof(float));
+		break;
+	default:
+		break;
+	}
+}
+
+#ifdef _WIN32
+
+bool WavMmapReader::open(const std::string &) {
+	return fail("The memory mapped reader is not implemented for Windows.");
+}
+
+void WavMmapReader::close() {
+	m_header = SoundFileHeader();
+}
+
+void WavMmapReader::advise(int64_t, int64_t, int) const {
+}
+
+void WavMmapReader::prefetch(int64_t, int64_t) const {
+}
+
+void WavMmapReader::release(int64_t, int64_t) const {
+}
+
+#else
+
+bool WavMmapReader::open(const std::string & filePath) {
+	close();
+	m_errorMsg.clear();
+	if (!isLittleEndianHost()) {
+		return fail("The memory mapped reader requires a little-endian host.");
+	}
+	m_fd = ::open(filePath.c_str(), O_RDONLY);
+	if (m_fd < 0) {
+		return fail("Failed to open the file: " + filePath);
+	}
+	struct stat st;
+	if (fstat(m_fd, &st) != 0 || st.st_size <= 0) {
+		return fail("Failed to get the file size: " + filePath);
+	}
+	m_mapSize = static_cast<size_t>(st.st_size);
+	void * map = mmap(nullptr, m_mapSize, PROT_READ, MAP_SHARED, m_fd, 0);
+	if (map == MAP_FAILED) {
+		m_map = nullptr;
+		return fail("Failed to map the file: " + filePath);
+	}
+	m_map = static_cast<uint8_t *>(map);
+	if (!parse()) {
+		return false;
+	}
+	madvise(m_map, m_mapSize, MADV_SEQUENTIAL);
+	return true;
+}
+
+// RIFF/WAVE with a fmt chunk followed somewhere by the data chunk, chunks
+// are padded to an even size
+bool WavMmapReader::parse() {
+	const uint8_t * p = m_map;
+	const uint8_t * end = m_map + m_mapSize;
+	if (m_mapSize < 12 || std::memcmp(p, "RIFF", 4) != 0 ||
+			std::memcmp(p + 8, "WAVE", 4) != 0) {
+		return fail("The file is not a RIFF/WAVE file.");
+	}
+	p += 12;
+
+	uint16_t formatTag = 0;
+	uint16_t channels = 0;
+	uint32_t samplingRate = 0;
+	uint16_t bitsPerSample = 0;
+	bool hasFormat = false;
+	while (static_cast<size_t>(end - p) >= 8) {
+		uint32_t chunkSize = readLe32(p + 4);
+		const uint8_t * body = p + 8;
+		size_t available = static_cast<size_t>(end - body);
+		if (std::memcmp(p, "fmt ", 4) == 0) {
+			if (chunkSize < 16 || available < 16) {
+				return fail("The fmt chunk is truncated.");
+			}
+			formatTag = readLe16(body);
+			channels = readLe16(body + 2);
+			samplingRate = readLe32(body + 4);
+			bitsPerSample = readLe16(body + 14);
+			if (formatTag == kWaveFormatExtensible) {
+				if (chunkSize < 40 || available < 40) {
+					return fail("The extensible fmt chunk is truncated.");
+				}
+				// The sub format GUID starts with the format tag
+				formatTag = readLe16(body + 24);
+			}
+			hasFormat = true;
+		} else if (std::memcmp(p, "data", 4) == 0) {
+			if (!hasFormat) {
+				return fail("The data chunk precedes the fmt chunk.");
+			}
+			int sfFormat = 0;
+			if (formatTag == kWaveFormatPcm && bitsPerSample == 8) {
+				sfFormat = SF_FORMAT_WAV | SF_FORMAT_PCM_U8;
+			} else if (formatTag == kWaveFormatPcm && bitsPerSample == 16) {
+				sfFormat = SF_FORMAT_WAV | SF_FORMAT_PCM_16;
+			} else if (formatTag == kWaveFormatPcm && bitsPerSample == 24) {
+				sfFormat = SF_FORMAT_WAV | SF_FORMAT_PCM_24;
+			} else if (formatTag == kWaveFormatPcm && bitsPerSample == 32) {
+				sfFormat = SF_FORMAT_WAV | SF_FORMAT_PCM_32;
+			} else if (formatTag == kWaveFormatFloat && bitsPerSample == 32) {
+				sfFormat = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+			} else {
+				return fail("Only WAV PCM and WAV FLOAT can be mapped.");
+			}
+			if (channels == 0 || samplingRate == 0) {
+				return fail("The fmt chunk is invalid.");
+			}
+			size_t bytesPerSample = bitsPerSample / 8u;
+			// Packed 24 bit samples are read byte by byte
+			size_t alignment = bytesPerSample == 3 ? 1 : bytesPerSample;
+			if (reinterpret_cast<uintptr_t>(body) % alignment != 0) {
+				return fail("The data chunk is not aligned to the sample size.");
+			}
+			// Streamed or truncated files may declare more than they have
+			size_t dataSize = chunkSize < available ? chunkSize : available;
+			m_data = body;
+			m_bytesPerFrame = bytesPerSample * channels;
+			SF_INFO sfInfo{};
+			sfInfo.frames = static_cast<sf_count_t>(dataSize / m_bytesPerFrame);
+			sfInfo.samplerate = static_cast<int>(samplingRate);
+			sfInfo.channels = channels;
+			sfInfo.format = sfFormat;
+			sfInfo.sections = 1;
+			sfInfo.seekable = 1;
+			m_header = SoundFileHeader(sfInfo);
+			return true;
+		}
+		size_t skip = static_cast<size_t>(chunkSize) + (chunkSize & 1u);
+		if (skip > available) {
+			break;
+		}
+		p = body + skip;
+	}
+	return fail("The data chunk is missing.");
+}
+
+void WavMmapReader::close() {
+	if (m_map) {
+		munmap(m_map, m_mapSize);
+		m_map = nullptr;
+	}
+	if (m_fd >= 0) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+	m_mapSize = 0;
+	m_data = nullptr;
+	m_bytesPerFrame = 0;
+	m_header = SoundFileHeader();
+}
+
+// madvise works on whole pages, the range is widened to the page boundaries
+void WavMmapReader::advise(int64_t offsetFrames, int64_t nFrames, int advice) const {
+	if (!m_map || nFrames <= 0 || offsetFrames < 0) {
+		return;
+	}
+	static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t begin = static_cast<size_t>(m_data - m_map) +
+		static_cast<size_t>(offsetFrames) * m_bytesPerFrame;
+	size_t end = begin + static_cast<size_t>(nFrames) * m_bytesPerFrame;
+	if (begin >= m_mapSize) {
+		return;
+	}
+	end = end < m_mapSize ? end : m_mapSize;
+	begin -= begin % pageSize;
+	madvise(m_map + begin, end - begin, advice);
+}
+
+void WavMmapReader::prefetch(int64_t offsetFrames, int64_t nFrames) const {
+	advise(offsetFrames, nFrames, MADV_WILLNEED);
+}
+
+// Only whole pages behind the range end are released, the page cache keeps
+// the data, only the mapping of this process is dropped
+void WavMmapReader::release(int64_t offsetFrames, int64_t nFrames) const {
+	if (!m_map || nFrames <= 0 || offsetFrames < 0) {
+		return;
+	}
+	static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t begin = static_cast<size_t>(m_data - m_map) +
+		static_cast<size_t>(offsetFrames) * m_bytesPerFrame;
+	size_t end = begin + static_cast<size_t>(nFrames) * m_bytesPerFrame;
+	begin += (pageSize - begin % pageSize) % pageSize;
+	end -= end % pageSize;
+	if (begin < end && end <= m_mapSize) {
+		madvise(m_map + begin, end - begin, MADV_DONTNEED);
+	}
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef WAV_MMAP_READER_HPP
+#define WAV_MMAP_READER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "sound_file.hpp"
+
+
+// Read-only memory mapping of a WAV PCM or WAV FLOAT file. The RIFF chunks
+// are parsed directly and the PCM16 and FLOAT samples are used in place,
+// without a copy. 8, 24 and 32 bit PCM is converted to float on read.
+// Other formats, compressed or misaligned data and big-endian hosts are
+// rejected, the caller is expected to fall back to SoundFile.
+class WavMmapReader {
+private:
+	int m_fd;
+	uint8_t * m_map;
+	size_t m_mapSize;
+	const uint8_t * m_data;
+	size_t m_bytesPerFrame;
+	SoundFileHeader m_header;
+	std::string m_errorMsg;
+
+	bool fail(const std::string & errorMsg);
+	bool parse();
+	void advise(int64_t offsetFrames, int64_t nFrames, int advice) const;
+
+public:
+	WavMmapReader();
+	~WavMmapReader();
+	WavMmapReader(const WavMmapReader &) = delete;
+	WavMmapReader & operator=(const WavMmapReader &) = delete;
+
+	// Returns false if the file can not be mapped, see getErrorMsg()
+	bool open(const std::string & filePath);
+	void close();
+
+	std::string getErrorMsg() const;
+	const SoundFileHeader & getHeader() const;
+
+	// Interleaved samples of the whole data chunk, valid until close()
+	const int16_t * getSamplesPCM16() const;
+	const float * getSamplesFloat() const;
+	// Converts nFrames frames from offsetFrames on to float in [-1, 1),
+	// out holds nFrames * channels samples. Works for every mapped format.
+	void readFloat(int64_t offsetFrames, int64_t nFrames, float * out) const;
+
+	// Hints for the kernel page cache: read the range ahead of use and
+	// drop the range from the process once it is consumed
+	void prefetch(int64_t offsetFrames, int64_t nFrames) const;
+	void release(int64_t offsetFrames, int64_t nFrames) const;
+};
+
+#endif
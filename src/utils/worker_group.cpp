@@ -0,0 +1,82 @@
+#include "worker_group.hpp"
+
+
+WorkerGroup::WorkerGroup(unsigned size) :
+	m_generation{0},
+	m_pending{0},
+	m_stop{false} {
+	for (unsigned i = 1; i < size; ++i) {
+		m_threads.emplace_back(&WorkerGroup::workerLoop, this, i);
+	}
+}
+
+WorkerGroup::~WorkerGroup() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_startCv.notify_all();
+	for (auto & thread : m_threads) {
+		thread.join();
+	}
+}
+
+unsigned WorkerGroup::size() const {
+	return static_cast<unsigned>(m_threads.size() + 1);
+}
+
+void WorkerGroup::workerLoop(unsigned index) {
+	uint64_t seen = 0;
+	for (;;) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_startCv.wait(lock, [&]() { return m_stop || m_generation != seen; });
+		if (m_stop) {
+			return;
+		}
+		seen = m_generation;
+		lock.unlock();
+
+		std::exception_ptr error;
+		try {
+			m_task(index);
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		lock.lock();
+		if (error && !m_error) {
+			m_error = error;
+		}
+		if (--m_pending == 0) {
+			m_doneCv.notify_one();
+		}
+	}
+}
+
+void WorkerGroup::run(const std::function<void(unsigned)> & task) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = task;
+		m_error = nullptr;
+		m_pending = static_cast<unsigned>(m_threads.size());
+		++m_generation;
+	}
+	m_startCv.notify_all();
+
+	std::exception_ptr error;
+	try {
+		task(0);
+	} catch (...) {
+		error = std::current_exception();
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCv.wait(lock, [&]() { return m_pending == 0; });
+	if (!error) {
+		error = m_error;
+	}
+	lock.unlock();
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
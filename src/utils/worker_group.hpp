@@ -0,0 +1,43 @@
+#ifndef WORKER_GROUP_HPP
+#define WORKER_GROUP_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Fixed group of threads that run the same task with their own index.
+// Index 0 runs on the calling thread, the others on persistent threads, so
+// the cost per run() is a wake-up instead of a thread creation.
+class WorkerGroup {
+private:
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_startCv;
+	std::condition_variable m_doneCv;
+	std::function<void(unsigned)> m_task;
+	uint64_t m_generation;
+	unsigned m_pending;
+	bool m_stop;
+	std::exception_ptr m_error;
+
+	void workerLoop(unsigned index);
+
+public:
+	explicit WorkerGroup(unsigned size);
+	~WorkerGroup();
+	WorkerGroup(const WorkerGroup &) = delete;
+	WorkerGroup & operator=(const WorkerGroup &) = delete;
+
+	unsigned size() const;
+
+	// Runs task(0) ... task(size() - 1) in parallel and waits for all of
+	// them. The first exception thrown by a task is rethrown here.
+	void run(const std::function<void(unsigned)> & task);
+};
+
+#endif
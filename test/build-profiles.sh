@@ -0,0 +1,78 @@
+#!/bin/bash
+# Builds sample-nc with every build profile and prints the best of RUNS
+# runs on the test input with its speedup over the Debug build.
+# CMAKE_FLAGS selects the SDK and libsndfile as for the makefile targets,
+# MODEL is the model passed to sample-nc and INPUT can replace the test
+# input with a longer file for steadier timings.
+
+set -e
+cd "$(dirname "$0")/.."
+ROOT=$(pwd)
+OUT=${ROOT}/build-profiles
+INPUT=${INPUT:-${ROOT}/test/input/sample-nc-test.wav}
+MODEL=${MODEL:-${ROOT}/test/model.kef}
+RUNS=${RUNS:-5}
+
+PROFILES="debug release relwithdebinfo release-lto pgo"
+grep -qw avx2 /proc/cpuinfo && PROFILES="${PROFILES} x86-64-v3"
+grep -qw avx512f /proc/cpuinfo && PROFILES="${PROFILES} x86-64-v4"
+
+profile_flags() {
+	case $1 in
+	debug) echo "-D CMAKE_BUILD_TYPE=Debug" ;;
+	release) echo "-D CMAKE_BUILD_TYPE=Release" ;;
+	relwithdebinfo) echo "-D CMAKE_BUILD_TYPE=RelWithDebInfo" ;;
+	release-lto) echo "-D CMAKE_BUILD_TYPE=Release -D LTO=1" ;;
+	pgo) echo "-D CMAKE_BUILD_TYPE=Release -D LTO=1 -D PGO_DIR=${OUT}/pgo/profiles" ;;
+	*) echo "-D CMAKE_BUILD_TYPE=Release -D LTO=1 -D MARCH=$1" ;;
+	esac
+}
+
+build() {
+	# $1 profile, the rest extra cmake flags
+	local profile=$1
+	shift
+	cmake --no-warn-unused-cli -B "${OUT}/${profile}" -S cmake ${CMAKE_FLAGS} $(profile_flags "${profile}") \
+		-D BIN_DIR="${OUT}/${profile}/bin" "$@" > /dev/null
+	cmake --build "${OUT}/${profile}" --target sample-nc sample-nc-bench -j"$(nproc)" > /dev/null
+}
+
+# Prints the best wall time in seconds of RUNS runs
+time_runs() {
+	local best=0
+	for _ in $(seq ${RUNS}); do
+		local start end
+		start=$(date +%s%N)
+		"$1/sample-nc" -i "${INPUT}" -o "${OUT}/out.wav" -m "${MODEL}" > /dev/null
+		end=$(date +%s%N)
+		if [ ${best} -eq 0 ] || [ $((end - start)) -lt ${best} ]; then
+			best=$((end - start))
+		fi
+	done
+	echo ${best}
+}
+
+mkdir -p "${OUT}"
+declare -A times
+for profile in ${PROFILES}; do
+	if [ "${profile}" = pgo ]; then
+		build pgo -D PGO=generate
+		rm -rf "${OUT}/pgo/profiles"
+		"${OUT}/pgo/bin/sample-nc" -i "${INPUT}" -o "${OUT}/out.wav" -m "${MODEL}" > /dev/null
+		"${OUT}/pgo/bin/sample-nc-bench" -m "${MODEL}" -d 2 -c 2 > /dev/null
+		if ls "${OUT}"/pgo/profiles/*.profraw > /dev/null 2>&1; then
+			llvm-profdata merge -o "${OUT}/pgo/profiles/default.profdata" "${OUT}"/pgo/profiles/*.profraw
+		fi
+		cmake --build "${OUT}/pgo" --target clean > /dev/null
+		build pgo -D PGO=use
+	else
+		build "${profile}"
+	fi
+	times[${profile}]=$(time_runs "${OUT}/${profile}/bin")
+done
+
+printf "%-16s %12s %10s\n" profile "seconds" "speedup"
+for profile in ${PROFILES}; do
+	awk -v p="${profile}" -v t="${times[${profile}]}" -v d="${times[debug]}" \
+		'BEGIN { printf "%-16s %12.3f %9.2fx\n", p, t / 1e9, d / t }'
+done
@@ -0,0 +1,88 @@
+#!/bin/bash
+# Compares the total job time of processing compressed audio directly with
+# the decompress-to-WAV workflow: decode every file to WAV, run sample-nc on
+# the WAV files, encode the results back. Both workflows process COPIES
+# copies of INPUT in FORMAT (flac, ogg or opus) in batch mode.
+# The WAV workflow and the preparation of the compressed input use CONVERT,
+# a command taking an input and an output path, ffmpeg or sndfile-convert
+# by default. MODEL is the model passed to sample-nc, RUNS the number of
+# timed runs of which the best is kept. The files are written to OUT,
+# build/codec-bench by default.
+
+set -e
+cd "$(dirname "$0")/.."
+ROOT=$(pwd)
+OUT=${OUT:-${ROOT}/build/codec-bench}
+INPUT=${INPUT:-${ROOT}/test/input/sample-nc-test.wav}
+MODEL=${MODEL:-${ROOT}/test/model.kef}
+FORMAT=${FORMAT:-flac}
+COPIES=${COPIES:-4}
+RUNS=${RUNS:-3}
+NC=${NC:-${ROOT}/bin/sample-nc}
+
+if [ -z "${CONVERT}" ]; then
+	if command -v ffmpeg > /dev/null; then
+		CONVERT="ffmpeg -loglevel error -y -i"
+	elif command -v sndfile-convert > /dev/null; then
+		CONVERT=sndfile-convert
+	else
+		echo "ffmpeg or sndfile-convert is needed, or set CONVERT" >&2
+		exit 1
+	fi
+fi
+
+# Only the directories of the script are removed, OUT may hold other files
+rm -rf "${OUT}/in" "${OUT}/wav-in" "${OUT}/wav-out" "${OUT}/wav-final" "${OUT}/direct-out"
+mkdir -p "${OUT}/in"
+for i in $(seq ${COPIES}); do
+	${CONVERT} "${INPUT}" "${OUT}/in/${i}.${FORMAT}"
+done
+
+# Decode, process and encode, the intermediate WAV files stay on the disk
+# as a script would leave them until the job is done
+wav_workflow() {
+	rm -rf "${OUT}/wav-in" "${OUT}/wav-out" "${OUT}/wav-final"
+	mkdir -p "${OUT}/wav-in" "${OUT}/wav-final"
+	for f in "${OUT}"/in/*; do
+		${CONVERT} "${f}" "${OUT}/wav-in/$(basename "${f%.*}").wav"
+	done
+	"${NC}" -id "${OUT}/wav-in" -od "${OUT}/wav-out" -m "${MODEL}" > /dev/null
+	for f in "${OUT}"/wav-out/*; do
+		${CONVERT} "${f}" "${OUT}/wav-final/$(basename "${f%.*}").${FORMAT}"
+	done
+}
+
+direct_workflow() {
+	rm -rf "${OUT}/direct-out"
+	"${NC}" -id "${OUT}/in" -od "${OUT}/direct-out" -m "${MODEL}" > /dev/null
+}
+
+# Prints the best wall time in nanoseconds of RUNS runs of $1
+time_runs() {
+	local best=0
+	for _ in $(seq ${RUNS}); do
+		local start end
+		start=$(date +%s%N)
+		"$1"
+		end=$(date +%s%N)
+		if [ ${best} -eq 0 ] || [ $((end - start)) -lt ${best} ]; then
+			best=$((end - start))
+		fi
+	done
+	echo ${best}
+}
+
+bytes() {
+	du -cb "$@" | tail -1 | cut -f1
+}
+
+wav=$(time_runs wav_workflow)
+direct=$(time_runs direct_workflow)
+wav_bytes=$(bytes "${OUT}/wav-in" "${OUT}/wav-out" "${OUT}/wav-final")
+direct_bytes=$(bytes "${OUT}/direct-out")
+
+echo "${COPIES} x $(basename "${INPUT}") as ${FORMAT}, $(bytes "${OUT}/in") bytes of input"
+printf "%-16s %12s %16s\n" workflow "seconds" "bytes written"
+printf "%-16s %12s %16s\n" "via WAV" "$(awk -v t="${wav}" 'BEGIN { printf "%.3f", t / 1e9 }')" "${wav_bytes}"
+printf "%-16s %12s %16s\n" "direct" "$(awk -v t="${direct}" 'BEGIN { printf "%.3f", t / 1e9 }')" "${direct_bytes}"
+awk -v w="${wav}" -v d="${direct}" 'BEGIN { printf "speedup %.2fx\n", w / d }'